@@ -0,0 +1,48 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "recompiler.h"
+
+// Recompiles a ROM into a C++ class to build into a client (see Recompiler)
+
+static void PrintUsage(const char* program) {
+    std::cout << "usage: " << program << " <rom> <output> [options]" << std::endl
+              << "  writes <output>.h and <output>.cpp" << std::endl
+              << "  --name <class>     name of the generated class (default: from the rom file name)" << std::endl
+              << "  --quirks <list>    build for these quirks instead of the rom's: none, vip, schip or any of" << std::endl
+              << "                     shift-vy, load-store-i, jump-vx, clip, logic-vf (comma separated)" << std::endl
+              << "  --main             also emit a main() running the rom headless: <program> [frames] [seed] [cycles per frame]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    Recompiler::Options options = {};
+    options.romPath = argv[1];
+    options.outputBase = argv[2];
+
+    for (int i = 3; i < argc; i++) {
+        const bool hasValue = (i + 1) < argc;
+        if (strcmp(argv[i], "--name") == 0 && hasValue) {
+            options.className = argv[++i];
+        } else if (strcmp(argv[i], "--quirks") == 0 && hasValue) {
+            if (!Quirk::Parse(argv[++i], options.quirks)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            options.overrideQuirks = true;
+        } else if (strcmp(argv[i], "--main") == 0) {
+            options.emitMain = true;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    Recompiler recompiler = {};
+    return recompiler.Run(options) ? 0 : 1;
+}
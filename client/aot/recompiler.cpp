@@ -0,0 +1,624 @@
+#include "recompiler.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "chip8/cartridge/rom_profile.h"
+#include "chip8/cpu/cpu.h"
+#include "chip8/cpu/opcode.h"
+
+namespace {
+    constexpr uint16_t ProgramStart = CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD;
+
+    // printf into the generated file
+    void Emit(std::ostream& out, const char* format, ...) {
+        char line[256];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        out << line;
+    }
+
+    bool IsSkip(const uint16_t code) {
+        switch (code & 0xF000) {
+            case 0x3000:
+            case 0x4000:
+            case 0x5000:
+            case 0x9000:
+                return true;
+            case 0xE000:
+                return (code & 0x00FF) == 0x9E || (code & 0x00FF) == 0xA1;
+            default:
+                return false;
+        }
+    }
+
+    // Opcodes after which a block ends: the ones that leave PC anywhere but
+    // on the next opcode, Fx0A which halts, and Fx33/Fx55 which write memory,
+    // so the next block is checked against the ROM again
+    bool EndsBlock(const uint16_t code) {
+        if (code == 0x00EE || IsSkip(code)) return true;
+
+        switch (code & 0xF000) {
+            case 0x1000:
+            case 0x2000:
+            case 0xB000:
+                return true;
+            case 0xF000:
+                return (code & 0x00FF) == 0x0A || (code & 0x00FF) == 0x33 || (code & 0x00FF) == 0x55;
+            default:
+                return false;
+        }
+    }
+
+    // The condition under which a skip opcode skips, as C++ over V
+    std::string SkipCondition(const uint16_t code) {
+        const Opcode opcode(code);
+        char condition[96];
+        switch (code & 0xF000) {
+            case 0x3000: snprintf(condition, sizeof(condition), "V[0x%X] == 0x%02Xu", opcode.X(), opcode.KK()); break;
+            case 0x4000: snprintf(condition, sizeof(condition), "V[0x%X] != 0x%02Xu", opcode.X(), opcode.KK()); break;
+            case 0x5000: snprintf(condition, sizeof(condition), "V[0x%X] == V[0x%X]", opcode.X(), opcode.Y()); break;
+            case 0x9000: snprintf(condition, sizeof(condition), "V[0x%X] != V[0x%X]", opcode.X(), opcode.Y()); break;
+            default:
+                snprintf(condition, sizeof(condition), "%sconsole.Keyboard.IsKeyDown(V[0x%X])",
+                         (code & 0x00FF) == 0xA1 ? "!" : "", opcode.X());
+                break;
+        }
+        return condition;
+    }
+
+    // "space-invaders.ch8" -> "SpaceInvadersProgram"
+    std::string MakeClassName(const char* path) {
+        const char* name = path;
+        for (const char* c = path; *c != '\0'; c++) {
+            if (*c == '/' || *c == '\\') name = c + 1;
+        }
+
+        std::string result;
+        bool upper = true;
+        for (const char* c = name; *c != '\0' && *c != '.'; c++) {
+            const bool alnum = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9');
+            if (!alnum) {
+                upper = true;
+                continue;
+            }
+            result += (upper && *c >= 'a' && *c <= 'z') ? static_cast<char>(*c - 'a' + 'A') : *c;
+            upper = false;
+        }
+        if (result.empty() || (result[0] >= '0' && result[0] <= '9')) {
+            result = "Rom" + result;
+        }
+        return result + "Program";
+    }
+
+    std::string BaseName(const std::string& path) {
+        const size_t slash = path.find_last_of("/\\");
+        return (slash == std::string::npos) ? path : path.substr(slash + 1u);
+    }
+}
+
+bool Recompiler::Run(const Options& options) {
+    _options = options;
+
+    if (!_cartridge.loadFromFile(options.romPath)) {
+        std::cerr << "[Aot] failed to load cartridge " << options.romPath << std::endl;
+        return false;
+    }
+    if (_cartridge.size + ProgramStart >= CHIP8_MEMORY_SIZE) {
+        std::cerr << "[Aot] rom too large: " << _cartridge.size << " bytes" << std::endl;
+        return false;
+    }
+
+    _hash = _cartridge.hash();
+    _className = options.className.empty() ? MakeClassName(options.romPath) : options.className;
+    if (options.overrideQuirks) {
+        _quirks = options.quirks & Quirk::All;
+    } else {
+        const RomProfile* profile = RomProfile::Find(_hash);
+        _quirks = (profile != nullptr) ? profile->Quirks : Quirk::None;
+    }
+
+    Analyze();
+    BuildBlocks();
+
+    char quirkNames[64];
+    Quirk::Format(_quirks, quirkNames, sizeof(quirkNames));
+    std::cout << "[Aot] rom: " << options.romPath << " (" << _cartridge.size << " bytes)" << std::endl;
+    std::cout << "[Aot] quirks: " << quirkNames << std::endl;
+    std::cout << "[Aot] code: " << _opcodeCount << " opcodes in " << _blocks.size() << " blocks, "
+              << _functions.size() << " subroutines, " << _computedJumps.size() << " computed jumps" << std::endl;
+
+    const std::string headerPath = options.outputBase + ".h";
+    const std::string sourcePath = options.outputBase + ".cpp";
+
+    std::ofstream header(headerPath);
+    if (!header) {
+        std::cerr << "[Aot] failed to write " << headerPath << std::endl;
+        return false;
+    }
+    EmitHeader(header);
+
+    std::ofstream source(sourcePath);
+    if (!source) {
+        std::cerr << "[Aot] failed to write " << sourcePath << std::endl;
+        return false;
+    }
+    EmitSource(source, BaseName(headerPath));
+    if (options.emitMain) {
+        EmitMain(source);
+    }
+
+    std::cout << "[Aot] " << _className << " written to " << headerPath << " and " << sourcePath << std::endl;
+    return true;
+}
+
+bool Recompiler::InRom(const uint32_t address) const {
+    return address >= ProgramStart && address + 1u < ProgramStart + _cartridge.size;
+}
+
+uint16_t Recompiler::ReadCode(const uint16_t address) const {
+    const uint8_t* rom = _cartridge.buffer + (address - ProgramStart);
+    return static_cast<uint16_t>((rom[0] << 8) | rom[1]);
+}
+
+void Recompiler::AddLeader(const uint32_t address) {
+    if (!InRom(address)) return;
+
+    if (_leaders.insert(static_cast<uint16_t>(address)).second) {
+        _worklist.push_back(static_cast<uint16_t>(address));
+    }
+}
+
+void Recompiler::Analyze() {
+    AddressSet visited {};
+
+    AddLeader(ProgramStart);
+    while (!_worklist.empty()) {
+        uint16_t pc = _worklist.back();
+        _worklist.pop_back();
+
+        while (InRom(pc) && !visited[pc]) {
+            visited.set(pc);
+            _opcodeCount += 1u;
+
+            const uint16_t code = ReadCode(pc);
+            const uint16_t next = pc + 2u;
+            const uint16_t nnn = code & 0x0FFF;
+
+            if (IsSkip(code)) {
+                AddLeader(next);
+                AddLeader(next + 2u);
+                break;
+            }
+            if (code == 0x00EE) break;
+
+            const uint16_t group = code & 0xF000;
+            if (group == 0x1000) {
+                AddLeader(nnn);
+                break;
+            }
+            if (group == 0x2000) {
+                // the return lands right after the call
+                _functions[nnn].push_back(pc);
+                AddLeader(nnn);
+                AddLeader(next);
+                break;
+            }
+            if (group == 0xB000) {
+                // nnn + V0 (or xnn + Vx): any of the 256 bytes from nnn on.
+                // Only the even ones are taken, odd targets run interpreted.
+                _computedJumps.push_back(pc);
+                for (uint32_t offset = 0u; offset <= 0xFF; offset += 2u) {
+                    AddLeader(nnn + offset);
+                }
+                break;
+            }
+            if (EndsBlock(code)) {
+                AddLeader(next);
+                break;
+            }
+            pc = next;
+        }
+    }
+}
+
+void Recompiler::BuildBlocks() {
+    // a block runs until an opcode that ends it, the next leader or the end
+    // of the ROM; blocks cut at MaxBlockLength add a leader where they stop,
+    // which the loop reaches since std::set iterates in order
+    for (auto it = _leaders.begin(); it != _leaders.end(); ++it) {
+        Block block;
+        block.Start = *it;
+
+        uint16_t pc = block.Start;
+        while (InRom(pc)) {
+            if (pc != block.Start && _leaders.count(pc) != 0u) break;
+            if (block.Length == MaxBlockLength) {
+                _leaders.insert(pc);
+                break;
+            }
+
+            const uint16_t code = ReadCode(pc);
+            pc += 2u;
+            block.Length += 1u;
+            if (EndsBlock(code)) break;
+        }
+
+        block.End = pc;
+        if (block.Length > 0u) {
+            _blocks.push_back(block);
+        }
+    }
+
+    for (size_t i = 0u; i < _blocks.size(); i++) {
+        for (uint16_t pc = _blocks[i].Start; pc < _blocks[i].End; pc += 2u) {
+            _entries[pc] = i;
+        }
+    }
+}
+
+void Recompiler::EmitHeader(std::ostream& out) const {
+    char quirkNames[64];
+    Quirk::Format(_quirks, quirkNames, sizeof(quirkNames));
+
+    Emit(out, "#pragma once\n\n");
+    Emit(out, "#include <cstdint>\n\n");
+    Emit(out, "#include \"chip8/console.h\"\n\n");
+    Emit(out, "// Generated by chip8_aot from %s, do not edit.\n", BaseName(_options.romPath).c_str());
+    Emit(out, "//\n");
+    Emit(out, "// Runs the ROM over a Console as native code, with the interpreter for what\n");
+    Emit(out, "// the analysis did not reach and for code the ROM has rewritten. One instance\n");
+    Emit(out, "// per Console; the results are the same as those of Console::Cycle.\n");
+    Emit(out, "class %s {\n", _className.c_str());
+    Emit(out, "public:\n");
+    Emit(out, "    static constexpr uint64_t RomHash = 0x%016llXull;\n", static_cast<unsigned long long>(_hash));
+    Emit(out, "    // %s; any other set runs on the interpreter\n", quirkNames);
+    Emit(out, "    static constexpr uint8_t Quirks = 0x%02Xu;\n\n", _quirks);
+    Emit(out, "    %s();\n\n", _className.c_str());
+    Emit(out, "    // Same as CPU::Run\n");
+    Emit(out, "    uint32_t Run(Console& console, uint32_t count);\n");
+    Emit(out, "    // Same as Console::Cycle\n");
+    Emit(out, "    void Cycle(Console& console);\n\n");
+    Emit(out, "private:\n");
+    Emit(out, "    static constexpr size_t BlockCount = %zu;\n\n", _blocks.size());
+    Emit(out, "    // Compares the block with the ROM after a memory write; the callers\n");
+    Emit(out, "    // skip it while _verifiedAt of the block is current\n");
+    Emit(out, "    bool Verify(const Console& console, size_t block, uint16_t start, uint16_t end);\n\n");
+    Emit(out, "    // CPU::MemoryWriteCount when each block was last checked against memory\n");
+    Emit(out, "    uint64_t _verifiedAt[BlockCount > 0u ? BlockCount : 1u];\n");
+    Emit(out, "};\n");
+}
+
+void Recompiler::EmitSource(std::ostream& out, const std::string& headerName) const {
+    Emit(out, "#include \"%s\"\n\n", headerName.c_str());
+    Emit(out, "#include <cstring>\n\n");
+    Emit(out, "// Generated by chip8_aot from %s, do not edit.\n\n", BaseName(_options.romPath).c_str());
+
+    Emit(out, "namespace {\n");
+    Emit(out, "    const uint8_t Rom[%zu] = {", _cartridge.size > 0u ? _cartridge.size : 1u);
+    for (size_t i = 0u; i < _cartridge.size; i++) {
+        Emit(out, "%s0x%02X,", (i % 16u == 0u) ? "\n            " : " ", _cartridge.buffer[i]);
+    }
+    Emit(out, "\n    };\n");
+    Emit(out, "}\n\n");
+
+    Emit(out, "%s::%s() {\n", _className.c_str(), _className.c_str());
+    Emit(out, "    for (uint64_t& verifiedAt : _verifiedAt) {\n");
+    Emit(out, "        verifiedAt = ~0ull;\n");
+    Emit(out, "    }\n");
+    Emit(out, "}\n\n");
+
+    Emit(out, "bool %s::Verify(const Console& console, const size_t block, const uint16_t start, const uint16_t end) {\n", _className.c_str());
+    Emit(out, "    const uint64_t writes = console.Cpu.MemoryWriteCount;\n");
+    Emit(out, "    if (memcmp(console.Memory.GetPtr(start), Rom + (start - 0x%03Xu), end - start) != 0) return false;\n", ProgramStart);
+    Emit(out, "    _verifiedAt[block] = writes;\n");
+    Emit(out, "    return true;\n");
+    Emit(out, "}\n\n");
+
+    Emit(out, "uint32_t %s::Run(Console& console, const uint32_t count) {\n", _className.c_str());
+    Emit(out, "    CPU& cpu = console.Cpu;\n");
+    Emit(out, "    // the recorder and the profiler have to see every instruction\n");
+    Emit(out, "    if (cpu.GetQuirks() != Quirks || cpu.Recorder != nullptr || cpu.Profile != nullptr) {\n");
+    Emit(out, "        return cpu.Run(count);\n");
+    Emit(out, "    }\n");
+    Emit(out, "    if (!cpu.ResumeFromKeyWait()) return 0u;\n\n");
+    Emit(out, "    uint8_t* const V = cpu.V;\n");
+    Emit(out, "    uint32_t left = count;\n");
+    Emit(out, "    // counted by cpu.Run, the rest goes to InstructionCount below\n");
+    Emit(out, "    uint32_t interpreted = 0u;\n");
+    Emit(out, "    while (left > 0u && !cpu.Halted) {\n");
+    Emit(out, "        // every opcode is an entry point, a frame may end anywhere in a block\n");
+    Emit(out, "        switch (cpu.PC) {\n");
+    for (const auto& entry : _entries) {
+        const Block& block = _blocks[entry.second];
+        Emit(out, "            case 0x%03X: if (_verifiedAt[%zuu] == cpu.MemoryWriteCount || Verify(console, %zuu, 0x%03Xu, 0x%03Xu)) goto at_%03X; break;\n",
+             entry.first, entry.second, entry.second, block.Start, block.End, entry.first);
+    }
+    Emit(out, "            default: break;\n");
+    Emit(out, "        }\n\n");
+    Emit(out, "        {\n");
+    Emit(out, "            // not recompiled or rewritten since\n");
+    Emit(out, "            const uint32_t ran = cpu.Run(1u);\n");
+    Emit(out, "            interpreted += ran;\n");
+    Emit(out, "            left -= ran;\n");
+    Emit(out, "            continue;\n");
+    Emit(out, "        }\n");
+    for (const Block& block : _blocks) {
+        EmitBlock(out, block);
+    }
+    Emit(out, "    }\n\n");
+    Emit(out, "done:\n");
+    Emit(out, "    cpu.InstructionCount += count - left - interpreted;\n");
+    Emit(out, "    return count - left;\n");
+    Emit(out, "}\n\n");
+
+    Emit(out, "void %s::Cycle(Console& console) {\n", _className.c_str());
+    Emit(out, "    CPU& cpu = console.Cpu;\n");
+    Emit(out, "    if (!cpu.ResumeFromKeyWait()) return;\n\n");
+    Emit(out, "    cpu.Flags.Sound = false;\n\n");
+    Emit(out, "    const uint32_t cycles = console.Settings.CyclesPerFrame;\n");
+    Emit(out, "    const uint32_t done = console.Settings.SkipIdleLoops ? cpu.SkipIdleLoop(cycles) : 0u;\n");
+    Emit(out, "    if (done < cycles) {\n");
+    Emit(out, "        Run(console, cycles - done);\n");
+    Emit(out, "    }\n");
+    Emit(out, "    if (cpu.Halted) return;\n\n");
+    Emit(out, "    cpu.UpdateTimers();\n\n");
+    Emit(out, "    cpu.Flags.Sound = (cpu.Sound > 0u);\n");
+    Emit(out, "}\n");
+}
+
+void Recompiler::EmitBlock(std::ostream& out, const Block& block) const {
+    Emit(out, "\n");
+    const auto function = _functions.find(block.Start);
+    if (function != _functions.end()) {
+        Emit(out, "        // subroutine, called from");
+        for (const uint16_t caller : function->second) {
+            Emit(out, " 0x%03X", caller);
+        }
+        Emit(out, "\n");
+    }
+
+    for (uint16_t pc = block.Start; pc < block.End; pc += 2u) {
+        const uint16_t code = ReadCode(pc);
+        const uint16_t next = pc + 2u;
+        Emit(out, "    at_%03X:\n", pc);
+        EmitOpcode(out, code, pc);
+
+        if (IsSkip(code)) {
+            Emit(out, "        if (%s) {\n", SkipCondition(code).c_str());
+            EmitExit(out, pc + 4u, "    ");
+            Emit(out, "        }\n");
+            EmitExit(out, next, "");
+        } else if ((code & 0xF000) == 0x1000 || (code & 0xF000) == 0x2000) {
+            EmitExit(out, code & 0x0FFF, "");
+        } else if (code == 0x00EE || (code & 0xF000) == 0xB000 || (code & 0xF0FF) == 0xF00A) {
+            // PC is only known at runtime, or the CPU halted
+            Emit(out, "        if (--left == 0u) goto done;\n");
+            Emit(out, "        continue;\n");
+        } else if (next == block.End) {
+            // the last opcode, or Fx33/Fx55
+            EmitExit(out, next, "");
+        } else {
+            Emit(out, "        if (--left == 0u) {\n");
+            Emit(out, "            cpu.PC = 0x%03Xu;\n", next);
+            Emit(out, "            goto done;\n");
+            Emit(out, "        }\n");
+        }
+    }
+}
+
+void Recompiler::EmitExit(std::ostream& out, const uint16_t target, const char* indent) const {
+    Emit(out, "%s        cpu.PC = 0x%03Xu;\n", indent, target);
+    Emit(out, "%s        if (--left == 0u) goto done;\n", indent);
+
+    // go straight on to a recompiled target, without the switch
+    const auto entry = _entries.find(target);
+    if (entry != _entries.end()) {
+        const Block& block = _blocks[entry->second];
+        Emit(out, "%s        if (_verifiedAt[%zuu] == cpu.MemoryWriteCount || Verify(console, %zuu, 0x%03Xu, 0x%03Xu)) goto at_%03X;\n",
+             indent, entry->second, entry->second, block.Start, block.End, target);
+    }
+    Emit(out, "%s        continue;\n", indent);
+}
+
+void Recompiler::EmitOpcode(std::ostream& out, const uint16_t code, const uint16_t pc) const {
+    char text[32];
+    Opcode::Disassemble(code, text, sizeof(text));
+    Emit(out, "        // 0x%03X  %04X  %s\n", pc, code, text);
+
+    const Opcode opcode(code);
+    const uint8_t x = opcode.X();
+    const uint8_t y = opcode.Y();
+    const uint8_t kk = opcode.KK();
+    const uint16_t nnn = opcode.NNN();
+    const uint16_t next = pc + 2u;
+
+    // the interpreter's statements, in its order, with the operands and the
+    // quirks filled in; jumps and skips are left to EmitBlock
+    const bool logicResetsVF = (_quirks & Quirk::LogicResetsVF) != 0u;
+    const bool shiftUsesVy = (_quirks & Quirk::ShiftUsesVy) != 0u;
+    const bool loadStoreIncrementsI = (_quirks & Quirk::LoadStoreIncrementsI) != 0u;
+
+    switch (code & 0xF000) {
+        case 0x0000:
+            if (code == 0x00E0) {
+                Emit(out, "        console.Screen.Clear();\n");
+            } else if (code == 0x00EE) {
+                Emit(out, "        cpu.PC = console.Stack.Pop();\n");
+            }
+            // 0nnn is ignored
+            return;
+        case 0x2000:
+            // stack faults only go to a Recorder, which Run leaves to the CPU
+            Emit(out, "        console.Stack.Push(0x%03Xu);\n", next);
+            return;
+        case 0x6000:
+            Emit(out, "        V[0x%X] = 0x%02Xu;\n", x, kk);
+            return;
+        case 0x7000:
+            Emit(out, "        V[0x%X] += 0x%02Xu;\n", x, kk);
+            return;
+        case 0x8000:
+            switch (code & 0x000F) {
+                case 0x0:
+                    Emit(out, "        V[0x%X] = V[0x%X];\n", x, y);
+                    return;
+                case 0x1:
+                case 0x2:
+                case 0x3: {
+                    static const char* const operators[] = {nullptr, "|=", "&=", "^="};
+                    Emit(out, "        V[0x%X] %s V[0x%X];\n", x, operators[code & 0x000F], y);
+                    if (logicResetsVF) Emit(out, "        V[0xF] = 0u;\n");
+                    return;
+                }
+                case 0x4:
+                    Emit(out, "        {\n");
+                    Emit(out, "            const uint16_t sum = V[0x%X] + V[0x%X];\n", x, y);
+                    Emit(out, "            V[0xF] = sum > 0xFF;\n");
+                    Emit(out, "            V[0x%X] = static_cast<uint8_t>(sum);\n", x);
+                    Emit(out, "        }\n");
+                    return;
+                case 0x5:
+                    Emit(out, "        V[0xF] = V[0x%X] > V[0x%X];\n", x, y);
+                    Emit(out, "        V[0x%X] -= V[0x%X];\n", x, y);
+                    return;
+                case 0x6:
+                case 0xE: {
+                    // Vx is read again after VF is written, which matters for x = F
+                    const bool right = (code & 0x000F) == 0x6;
+                    char source[32];
+                    if (shiftUsesVy) {
+                        Emit(out, "        {\n");
+                        Emit(out, "            const uint8_t Vy = V[0x%X];\n", y);
+                        snprintf(source, sizeof(source), "Vy");
+                    } else {
+                        snprintf(source, sizeof(source), "V[0x%X]", x);
+                    }
+                    const char* indent = shiftUsesVy ? "    " : "";
+                    if (right) {
+                        Emit(out, "%s        V[0xF] = %s & 0x01u;\n", indent, source);
+                        Emit(out, "%s        V[0x%X] = %s / 2u;\n", indent, x, source);
+                    } else {
+                        Emit(out, "%s        V[0xF] = (%s & 0x80u) >> 7;\n", indent, source);
+                        Emit(out, "%s        V[0x%X] = static_cast<uint8_t>(%s * 2u);\n", indent, x, source);
+                    }
+                    if (shiftUsesVy) Emit(out, "        }\n");
+                    return;
+                }
+                case 0x7:
+                    Emit(out, "        V[0xF] = V[0x%X] > V[0x%X];\n", y, x);
+                    Emit(out, "        V[0x%X] = V[0x%X] - V[0x%X];\n", x, y, x);
+                    return;
+                default:
+                    return;
+            }
+        case 0xA000:
+            Emit(out, "        cpu.I = 0x%03Xu;\n", nnn);
+            return;
+        case 0xB000:
+            Emit(out, "        cpu.PC = 0x%03Xu + V[0x%X];\n", nnn, (_quirks & Quirk::JumpUsesVx) != 0u ? x : 0u);
+            return;
+        case 0xC000:
+            Emit(out, "        V[0x%X] = cpu.Rng.Next() %% 255 & 0x%02Xu;\n", x, kk);
+            return;
+        case 0xD000:
+            Emit(out, "        {\n");
+            Emit(out, "            uint8_t rows[16];\n");
+            Emit(out, "            V[0xF] = console.Screen.DrawSprite<%s>(V[0x%X], V[0x%X], console.Memory.GetRange(cpu.I, %u, rows), %u);\n",
+                 (_quirks & Quirk::ClipSprites) != 0u ? "true" : "false", x, y, opcode.N(), opcode.N());
+            Emit(out, "        }\n");
+            return;
+        case 0xF000:
+            switch (kk) {
+                case 0x07:
+                    Emit(out, "        V[0x%X] = cpu.Delay;\n", x);
+                    return;
+                case 0x0A:
+                    // halts until a key press, which only the CPU can resume from
+                    Emit(out, "        cpu.PC = 0x%03Xu;\n", next);
+                    Emit(out, "        cpu.Exec(0x%04X);\n", code);
+                    return;
+                case 0x15:
+                    Emit(out, "        cpu.Delay = V[0x%X];\n", x);
+                    return;
+                case 0x18:
+                    Emit(out, "        cpu.Sound = V[0x%X];\n", x);
+                    return;
+                case 0x1E:
+                    Emit(out, "        cpu.I += V[0x%X];\n", x);
+                    return;
+                case 0x29:
+                    Emit(out, "        cpu.I = V[0x%X] * %uu;\n", x, CHIP8_DEFAULT_SPRITE_HEIGHT);
+                    return;
+                case 0x33:
+                    Emit(out, "        {\n");
+                    Emit(out, "            const uint8_t value = V[0x%X];\n", x);
+                    Emit(out, "            console.Memory.Write(cpu.I, value / 100u);\n");
+                    Emit(out, "            console.Memory.Write(cpu.I + 1u, value / 10u %% 10u);\n");
+                    Emit(out, "            console.Memory.Write(cpu.I + 2u, value %% 10u);\n");
+                    Emit(out, "        }\n");
+                    return;
+                case 0x55:
+                case 0x65:
+                    for (uint8_t i = 0u; i <= x; i++) {
+                        if (kk == 0x55) {
+                            Emit(out, "        console.Memory.Write(cpu.I + %uu, V[0x%X]);\n", i, i);
+                        } else {
+                            Emit(out, "        V[0x%X] = console.Memory.Read(cpu.I + %uu);\n", i, i);
+                        }
+                    }
+                    if (loadStoreIncrementsI) Emit(out, "        cpu.I += %uu;\n", x + 1u);
+                    return;
+                default:
+                    return;
+            }
+        default:
+            return;
+    }
+}
+
+void Recompiler::EmitMain(std::ostream& out) const {
+    Emit(out, "\n");
+    Emit(out, "// Runs the ROM for a number of frames without a window and prints what\n");
+    Emit(out, "// chip8_headless prints for the same frames and seed\n");
+    Emit(out, "#include <chrono>\n");
+    Emit(out, "#include <cstdio>\n");
+    Emit(out, "#include <cstdlib>\n");
+    Emit(out, "#include <memory>\n\n");
+    Emit(out, "int main(int argc, char* argv[]) {\n");
+    Emit(out, "    const uint64_t frames = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 600u;\n");
+    Emit(out, "    const uint32_t seed = (argc > 2) ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 0u;\n");
+    Emit(out, "    const uint32_t cycles = (argc > 3) ? static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)) : 0u;\n\n");
+    Emit(out, "    std::unique_ptr<Console> console(new Console());\n");
+    Emit(out, "    std::unique_ptr<%s> program(new %s());\n\n", _className.c_str(), _className.c_str());
+    Emit(out, "    Cartridge cartridge;\n");
+    Emit(out, "    cartridge.buffer = new uint8_t[sizeof(Rom)];\n");
+    Emit(out, "    cartridge.size = sizeof(Rom);\n");
+    Emit(out, "    memcpy(cartridge.buffer, Rom, sizeof(Rom));\n\n");
+    Emit(out, "    if (cycles > 0u) {\n");
+    Emit(out, "        console->Settings.CyclesPerFrame = cycles;\n");
+    Emit(out, "    }\n");
+    Emit(out, "    console->Cpu.Rng.Seed(seed);\n");
+    Emit(out, "    console->InsertCartridge(cartridge);\n");
+    Emit(out, "    console->Cpu.SetQuirks(%s::Quirks);\n\n", _className.c_str());
+    Emit(out, "    const auto start = std::chrono::steady_clock::now();\n");
+    Emit(out, "    uint64_t frame = 0u;\n");
+    Emit(out, "    for (; frame < frames && !console->Cpu.Halted; frame++) {\n");
+    Emit(out, "        program->Cycle(*console);\n");
+    Emit(out, "    }\n");
+    Emit(out, "    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();\n\n");
+    Emit(out, "    printf(\"[Aot] frames: %%llu\\n\", static_cast<unsigned long long>(frame));\n");
+    Emit(out, "    printf(\"[Aot] instructions: %%llu\\n\", static_cast<unsigned long long>(console->Cpu.InstructionCount));\n");
+    Emit(out, "    printf(\"[Aot] wall time: %%g ms\\n\", ms);\n");
+    Emit(out, "    printf(\"[Aot] screen: %%016llx\\n\", static_cast<unsigned long long>(console->Screen.Hash()));\n");
+    Emit(out, "    if (ms > 0.0) {\n");
+    Emit(out, "        printf(\"[Aot] instructions/sec: %%g\\n\", console->Cpu.InstructionCount / (ms / 1000.0));\n");
+    Emit(out, "    }\n");
+    Emit(out, "    return 0;\n");
+    Emit(out, "}\n");
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "chip8/cartridge/cartridge.h"
+#include "chip8/constants.h"
+#include "chip8/cpu/quirks.h"
+
+// Recompiles a ROM ahead of time into C++ that runs it over a Console. The
+// code reachable from CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD is split into basic
+// blocks, each a case of a switch on PC that runs its opcodes natively. A
+// block checks its bytes against memory again after any memory write, so
+// rewritten code, and code the analysis did not reach, runs on the
+// interpreter instead.
+class Recompiler {
+public:
+    struct Options {
+        char* romPath = nullptr;
+        // Writes <outputBase>.h and <outputBase>.cpp
+        std::string outputBase;
+        // The generated class; made from the ROM file name when empty
+        std::string className;
+
+        // Build for these quirks instead of the ones of the ROM's profile
+        bool overrideQuirks = false;
+        uint8_t quirks = Quirk::None;
+
+        // Also emit a main() that runs the ROM without window and prints what
+        // chip8_headless prints, to compare the two
+        bool emitMain = false;
+    };
+
+    bool Run(const Options& options);
+
+private:
+    struct Block {
+        uint16_t Start = 0u;
+        uint16_t End = 0u;    // address right after the last opcode
+        uint32_t Length = 0u; // number of opcodes
+    };
+
+    // Blocks are cut at this many opcodes, which bounds what is compared
+    // against memory to enter one after a write
+    static constexpr uint32_t MaxBlockLength = 64u;
+
+    bool InRom(uint32_t address) const;
+    uint16_t ReadCode(uint16_t address) const;
+
+    void AddLeader(uint32_t address);
+    void Analyze();
+    void BuildBlocks();
+
+    void EmitHeader(std::ostream& out) const;
+    void EmitSource(std::ostream& out, const std::string& headerName) const;
+    void EmitBlock(std::ostream& out, const Block& block) const;
+    void EmitOpcode(std::ostream& out, uint16_t code, uint16_t pc) const;
+    // Sets PC to a target known at compile time and chains to its block
+    void EmitExit(std::ostream& out, uint16_t target, const char* indent) const;
+    void EmitMain(std::ostream& out) const;
+
+    Options _options;
+    Cartridge _cartridge = {};
+    uint64_t _hash = 0u;
+    uint8_t _quirks = Quirk::None;
+    std::string _className;
+
+    // Block starts: the load address, jump, call and skip targets, return
+    // addresses and the possible targets of Bnnn
+    std::set<uint16_t> _leaders;
+    std::vector<uint16_t> _worklist;
+    std::vector<Block> _blocks;
+    // address of every recompiled opcode -> index of its block
+    std::map<uint16_t, size_t> _entries;
+
+    // subroutine entry -> addresses of the calls to it
+    std::map<uint16_t, std::vector<uint16_t>> _functions;
+    // addresses of the Bnnn opcodes
+    std::vector<uint16_t> _computedJumps;
+    uint32_t _opcodeCount = 0u;
+};
@@ -0,0 +1,148 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#include "chip8/cpu/profiler.h"
+
+namespace {
+    constexpr uint64_t MaxIterations = 1ull << 40;
+
+    double TimeRun(const BenchRunner::Body& body, const uint64_t iterations) {
+        const auto start = std::chrono::steady_clock::now();
+        body(iterations);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    std::string GetCompiler() {
+        char text[64];
+#if defined(__clang__)
+        snprintf(text, sizeof(text), "clang %d.%d.%d", __clang_major__, __clang_minor__, __clang_patchlevel__);
+#elif defined(__GNUC__)
+        snprintf(text, sizeof(text), "gcc %d.%d.%d", __GNUC__, __GNUC_MINOR__, __GNUC_PATCHLEVEL__);
+#elif defined(_MSC_VER)
+        snprintf(text, sizeof(text), "msvc %d", _MSC_VER);
+#else
+        snprintf(text, sizeof(text), "unknown");
+#endif
+        return text;
+    }
+
+    void WriteJsonString(std::ostream& out, const std::string& text) {
+        out << '"';
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                out << '\\';
+            }
+            out << c;
+        }
+        out << '"';
+    }
+
+    void WriteJsonNumber(std::ostream& out, const double value) {
+        char text[32];
+        snprintf(text, sizeof(text), "%.3f", value);
+        out << text;
+    }
+}
+
+BenchRunner::BenchRunner(const Options& options)
+        : _options(options) {
+    if (_options.repetitions == 0u) {
+        _options.repetitions = 1u;
+    }
+}
+
+void BenchRunner::Run(const std::string& name, const Body& body, const std::function<void()>& setup) {
+    if (!_options.filter.empty() && name.find(_options.filter) == std::string::npos) return;
+
+    if (_options.listOnly) {
+        std::cout << name << std::endl;
+        return;
+    }
+
+    // Calibrate, which also warms up caches and the branch predictor
+    const double minNs = _options.minTimeMs * 1e6;
+    uint64_t iterations = 1u;
+    for (;;) {
+        if (setup) setup();
+        const double ns = TimeRun(body, iterations);
+        if (ns >= minNs || iterations >= MaxIterations) break;
+
+        // aim a little past the minimum so the next run is likely the last
+        const double scale = (ns > 0.0) ? (minNs * 1.2 / ns) : 10.0;
+        iterations = static_cast<uint64_t>(static_cast<double>(iterations) * std::min(std::max(scale, 1.5), 10.0)) + 1u;
+    }
+
+    std::vector<double> samples;
+    for (uint32_t i = 0u; i < _options.repetitions; i++) {
+        if (setup) setup();
+        samples.push_back(TimeRun(body, iterations) / static_cast<double>(iterations));
+    }
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.repetitions = _options.repetitions;
+    result.minNs = samples.front();
+    result.medianNs = samples[samples.size() / 2u];
+    result.maxNs = samples.back();
+    _results.push_back(result);
+
+    WriteTableRow(std::cout, result);
+}
+
+void BenchRunner::WriteTableHeader(std::ostream& out) const {
+    char line[160];
+    snprintf(line, sizeof(line), "%-44s %14s %12s %12s %12s", "benchmark", "iterations", "min ns", "median ns", "max ns");
+    out << line << std::endl;
+}
+
+void BenchRunner::WriteTableRow(std::ostream& out, const BenchResult& result) {
+    char line[160];
+    snprintf(line, sizeof(line), "%-44s %14llu %12.2f %12.2f %12.2f", result.name.c_str(),
+             static_cast<unsigned long long>(result.iterations), result.minNs, result.medianNs, result.maxNs);
+    out << line << std::endl;
+}
+
+void BenchRunner::WriteJson(std::ostream& out) const {
+    out << "{" << std::endl;
+    out << "  \"schema\": " << SchemaVersion << "," << std::endl;
+    out << "  \"context\": {" << std::endl;
+    out << "    \"compiler\": ";
+    WriteJsonString(out, GetCompiler());
+    out << "," << std::endl;
+#ifdef NDEBUG
+    out << "    \"assertions\": false," << std::endl;
+#else
+    out << "    \"assertions\": true," << std::endl;
+#endif
+    out << "    \"profile\": " << (CHIP8_PROFILE ? "true" : "false") << "," << std::endl;
+    out << "    \"min_time_ms\": ";
+    WriteJsonNumber(out, _options.minTimeMs);
+    out << "," << std::endl;
+    out << "    \"repetitions\": " << _options.repetitions << std::endl;
+    out << "  }," << std::endl;
+
+    out << "  \"benchmarks\": [";
+    for (size_t i = 0u; i < _results.size(); i++) {
+        const BenchResult& result = _results[i];
+        out << ((i > 0u) ? "," : "") << std::endl;
+        out << "    {\"name\": ";
+        WriteJsonString(out, result.name);
+        out << ", \"iterations\": " << result.iterations;
+        out << ", \"min_ns\": ";
+        WriteJsonNumber(out, result.minNs);
+        out << ", \"median_ns\": ";
+        WriteJsonNumber(out, result.medianNs);
+        out << ", \"max_ns\": ";
+        WriteJsonNumber(out, result.maxNs);
+        out << "}";
+    }
+    out << std::endl << "  ]" << std::endl;
+    out << "}" << std::endl;
+}
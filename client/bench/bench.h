@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Keeps the compiler from optimizing away the computation of `value`
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    const volatile char* bytes = reinterpret_cast<const volatile char*>(&value);
+    (void)*bytes;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations = 0u;  // per repetition
+    uint32_t repetitions = 0u;
+    double minNs = 0.0;        // per iteration
+    double medianNs = 0.0;
+    double maxNs = 0.0;
+};
+
+// Times benchmark bodies. A body runs the measured operation `iterations`
+// times; the count is grown until one run lasts minTimeMs, then the body is
+// run that many times for every repetition.
+class BenchRunner {
+public:
+    struct Options {
+        double minTimeMs = 50.0;
+        uint32_t repetitions = 5u;
+        // Only benchmarks whose name contains this are run
+        std::string filter;
+        bool listOnly = false;
+    };
+
+    using Body = std::function<void(uint64_t iterations)>;
+
+    explicit BenchRunner(const Options& options);
+
+    // `setup` runs before every timed run (calibration included), untimed
+    void Run(const std::string& name, const Body& body, const std::function<void()>& setup = nullptr);
+
+    const std::vector<BenchResult>& GetResults() const { return _results; }
+
+    // One line per result, as the results come in
+    void WriteTableHeader(std::ostream& out) const;
+    static void WriteTableRow(std::ostream& out, const BenchResult& result);
+
+    // Results in run order. The layout only changes with `SchemaVersion`, so
+    // runs can be compared key by key.
+    void WriteJson(std::ostream& out) const;
+
+    static constexpr uint32_t SchemaVersion = 1u;
+
+private:
+    Options _options;
+    std::vector<BenchResult> _results;
+};
@@ -0,0 +1,337 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "bench.h"
+#include "chip8/console.h"
+#include "chip8/cartridge/cartridge.h"
+#include "chip8/state/console_state.h"
+
+// the benchmarks bring their own main()
+#define SDL_MAIN_HANDLED
+#include "../sdl/beeper.h"
+
+// Microbenchmarks of the emulator hot paths: single opcodes, sprite drawing,
+// memory and stack accesses, whole frames of the bundled ROMs and the audio
+// callback. Every benchmark reports ns per iteration.
+
+static void PrintUsage(const char* program) {
+    std::cout << "usage: " << program << " [options]" << std::endl
+              << "  --filter <text>       only run benchmarks whose name contains text" << std::endl
+              << "  --list                print the benchmark names and exit" << std::endl
+              << "  --json <path>         write the results as JSON" << std::endl
+              << "  --min-time <ms>       minimum duration of one timed run (default: 50)" << std::endl
+              << "  --repetitions <n>     timed runs per benchmark (default: 5)" << std::endl
+              << "  --rom-dir <path>      where the bundled roms are (default: rom)" << std::endl;
+}
+
+static const char* const Roms[] = {
+        "maze",
+        "pong",
+        "space-invaders",
+        "test-opcode",
+        "tetris",
+};
+
+static const struct {
+    const char* name;
+    CpuEngine engine;
+} Engines[] = {
+        {"switch", CpuEngine::Switch},
+        {"cached", CpuEngine::Cached},
+        {"threaded", CpuEngine::Threaded},
+        {"jit", CpuEngine::Jit},
+};
+
+// ---
+// CPU::Exec, one opcode family at a time. The registers are set so that no
+// opcode faults; the console is rebuilt before every timed run.
+
+struct ExecCase {
+    const char* name;
+    uint16_t codes[2]; // run in turn; 0 ends the list
+};
+
+static const ExecCase ExecCases[] = {
+        {"00E0_cls", {0x00E0u, 0u}},
+        {"1nnn_jp", {0x1300u, 0u}},
+        {"2nnn_00EE_call_ret", {0x2300u, 0x00EEu}},
+        {"3xkk_se", {0x3112u, 0u}},
+        {"5xy0_se", {0x5120u, 0u}},
+        {"6xkk_ld", {0x6A12u, 0u}},
+        {"7xkk_add", {0x7A01u, 0u}},
+        {"8xy0_ld", {0x8120u, 0u}},
+        {"8xy4_add", {0x8124u, 0u}},
+        {"8xy5_sub", {0x8125u, 0u}},
+        {"8xy6_shr", {0x8126u, 0u}},
+        {"Annn_ld_i", {0xA300u, 0u}},
+        {"Bnnn_jp_v0", {0xB300u, 0u}},
+        {"Cxkk_rnd", {0xC1FFu, 0u}},
+        {"Dxyn_drw", {0xD125u, 0u}},
+        {"ExA1_sknp", {0xE1A1u, 0u}},
+        {"Fx07_ld_dt", {0xF107u, 0u}},
+        {"Fx1E_add_i", {0xF31Eu, 0u}},
+        {"Fx29_ld_f", {0xF129u, 0u}},
+        {"Fx33_bcd", {0xF133u, 0u}},
+        {"Fx55_store", {0xFF55u, 0u}},
+        {"Fx65_load", {0xFF65u, 0u}},
+};
+
+static void ResetForExec(std::unique_ptr<Console>& console) {
+    static const uint8_t Data[16] = {
+            0xF0u, 0x90u, 0xF0u, 0x90u, 0x90u, 0xE0u, 0x90u, 0xE0u,
+            0x90u, 0xE0u, 0xF0u, 0x80u, 0x80u, 0x80u, 0xF0u, 0x00u,
+    };
+
+    console.reset(new Console());
+    console->Cpu.Rng.Seed(0u);
+    console->Memory.WriteBuffer(0x300u, Data, sizeof(Data));
+    console->Cpu.PC = CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD;
+    console->Cpu.I = 0x300u;
+    console->Cpu.V[1] = 7u;
+    console->Cpu.V[2] = 3u;
+    // Fx1E adds nothing, so I stays in range however often it runs
+    console->Cpu.V[3] = 0u;
+}
+
+static void BenchExec(BenchRunner& runner) {
+    std::unique_ptr<Console> console;
+
+    for (const ExecCase& entry : ExecCases) {
+        const uint16_t first = entry.codes[0];
+        const uint16_t second = entry.codes[1];
+        runner.Run(std::string("cpu/exec/") + entry.name, [&console, first, second](uint64_t iterations) {
+            CPU& cpu = console->Cpu;
+            for (uint64_t i = 0u; i < iterations; i++) {
+                cpu.Exec(first);
+                if (second != 0u) cpu.Exec(second);
+            }
+            DoNotOptimize(cpu.V);
+        }, [&console]() { ResetForExec(console); });
+    }
+}
+
+// ---
+// Screen
+
+static void BenchScreen(BenchRunner& runner) {
+    static const uint8_t Sprite[15] = {
+            0xFFu, 0x81u, 0xBDu, 0xA5u, 0xA5u, 0xBDu, 0x81u, 0xFFu,
+            0x3Cu, 0x42u, 0x99u, 0xA5u, 0x99u, 0x42u, 0x3Cu,
+    };
+
+    static const struct {
+        const char* name;
+        uint32_t x;
+        uint32_t y;
+    } Positions[] = {
+            {"aligned", 8u, 4u},    // whole byte columns
+            {"unaligned", 13u, 4u}, // straddles two byte columns
+            {"wrapping", 60u, 24u}, // wraps around the right and bottom edges
+    };
+
+    std::unique_ptr<Screen> screen(new Screen());
+
+    for (const auto& position : Positions) {
+        const uint32_t x = position.x;
+        const uint32_t y = position.y;
+        runner.Run(std::string("screen/draw_sprite/") + position.name, [&screen, x, y](uint64_t iterations) {
+            bool collision = false;
+            for (uint64_t i = 0u; i < iterations; i++) {
+                collision ^= screen->DrawSprite(x, y, Sprite, sizeof(Sprite));
+            }
+            DoNotOptimize(collision);
+            DoNotOptimize(screen->Rows);
+        }, [&screen]() { *screen = Screen {}; });
+    }
+
+    runner.Run("screen/clear", [&screen](uint64_t iterations) {
+        for (uint64_t i = 0u; i < iterations; i++) {
+            screen->Set(static_cast<uint32_t>(i) & 63u, static_cast<uint32_t>(i >> 6u) & 31u);
+            screen->Clear();
+            DoNotOptimize(screen->Rows);
+        }
+    }, [&screen]() { *screen = Screen {}; });
+}
+
+// ---
+// Memory and stack. Writes go through a console, so the decode cache of its
+// CPU is told about every one of them, as in a running program.
+
+static void BenchMemory(BenchRunner& runner) {
+    std::unique_ptr<Console> console(new Console());
+
+    runner.Run("memory/read", [&console](uint64_t iterations) {
+        Memory& memory = console->Memory;
+        uint32_t sum = 0u;
+        for (uint64_t i = 0u; i < iterations; i++) {
+            sum += memory.Read(static_cast<uint16_t>(i & (CHIP8_MEMORY_SIZE - 1u)));
+        }
+        DoNotOptimize(sum);
+    });
+
+    runner.Run("memory/write", [&console](uint64_t iterations) {
+        Memory& memory = console->Memory;
+        for (uint64_t i = 0u; i < iterations; i++) {
+            memory.Write(static_cast<uint16_t>(0x300u + (i & 0xFFu)), static_cast<uint8_t>(i));
+        }
+        DoNotOptimize(*memory.GetPtr(0x300u));
+    });
+
+    runner.Run("stack/push_pop", [&console](uint64_t iterations) {
+        Stack& stack = console->Stack;
+        uint32_t sum = 0u;
+        for (uint64_t i = 0u; i < iterations; i++) {
+            stack.Push(static_cast<uint16_t>(i));
+            sum += stack.Pop();
+        }
+        DoNotOptimize(sum);
+    });
+}
+
+// ---
+// Console::Cycle, one frame per iteration, on every bundled ROM with every
+// engine. Every timed run starts from power-on with the same RND seed, and
+// keys are pressed and released on a fixed schedule so that games waiting on
+// Fx0A keep running.
+
+static void BenchRoms(BenchRunner& runner, const std::string& romDir) {
+    for (const char* rom : Roms) {
+        std::string path = romDir + "/" + rom + ".ch8";
+        Cartridge cartridge {};
+        if (!cartridge.loadFromFile(&path[0])) {
+            std::cerr << "[Bench] skipping missing rom: " << path << std::endl;
+            continue;
+        }
+
+        std::unique_ptr<Console> console(new Console());
+        console->Cpu.Rng.Seed(0u);
+        console->InsertCartridge(cartridge);
+
+        std::unique_ptr<ConsoleState> start(new ConsoleState());
+        console->SaveState(*start);
+
+        for (const auto& entry : Engines) {
+            const CpuEngine engine = entry.engine;
+            uint64_t frame = 0u;
+            runner.Run(std::string("console/cycle/") + rom + "/" + entry.name, [&console, &frame](uint64_t iterations) {
+                for (uint64_t i = 0u; i < iterations; i++, frame++) {
+                    const uint16_t keys = (frame & 8u) ? static_cast<uint16_t>(1u << ((frame >> 4u) & 15u)) : 0u;
+                    console->Keyboard.SetKeyMask(keys);
+                    console->Cycle();
+                }
+                DoNotOptimize(console->Screen.Rows);
+            }, [&console, &start, &frame, engine]() {
+                console->Cpu.Engine = engine;
+                console->LoadState(*start);
+                frame = 0u;
+            });
+        }
+    }
+}
+
+// ---
+// Beeper::audioCallback, one 512-sample device buffer per iteration, without
+// an audio device. Two frames are queued per buffer; with "toggle" the beep
+// starts with the first and stops with the second, so every callback splits
+// its block.
+
+static void BenchBeeper(BenchRunner& runner) {
+    static const struct {
+        const char* name;
+        SDL_AudioFormat format;
+        uint8_t channels;
+        int mode; // 0: off, 1: on, 2: on for one frame, off for the next
+    } Cases[] = {
+            {"s16_mono/off", AUDIO_S16, 1u, 0},
+            {"s16_mono/on", AUDIO_S16, 1u, 1},
+            {"s16_mono/toggle", AUDIO_S16, 1u, 2},
+            {"f32_mono/on", AUDIO_F32, 1u, 1},
+            {"f32_stereo/on", AUDIO_F32, 2u, 1},
+    };
+
+    constexpr int Frequency = 44100;
+    constexpr uint16_t Samples = 512u;
+
+    std::vector<uint8_t> stream;
+    for (const auto& entry : Cases) {
+        SDL_AudioSpec spec;
+        SDL_zero(spec);
+        spec.freq = Frequency;
+        spec.format = entry.format;
+        spec.channels = entry.channels;
+        spec.samples = Samples;
+        spec.size = static_cast<uint32_t>(Samples) * entry.channels * SDL_AUDIO_BITSIZE(entry.format) / 8u;
+        stream.assign(spec.size, 0u);
+
+        const int mode = entry.mode;
+        runner.Run(std::string("beeper/callback/") + entry.name, [&stream, &spec, mode](uint64_t iterations) {
+            for (uint64_t i = 0u; i < iterations; i++) {
+                Beeper::queueFrame(mode != 0);
+                Beeper::queueFrame(mode == 1);
+                Beeper::audioCallback(nullptr, stream.data(), static_cast<int>(spec.size));
+            }
+            DoNotOptimize(stream[0]);
+        }, [&spec]() {
+            Beeper::configure(spec);
+            Beeper::setFrequency(440.0);
+            Beeper::setVolume(0.25);
+            Beeper::setFrameTime(1000.0 * (Samples / 2) / Frequency);
+        });
+    }
+
+    Beeper::close();
+}
+
+int main(int argc, char* argv[]) {
+    BenchRunner::Options options = {};
+    const char* jsonPath = nullptr;
+    std::string romDir = "rom";
+
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = (i + 1) < argc;
+        if (strcmp(argv[i], "--filter") == 0 && hasValue) {
+            options.filter = argv[++i];
+        } else if (strcmp(argv[i], "--list") == 0) {
+            options.listOnly = true;
+        } else if (strcmp(argv[i], "--json") == 0 && hasValue) {
+            jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0 && hasValue) {
+            options.minTimeMs = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--repetitions") == 0 && hasValue) {
+            options.repetitions = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--rom-dir") == 0 && hasValue) {
+            romDir = argv[++i];
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    BenchRunner runner {options};
+    if (!options.listOnly) {
+        runner.WriteTableHeader(std::cout);
+    }
+
+    BenchExec(runner);
+    BenchScreen(runner);
+    BenchMemory(runner);
+    BenchRoms(runner, romDir);
+    BenchBeeper(runner);
+
+    if (jsonPath != nullptr && !options.listOnly) {
+        std::ofstream stream(jsonPath);
+        runner.WriteJson(stream);
+        if (!stream.good()) {
+            std::cerr << "[Bench] failed to write " << jsonPath << std::endl;
+            return 1;
+        }
+        std::cout << "[Bench] results written to " << jsonPath << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include "farm.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+#include "chip8/console.h"
+#include "chip8/cpu/code_cache.h"
+#include "runner.h"
+#include "work_stealing_pool.h"
+
+bool RomFarm::Run(const Options& options) {
+    _cartridges.clear();
+    _scripts.clear();
+    _results.clear();
+
+    if (options.catalogPath != nullptr && !_catalog.LoadFromFile(options.catalogPath)) {
+        std::cerr << "[Farm] failed to read catalog " << options.catalogPath << std::endl;
+        return false;
+    }
+
+    for (char* path : options.roms) {
+        std::unique_ptr<Cartridge> cartridge(new Cartridge());
+        if (!cartridge->loadFromFile(path)) {
+            std::cerr << "[Farm] failed to load cartridge " << path << std::endl;
+            return false;
+        }
+        _cartridges.push_back(std::move(cartridge));
+    }
+
+    _codeCaches.clear();
+    if (options.codeCacheDir != nullptr) {
+        for (const std::unique_ptr<Cartridge>& cartridge : _cartridges) {
+            char name[32];
+            snprintf(name, sizeof(name), "/%016llx.c8cc", static_cast<unsigned long long>(cartridge->hash()));
+
+            std::unique_ptr<CodeCacheFile> file(new CodeCacheFile());
+            file->path = std::string(options.codeCacheDir) + name;
+            file->mapping.Open(file->path.c_str());
+            _codeCaches.push_back(std::move(file));
+        }
+    }
+
+    _scripts.resize(options.scripts.size());
+    for (size_t index = 0u; index < options.scripts.size(); index++) {
+        if (!_scripts[index].LoadFromFile(options.scripts[index])) {
+            return false;
+        }
+    }
+
+    const int32_t scriptCount = options.scripts.empty() ? 1 : static_cast<int32_t>(options.scripts.size());
+    const std::vector<uint32_t> seeds = options.seeds.empty() ? std::vector<uint32_t>{0u} : options.seeds;
+
+    _jobsPerRom = static_cast<size_t>(scriptCount) * seeds.size();
+    for (uint32_t rom = 0u; rom < _cartridges.size(); rom++) {
+        for (int32_t script = 0; script < scriptCount; script++) {
+            for (const uint32_t seed : seeds) {
+                Result result = {};
+                result.rom = rom;
+                result.script = options.scripts.empty() ? -1 : script;
+                result.seed = seed;
+                _results.push_back(result);
+            }
+        }
+    }
+
+    uint32_t threads = options.threads;
+    if (threads == 0u) {
+        threads = std::thread::hardware_concurrency();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    {
+        WorkStealingPool pool(threads);
+        // _results is not resized from here on, so jobs can keep references
+        for (Result& result : _results) {
+            pool.Submit([this, &options, &result](const uint32_t worker) {
+                result.worker = worker;
+                RunJob(options, result);
+            });
+        }
+        pool.Wait();
+
+        _threads = pool.GetThreadCount();
+        _steals = pool.GetStealCount();
+    }
+
+    for (const std::unique_ptr<CodeCacheFile>& file : _codeCaches) {
+        if (file->blob.empty()) continue;
+
+        file->mapping.Close();
+        if (!CodeCache::SaveToFile(file->blob, file->path.c_str())) {
+            std::cerr << "[Farm] failed to write code cache " << file->path << std::endl;
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    _wallTimeMs = std::chrono::duration<double, std::milli>(end - start).count();
+    return true;
+}
+
+void RomFarm::RunJob(const Options& options, Result& result) {
+    const auto start = std::chrono::steady_clock::now();
+
+    // built on the worker, so its memory is local to the thread that uses it
+    std::unique_ptr<Console> console(new Console());
+    console->Settings = options.settings;
+    console->Cpu.Engine = options.engine;
+    console->Cpu.Rng.Seed(result.seed);
+    const Cartridge& cartridge = *_cartridges[result.rom];
+    console->InsertCartridge(cartridge);
+    if (const RomEntry* entry = _catalog.Find(cartridge.hash(), cartridge.size)) {
+        console->Apply(*entry);
+        if (options.overrideCyclesPerFrame) {
+            console->Settings.CyclesPerFrame = options.settings.CyclesPerFrame;
+        }
+    }
+
+    CodeCacheFile* codeCache = _codeCaches.empty() ? nullptr : _codeCaches[result.rom].get();
+    if (codeCache != nullptr) {
+        CodeCache installed = {};
+        result.cached = installed.Install(console->Cpu, cartridge.hash(), codeCache->mapping.GetData(), codeCache->mapping.GetSize());
+    }
+
+    const InputScript* script = (result.script >= 0) ? &_scripts[result.script] : nullptr;
+    size_t cursor = 0u;
+
+    const uint64_t startInstructions = console->Cpu.InstructionCount;
+    for (uint64_t frame = 0u; frame < options.frames; frame++) {
+        if (script != nullptr) {
+            script->Apply(frame, *console, cursor);
+        }
+
+        console->Cycle();
+        result.frames += 1u;
+
+        // a Fx0A wait that no scripted key press will end
+        if (console->Cpu.Halted && (script == nullptr || cursor == script->GetEvents().size())) {
+            result.halted = true;
+            break;
+        }
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+
+    result.instructions = console->Cpu.InstructionCount - startInstructions;
+    result.screenHash = console->Screen.Hash();
+    result.wallTimeMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+    // the jobs of a ROM are next to each other, the first one writes its cache
+    const bool first = (static_cast<size_t>(&result - _results.data()) % _jobsPerRom) == 0u;
+    if (codeCache != nullptr && !result.cached && first) {
+        CodeCache::Serialize(console->Cpu, cartridge.hash(), codeCache->blob);
+    }
+}
+
+void RomFarm::PrintResults(const Options& options) const {
+    std::cout << "[Farm] engine: " << HeadlessRunner::GetEngineName(options.engine) << std::endl;
+
+    uint64_t instructions = 0u;
+    for (const Result& result : _results) {
+        const char* script = (result.script >= 0) ? options.scripts[result.script] : "-";
+
+        char hash[20];
+        snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(result.screenHash));
+
+        std::cout << "[Farm] " << options.roms[result.rom]
+                  << " script=" << script
+                  << " seed=" << result.seed
+                  << " frames=" << result.frames
+                  << " instructions=" << result.instructions
+                  << " screen=" << hash
+                  << " time=" << result.wallTimeMs << "ms"
+                  << " worker=" << result.worker
+                  << (result.halted ? " (waiting for a key)" : "")
+                  << std::endl;
+
+        instructions += result.instructions;
+    }
+
+    std::cout << "[Farm] jobs: " << _results.size() << std::endl;
+    if (options.codeCacheDir != nullptr) {
+        size_t cached = 0u;
+        for (const Result& result : _results) {
+            cached += result.cached ? 1u : 0u;
+        }
+        std::cout << "[Farm] started from a code cache: " << cached << " of " << _results.size() << " jobs" << std::endl;
+    }
+    std::cout << "[Farm] threads: " << _threads << std::endl;
+    std::cout << "[Farm] steals: " << _steals << std::endl;
+    std::cout << "[Farm] instructions: " << instructions << std::endl;
+    std::cout << "[Farm] wall time: " << _wallTimeMs << " ms" << std::endl;
+    if (_wallTimeMs > 0.0) {
+        std::cout << "[Farm] instructions/sec: " << (instructions / (_wallTimeMs / 1000.0)) << std::endl;
+    }
+}
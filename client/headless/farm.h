@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "chip8/cartridge/cartridge.h"
+#include "chip8/cartridge/rom_catalog.h"
+#include "chip8/constants.h"
+#include "chip8/cpu/cpu.h"
+#include "chip8/state/mapped_file.h"
+#include "input_script.h"
+
+// Runs every combination of ROM, input script and RND seed as an
+// independent Console on a WorkStealingPool. Each job owns its console, RNG
+// and settings, so the results are the same whatever the thread count.
+class RomFarm {
+public:
+    struct Options {
+        std::vector<char*> roms;
+        // no scripts = one run per ROM without input
+        std::vector<char*> scripts;
+        // no seeds = seed 0
+        std::vector<uint32_t> seeds;
+
+        // 0 = one thread per hardware thread
+        uint32_t threads = 0u;
+        uint64_t frames = 600u;
+        CpuSettings settings = {};
+        // settings.CyclesPerFrame wins over the one of the catalog
+        bool overrideCyclesPerFrame = false;
+        CpuEngine engine = CpuEngine::Cached;
+
+        // Run every ROM with the settings of its entry in this RomCatalog
+        char* catalogPath = nullptr;
+        // Start every job from the CodeCache of its ROM in this directory
+        // (<hash>.c8cc), written by the first job of the ROM when missing or stale
+        char* codeCacheDir = nullptr;
+    };
+
+    struct Result {
+        uint32_t rom = 0u;
+        // index into Options::scripts, -1 when the ROM ran without one
+        int32_t script = -1;
+        uint32_t seed = 0u;
+
+        uint64_t frames = 0u;
+        uint64_t instructions = 0u;
+        uint64_t screenHash = 0u;
+        bool halted = false;
+        double wallTimeMs = 0.0;
+        uint32_t worker = 0u;
+        // the job started from a CodeCache
+        bool cached = false;
+    };
+
+    bool Run(const Options& options);
+
+    void PrintResults(const Options& options) const;
+
+private:
+    void RunJob(const Options& options, Result& result);
+
+    std::vector<std::unique_ptr<Cartridge>> _cartridges;
+    std::vector<InputScript> _scripts;
+    RomCatalog _catalog;
+
+    // per ROM: its code cache file, mapped when it exists
+    struct CodeCacheFile {
+        std::string path;
+        MappedFile mapping;
+        // filled by the first job of the ROM when the file is stale
+        std::vector<uint8_t> blob;
+    };
+    std::vector<std::unique_ptr<CodeCacheFile>> _codeCaches;
+    size_t _jobsPerRom = 0u;
+    std::vector<Result> _results;
+
+    double _wallTimeMs = 0.0;
+    uint32_t _threads = 0u;
+    uint64_t _steals = 0u;
+};
@@ -0,0 +1,62 @@
+#include "input_script.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+bool InputScript::LoadFromFile(const char* path) {
+    _events.clear();
+
+    std::ifstream stream(path);
+    if (!stream.good()) {
+        std::cerr << "[Script] cannot open " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    uint32_t lineNumber = 0u;
+    while (std::getline(stream, line)) {
+        lineNumber += 1u;
+
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+
+        std::istringstream fields(line);
+        Event event = {};
+        std::string action;
+        uint32_t key = 0u;
+        if (!(fields >> event.frame)) continue; // blank line
+
+        if (!(fields >> action >> std::hex >> key) || key >= CHIP8_KEYS_SIZE
+            || (action != "down" && action != "up")) {
+            std::cerr << "[Script] " << path << ":" << lineNumber << ": expected '<frame> down|up <key>'" << std::endl;
+            return false;
+        }
+
+        event.key = static_cast<uint8_t>(key);
+        event.down = (action == "down");
+        _events.push_back(event);
+    }
+
+    std::stable_sort(_events.begin(), _events.end(), [](const Event& a, const Event& b) {
+        return a.frame < b.frame;
+    });
+    return true;
+}
+
+void InputScript::Apply(const uint64_t frame, Console& console, size_t& cursor) const {
+    while (cursor < _events.size() && _events[cursor].frame <= frame) {
+        const Event& event = _events[cursor];
+        if (event.down) {
+            console.Keyboard.SetKeyDown(event.key);
+        } else {
+            console.Keyboard.SetKeyUp(event.key);
+        }
+        cursor += 1u;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "chip8/console.h"
+
+// Key presses to replay into a console, one event per line:
+//
+//   # frame  action  key (hex)
+//   120      down    5
+//   135      up      5
+//
+// Events are applied right before the console runs the given frame.
+class InputScript {
+public:
+    struct Event {
+        uint64_t frame = 0u;
+        uint8_t key = 0u;
+        bool down = false;
+    };
+
+    bool LoadFromFile(const char* path);
+
+    // Applies every event of `frame`; frames must be visited in order
+    void Apply(uint64_t frame, Console& console, size_t& cursor) const;
+
+    const std::vector<Event>& GetEvents() const { return _events; }
+
+private:
+    std::vector<Event> _events;
+};
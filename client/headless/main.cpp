@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "farm.h"
+#include "runner.h"
+
+static void PrintUsage(const char* program) {
+    std::cout << "usage: " << program << " <rom> [options]" << std::endl
+              << "       " << program << " --farm --rom <rom> [--rom <rom>...] [farm options]" << std::endl
+              << "  --frames <n>            run for n frames (default: 600)" << std::endl
+              << "  --instructions <n>      run for at least n instructions" << std::endl
+              << "  --cycles-per-frame <n>  instructions executed per frame" << std::endl
+              << "  --engine <name>         switch, cached (default), threaded or jit" << std::endl
+              << "  --lockstep              check every jit block against the switch interpreter" << std::endl
+              << "  --quirks <list>         override the rom's quirks: none, vip, schip or any of shift-vy," << std::endl
+              << "                          load-store-i, jump-vx, clip, logic-vf (comma separated)" << std::endl
+              << "  --catalog <path>        start with the settings of the rom's entry in this catalog" << std::endl
+              << "  --update-catalog        write the settings and code found by this run back to --catalog" << std::endl
+              << "  --code-cache <path>     start from the decoded and translated code saved in this file, then update it" << std::endl
+              << "  --no-idle-skip          run spin loops instead of skipping to the next frame" << std::endl
+              << "  --batch <n>             run n copies of the rom side by side in a ConsoleBatch" << std::endl
+              << "  --seed <n>              RND seed (default: 0)" << std::endl
+              << "  --rewind <KiB>          record every frame into a rewind buffer of this size" << std::endl
+              << "  --script <path>         feed the key presses of an input script" << std::endl
+              << "  --record <path>         write the keys of every frame to a movie file" << std::endl
+              << "  --play <path>           replay a movie file (runs for its length by default)" << std::endl
+              << "  --profile               print executions per opcode and address (CHIP8_PROFILE builds)" << std::endl
+              << "  --profile-csv <path>    write the same profile as CSV" << std::endl
+              << "  --trace <path>          record the last instructions, written on the first fault or at exit" << std::endl
+              << "farm options:" << std::endl
+              << "  --rom <path>            add a rom, every rom runs with every script and seed" << std::endl
+              << "  --script <path>         add an input script (\"<frame> down|up <hex key>\" per line)" << std::endl
+              << "  --seed <n>              add a RND seed" << std::endl
+              << "  --threads <n>           worker threads (default: one per hardware thread)" << std::endl
+              << "  --code-cache <dir>      start every job from the code cache of its rom in this directory" << std::endl
+              << "  --frames, --cycles-per-frame, --engine and --catalog work as above" << std::endl;
+}
+
+static int RunFarm(int argc, char* argv[]) {
+    RomFarm::Options options = {};
+
+    for (int i = 2; i < argc; i++) {
+        const bool hasValue = (i + 1) < argc;
+        if (strcmp(argv[i], "--rom") == 0 && hasValue) {
+            options.roms.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--script") == 0 && hasValue) {
+            options.scripts.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+            options.seeds.push_back(static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+        } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            options.threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            options.frames = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--cycles-per-frame") == 0 && hasValue) {
+            options.settings.CyclesPerFrame = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+            options.overrideCyclesPerFrame = true;
+        } else if (strcmp(argv[i], "--engine") == 0 && hasValue) {
+            if (!HeadlessRunner::ParseEngine(argv[++i], options.engine)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--catalog") == 0 && hasValue) {
+            options.catalogPath = argv[++i];
+        } else if (strcmp(argv[i], "--code-cache") == 0 && hasValue) {
+            options.codeCacheDir = argv[++i];
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.roms.empty()) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    RomFarm farm = {};
+    if (!farm.Run(options)) {
+        return 1;
+    }
+
+    farm.PrintResults(options);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (strcmp(argv[1], "--farm") == 0) {
+        return RunFarm(argc, argv);
+    }
+
+    HeadlessRunner::Options options = {};
+    options.filePath = argv[1];
+
+    for (int i = 2; i < argc; i++) {
+        const bool hasValue = (i + 1) < argc;
+        if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            options.maxFrames = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--instructions") == 0 && hasValue) {
+            options.maxInstructions = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--cycles-per-frame") == 0 && hasValue) {
+            options.settings.CyclesPerFrame = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+            options.overrideCyclesPerFrame = true;
+        } else if (strcmp(argv[i], "--engine") == 0 && hasValue) {
+            if (!HeadlessRunner::ParseEngine(argv[++i], options.engine)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--catalog") == 0 && hasValue) {
+            options.catalogPath = argv[++i];
+        } else if (strcmp(argv[i], "--code-cache") == 0 && hasValue) {
+            options.codeCachePath = argv[++i];
+        } else if (strcmp(argv[i], "--update-catalog") == 0) {
+            options.updateCatalog = true;
+        } else if (strcmp(argv[i], "--quirks") == 0 && hasValue) {
+            if (!Quirk::Parse(argv[++i], options.quirks)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            options.overrideQuirks = true;
+        } else if (strcmp(argv[i], "--batch") == 0 && hasValue) {
+            options.batchSize = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+            options.seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--rewind") == 0 && hasValue) {
+            options.rewindBytes = static_cast<size_t>(strtoull(argv[++i], nullptr, 10)) * 1024u;
+        } else if (strcmp(argv[i], "--script") == 0 && hasValue) {
+            options.scriptPath = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && hasValue) {
+            options.recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--play") == 0 && hasValue) {
+            options.playPath = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && hasValue) {
+            options.tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--profile-csv") == 0 && hasValue) {
+            options.profileCsvPath = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            options.profile = true;
+        } else if (strcmp(argv[i], "--lockstep") == 0) {
+            options.lockstep = true;
+        } else if (strcmp(argv[i], "--no-idle-skip") == 0) {
+            options.settings.SkipIdleLoops = false;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.updateCatalog && options.catalogPath == nullptr) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (options.maxFrames == 0u && options.maxInstructions == 0u && options.playPath == nullptr) {
+        options.maxFrames = 600u;
+    }
+
+    HeadlessRunner runner = {};
+    HeadlessRunner::Report report = {};
+    if (!runner.Run(options, report)) {
+        return 1;
+    }
+
+    HeadlessRunner::PrintReport(report);
+    return 0;
+}
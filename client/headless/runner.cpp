@@ -0,0 +1,373 @@
+#include "runner.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "chip8/cpu/code_cache.h"
+
+static const struct {
+    const char* name;
+    CpuEngine engine;
+} Engines[] = {
+        {"switch", CpuEngine::Switch},
+        {"cached", CpuEngine::Cached},
+        {"threaded", CpuEngine::Threaded},
+        {"jit", CpuEngine::Jit},
+};
+
+bool HeadlessRunner::ParseEngine(const char* name, CpuEngine& outEngine) {
+    for (const auto& entry : Engines) {
+        if (strcmp(entry.name, name) == 0) {
+            outEngine = entry.engine;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* HeadlessRunner::GetEngineName(const CpuEngine engine) {
+    for (const auto& entry : Engines) {
+        if (entry.engine == engine) {
+            return entry.name;
+        }
+    }
+    return "unknown";
+}
+
+bool HeadlessRunner::Run(const Options& options, Report& outReport) {
+    outReport = {};
+
+    std::cout << "[Headless] rom: " << options.filePath << std::endl;
+    if (!_cartridge.loadFromFile(options.filePath)) {
+        std::cerr << "[Headless] failed to load cartridge" << std::endl;
+        return false;
+    }
+
+    if (options.batchSize > 0u) {
+        return RunBatch(options, outReport);
+    }
+
+    std::cout << "[Headless] engine: " << GetEngineName(options.engine) << std::endl;
+
+    _console.Settings = options.settings;
+    _console.Cpu.Rng.Seed(options.seed);
+    _console.Cpu.Engine = options.engine;
+    _console.Cpu.JitLockstep = options.lockstep;
+    _console.InsertCartridge(_cartridge);
+
+    RomCatalog catalog = {};
+    if (options.catalogPath != nullptr) {
+        if (!catalog.LoadFromFile(options.catalogPath)) {
+            std::cerr << "[Headless] failed to read catalog " << options.catalogPath << std::endl;
+            return false;
+        }
+
+        const RomEntry* entry = catalog.Find(_cartridge.hash(), _cartridge.size);
+        if (entry != nullptr) {
+            _console.Apply(*entry);
+            std::cout << "[Headless] catalog: " << (entry->Name.empty() ? "unnamed" : entry->Name.c_str()) << " ("
+                      << entry->Code.count() << " opcodes predecoded, " << entry->IdleLoops.count() << " in idle loops)" << std::endl;
+        } else {
+            std::cout << "[Headless] catalog: no entry for this rom" << std::endl;
+        }
+    }
+    if (options.overrideCyclesPerFrame) {
+        _console.Settings.CyclesPerFrame = options.settings.CyclesPerFrame;
+    }
+    if (options.overrideQuirks) {
+        _console.Cpu.SetQuirks(options.quirks);
+    }
+
+    char quirkNames[96];
+    Quirk::Format(_console.Cpu.GetQuirks(), quirkNames, sizeof(quirkNames));
+    std::cout << "[Headless] quirks: " << quirkNames << std::endl;
+
+    if (options.codeCachePath != nullptr) {
+        CodeCache codeCache = {};
+        if (codeCache.LoadFromFile(_console.Cpu, _cartridge.hash(), options.codeCachePath)) {
+            std::cout << "[Headless] code cache: " << codeCache.Opcodes << " opcodes, " << codeCache.Blocks << " blocks installed" << std::endl;
+        } else {
+            std::cout << "[Headless] code cache: none for this rom, quirks and engine version" << std::endl;
+        }
+    }
+
+    InputScript script = {};
+    if (options.scriptPath != nullptr && !script.LoadFromFile(options.scriptPath)) {
+        return false;
+    }
+    size_t scriptCursor = 0u;
+
+    Movie replay = {};
+    uint64_t maxFrames = options.maxFrames;
+    if (options.playPath != nullptr) {
+        if (!replay.LoadFromFile(options.playPath)) {
+            std::cerr << "[Headless] failed to load movie " << options.playPath << std::endl;
+            return false;
+        }
+        std::cout << "[Headless] movie: " << options.playPath << " (" << replay.Frames.size() << " frames, seed " << replay.Seed << ")" << std::endl;
+
+        _console.LoadState(replay.Start);
+        _console.Settings.CyclesPerFrame = replay.CyclesPerFrame;
+        if (maxFrames == 0u && options.maxInstructions == 0u) {
+            maxFrames = replay.Frames.size();
+        }
+    }
+
+    Movie recording = {};
+    if (options.recordPath != nullptr) {
+        recording.Seed = options.seed;
+        recording.CyclesPerFrame = _console.Settings.CyclesPerFrame;
+        _console.SaveState(recording.Start);
+    }
+
+    std::shared_ptr<CpuProfile> profile;
+    if (options.profile || options.profileCsvPath != nullptr) {
+        if (!CHIP8_PROFILE) {
+            std::cerr << "[Headless] built without CHIP8_PROFILE, the profile stays empty" << std::endl;
+        }
+        profile = std::make_shared<CpuProfile>();
+        _console.Cpu.Profile = profile.get();
+    }
+
+    std::unique_ptr<FlightRecorder> recorder;
+    if (options.tracePath != nullptr) {
+        recorder.reset(new FlightRecorder());
+        recorder->AutoDumpPath = options.tracePath;
+        _console.Cpu.Recorder = recorder.get();
+    }
+
+    std::unique_ptr<RewindBuffer> rewind;
+    if (options.rewindBytes > 0u) {
+        rewind.reset(new RewindBuffer(options.rewindBytes));
+    }
+    std::chrono::steady_clock::duration rewindTime {};
+
+    const uint64_t startInstructions = _console.Cpu.InstructionCount;
+    const uint64_t startIdleInstructions = _console.Cpu.IdleInstructionCount;
+    const auto start = std::chrono::steady_clock::now();
+
+    while (true) {
+        const uint64_t instructions = _console.Cpu.InstructionCount - startInstructions;
+        if (maxFrames != 0u && outReport.frames >= maxFrames) break;
+        if (options.maxInstructions != 0u && instructions >= options.maxInstructions) break;
+
+        // input changes land on frame boundaries, which is all a Movie can hold
+        bool moreInput = false;
+        if (options.playPath != nullptr) {
+            if (outReport.frames < replay.Frames.size()) {
+                _console.Keyboard.SetKeyMask(replay.Frames[outReport.frames]);
+            }
+            moreInput = (outReport.frames + 1u) < replay.Frames.size();
+        } else if (options.scriptPath != nullptr) {
+            script.Apply(outReport.frames, _console, scriptCursor);
+            moreInput = scriptCursor < script.GetEvents().size();
+        }
+        if (options.recordPath != nullptr) {
+            recording.Frames.push_back(_console.Keyboard.GetKeyMask());
+        }
+
+        if (rewind != nullptr) {
+            const auto recordStart = std::chrono::steady_clock::now();
+            ConsoleState state {};
+            _console.SaveState(state);
+            rewind->Push(state);
+            rewindTime += std::chrono::steady_clock::now() - recordStart;
+        }
+
+        _console.Cycle();
+        outReport.frames += 1u;
+
+        // nobody is going to press a key, so a Fx0A wait would never end
+        if (_console.Cpu.Halted && !moreInput) {
+            if (recorder != nullptr) {
+                recorder->OnFault(_console.Cpu, TraceReason::KeyWait, static_cast<uint16_t>(_console.Cpu.PC - 2u));
+            }
+            outReport.halted = true;
+            break;
+        }
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    _console.Cpu.Profile = nullptr;
+    _console.Cpu.Recorder = nullptr;
+
+    if (recorder != nullptr) {
+        outReport.traceFaults = recorder->FaultCount;
+        outReport.firstFault = recorder->LastFault.Reason;
+
+        if (recorder->FaultCount == 0u) {
+            TraceDump dump {};
+            recorder->Capture(_console.Cpu, TraceReason::OnDemand, 0u, dump);
+            if (!dump.SaveToFile(options.tracePath)) {
+                std::cerr << "[Headless] failed to write trace " << options.tracePath << std::endl;
+                return false;
+            }
+            std::cout << "[Headless] trace of the last " << dump.Entries.size() << " instructions written to " << options.tracePath << std::endl;
+        }
+    }
+
+    if (options.recordPath != nullptr) {
+        if (!recording.SaveToFile(options.recordPath)) {
+            std::cerr << "[Headless] failed to write movie " << options.recordPath << std::endl;
+            return false;
+        }
+        std::cout << "[Headless] recorded " << recording.Frames.size() << " frames to " << options.recordPath << std::endl;
+    }
+
+    if (options.codeCachePath != nullptr) {
+        if (!CodeCache::SaveToFile(_console.Cpu, _cartridge.hash(), options.codeCachePath)) {
+            std::cerr << "[Headless] failed to write code cache " << options.codeCachePath << std::endl;
+            return false;
+        }
+        std::cout << "[Headless] code cache written to " << options.codeCachePath << std::endl;
+    }
+
+    if (options.updateCatalog) {
+        RomEntry& entry = catalog.Get(_cartridge.hash(), _cartridge.size);
+        if (entry.Name.empty()) {
+            const char* name = strrchr(options.filePath, '/');
+            entry.Name = (name != nullptr) ? name + 1 : options.filePath;
+        }
+        // a movie replays at its own rate, which is not a setting of the ROM
+        if (options.playPath == nullptr) {
+            entry.CyclesPerFrame = _console.Settings.CyclesPerFrame;
+        }
+        entry.Quirks = _console.Cpu.GetQuirks();
+        _console.Analyze(entry);
+
+        if (!catalog.SaveToFile(options.catalogPath)) {
+            std::cerr << "[Headless] failed to write catalog " << options.catalogPath << std::endl;
+            return false;
+        }
+        std::cout << "[Headless] catalog entry of " << entry.Name << " written to " << options.catalogPath << std::endl;
+    }
+
+    outReport.instructions = _console.Cpu.InstructionCount - startInstructions;
+    outReport.idleInstructions = _console.Cpu.IdleInstructionCount - startIdleInstructions;
+    outReport.lockstepMismatches = _console.Cpu.LockstepMismatches;
+    outReport.screenHash = _console.Screen.Hash();
+    if (rewind != nullptr) {
+        outReport.rewindFrames = rewind->GetFrameCount();
+        outReport.rewindBytes = rewind->GetUsedBytes();
+        outReport.rewindTimeMs = std::chrono::duration<double, std::milli>(rewindTime).count();
+    }
+    outReport.wallTimeMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+    if (options.profileCsvPath != nullptr) {
+        std::ofstream csv(options.profileCsvPath);
+        if (!csv) {
+            std::cerr << "[Headless] failed to write profile " << options.profileCsvPath << std::endl;
+            return false;
+        }
+        profile->WriteCsv(csv);
+        std::cout << "[Headless] profile written to " << options.profileCsvPath << std::endl;
+    }
+    if (options.profile) {
+        outReport.profile = profile;
+    }
+    return true;
+}
+
+bool HeadlessRunner::RunBatch(const Options& options, Report& outReport) {
+    std::cout << "[Headless] batch: " << options.batchSize << " instances" << std::endl;
+    if (options.overrideQuirks && options.quirks != Quirk::None) {
+        std::cerr << "[Headless] a batch only runs without quirks" << std::endl;
+        return false;
+    }
+    if (options.catalogPath != nullptr) {
+        std::cerr << "[Headless] a batch does not use the catalog" << std::endl;
+        return false;
+    }
+    if (options.codeCachePath != nullptr) {
+        std::cerr << "[Headless] a batch does not use the code cache" << std::endl;
+        return false;
+    }
+
+    ConsoleBatch batch(options.batchSize, options.seed);
+    batch.Settings = options.settings;
+    batch.InsertCartridge(_cartridge);
+    outReport.instances = options.batchSize;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    while (true) {
+        if (options.maxFrames != 0u && outReport.frames >= options.maxFrames) break;
+        if (options.maxInstructions != 0u && batch.InstructionCount >= options.maxInstructions) break;
+
+        batch.Cycle();
+        outReport.frames += 1u;
+
+        // copies of the same ROM wait for a key at about the same time
+        bool allHalted = true;
+        for (uint32_t n = 0u; n < batch.GetSize() && allHalted; n++) {
+            allHalted = batch.IsHalted(n);
+        }
+        if (allHalted) {
+            outReport.halted = true;
+            break;
+        }
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+
+    outReport.instructions = batch.InstructionCount;
+    outReport.vectorInstructions = batch.VectorInstructionCount;
+    outReport.idleInstructions = batch.IdleInstructionCount;
+    outReport.wallTimeMs = std::chrono::duration<double, std::milli>(end - start).count();
+    return true;
+}
+
+void HeadlessRunner::PrintReport(const Report& report) {
+    const double seconds = report.wallTimeMs / 1000.0;
+
+    std::cout << "[Headless] frames: " << report.frames << std::endl;
+    if (report.instances > 1u) {
+        std::cout << "[Headless] instances: " << report.instances << std::endl;
+    }
+    std::cout << "[Headless] instructions: " << report.instructions << std::endl;
+    std::cout << "[Headless] wall time: " << report.wallTimeMs << " ms" << std::endl;
+    if (report.instances == 1u) {
+        char hash[20];
+        snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(report.screenHash));
+        std::cout << "[Headless] screen: " << hash << std::endl;
+    }
+
+    if (seconds > 0.0) {
+        std::cout << "[Headless] instructions/sec: " << (report.instructions / seconds) << std::endl;
+        std::cout << "[Headless] frames/sec: " << (report.frames / seconds) << std::endl;
+    }
+
+    if (report.vectorInstructions > 0u && report.instructions > 0u) {
+        std::cout << "[Headless] simd share: " << (100.0 * report.vectorInstructions / report.instructions) << "%" << std::endl;
+    }
+
+    if (report.idleInstructions > 0u && report.instructions > 0u) {
+        std::cout << "[Headless] idle share: " << (100.0 * report.idleInstructions / report.instructions) << "% skipped in spin loops" << std::endl;
+    }
+
+    if (report.rewindFrames > 0u) {
+        std::cout << "[Headless] rewind: " << report.rewindFrames << " frames in " << (report.rewindBytes / 1024u) << " KiB, "
+                  << (1000.0 * report.rewindTimeMs / report.frames) << " us/frame to record" << std::endl;
+    }
+
+    if (report.lockstepMismatches > 0u) {
+        std::cout << "[Headless] lockstep mismatches: " << report.lockstepMismatches << std::endl;
+    }
+
+    if (report.profile != nullptr) {
+        std::cout << "[Headless] profile:" << std::endl;
+        report.profile->WriteReport(std::cout);
+    }
+
+    if (report.traceFaults > 0u) {
+        std::cout << "[Headless] faults: " << report.traceFaults << " (first: " << TraceDump::GetReasonName(report.firstFault) << ")" << std::endl;
+    }
+
+    if (report.halted) {
+        std::cout << "[Headless] stopped early: waiting for a key press (Fx0A)" << std::endl;
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "chip8/console.h"
+#include "chip8/batch/console_batch.h"
+#include "chip8/constants.h"
+#include "chip8/cpu/flight_recorder.h"
+#include "chip8/cpu/profiler.h"
+#include "chip8/cartridge/cartridge.h"
+#include "chip8/cartridge/rom_catalog.h"
+#include "chip8/state/movie.h"
+#include "chip8/state/rewind_buffer.h"
+#include "input_script.h"
+
+// Runs a Console without window, audio or frame pacing, so the raw speed of
+// the core library can be measured (or used) on machines without a display.
+class HeadlessRunner {
+public:
+    struct Options {
+        char* filePath = nullptr;
+
+        // Stop after this many frames (0 = no limit)
+        uint64_t maxFrames = 0u;
+        // Stop after this many instructions (0 = no limit), rounded up to whole frames
+        uint64_t maxInstructions = 0u;
+
+        CpuSettings settings = {};
+        // settings.CyclesPerFrame wins over the one of the catalog
+        bool overrideCyclesPerFrame = false;
+        // RND seed, fixed so runs can be compared
+        uint32_t seed = 0u;
+
+        CpuEngine engine = CpuEngine::Cached;
+        // compare every Jit block against CPU::Exec
+        bool lockstep = false;
+
+        // Start with the settings and analysis of the ROM's entry in this
+        // RomCatalog; with updateCatalog, write the ones of this run back
+        char* catalogPath = nullptr;
+        bool updateCatalog = false;
+
+        // Run with these quirks instead of the ones of the ROM's profile or catalog entry
+        bool overrideQuirks = false;
+        uint8_t quirks = Quirk::None;
+
+        // Run this many copies of the ROM in a ConsoleBatch (0 = a single Console)
+        uint32_t batchSize = 0u;
+
+        // Record every frame into a RewindBuffer of this size (0 = off)
+        size_t rewindBytes = 0u;
+
+        // Key presses to feed in (see InputScript)
+        char* scriptPath = nullptr;
+        // Write the keys of every frame to a Movie
+        char* recordPath = nullptr;
+        // Replay a Movie instead; runs for its length unless a limit is given
+        char* playPath = nullptr;
+
+        // Count opcodes and addresses (needs a CHIP8_PROFILE build): print
+        // the report, and/or write it as CSV to this file
+        bool profile = false;
+        char* profileCsvPath = nullptr;
+
+        // Start from the CodeCache in this file when it matches the ROM and
+        // engine build, and write the code of this run to it at the end
+        char* codeCachePath = nullptr;
+
+        // Keep a FlightRecorder and write its trace here: on the first fault,
+        // or at the end of the run if there was none
+        char* tracePath = nullptr;
+    };
+
+    struct Report {
+        uint64_t frames = 0u;
+        uint64_t instructions = 0u;
+        double wallTimeMs = 0.0;
+        bool halted = false;
+        uint64_t screenHash = 0u;
+        uint64_t lockstepMismatches = 0u;
+        uint32_t instances = 1u;
+        uint64_t vectorInstructions = 0u;
+        uint64_t idleInstructions = 0u;
+
+        size_t rewindFrames = 0u;
+        size_t rewindBytes = 0u;
+        double rewindTimeMs = 0.0;
+
+        std::shared_ptr<const CpuProfile> profile;
+
+        uint64_t traceFaults = 0u;
+        TraceReason firstFault = TraceReason::OnDemand;
+    };
+
+    bool Run(const Options& options, Report& outReport);
+
+    static void PrintReport(const Report& report);
+
+    static bool ParseEngine(const char* name, CpuEngine& outEngine);
+    static const char* GetEngineName(CpuEngine engine);
+
+private:
+    bool RunBatch(const Options& options, Report& outReport);
+
+    Cartridge _cartridge = {};
+    Console _console = {};
+};
@@ -0,0 +1,118 @@
+#include "work_stealing_pool.h"
+
+#include <cassert>
+
+WorkStealingPool::WorkStealingPool(uint32_t threadCount) {
+    if (threadCount == 0u) {
+        threadCount = 1u;
+    }
+
+    for (uint32_t index = 0u; index < threadCount; index++) {
+        _queues.emplace_back(new Queue());
+    }
+    for (uint32_t index = 0u; index < threadCount; index++) {
+        _threads.emplace_back(&WorkStealingPool::WorkerLoop, this, index);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+
+    for (std::thread& thread : _threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::Submit(Task task) {
+    assert(task && "empty task");
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _unfinished += 1u;
+    }
+
+    Queue& queue = *_queues[_nextQueue];
+    _nextQueue = (_nextQueue + 1u) % static_cast<uint32_t>(_queues.size());
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    {
+        // taking _mutex orders the increment against a worker going to sleep
+        std::lock_guard<std::mutex> lock(_mutex);
+        _available += 1u;
+    }
+    _wake.notify_one();
+}
+
+void WorkStealingPool::Wait() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _finished.wait(lock, [this] { return _unfinished == 0u; });
+}
+
+bool WorkStealingPool::PopLocal(const uint32_t index, Task& outTask) {
+    Queue& queue = *_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+
+    // newest first, its ROM and console are most likely still in cache
+    outTask = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::Steal(const uint32_t thief, Task& outTask) {
+    const uint32_t count = static_cast<uint32_t>(_queues.size());
+    for (uint32_t offset = 1u; offset < count; offset++) {
+        Queue& queue = *_queues[(thief + offset) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+
+        // oldest first, the owner works from the other end
+        outTask = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        _steals += 1u;
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::WorkerLoop(const uint32_t index) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this] { return _stopping || _available.load() > 0u; });
+            if (_available.load() == 0u) {
+                return; // stopping and nothing left to run
+            }
+        }
+
+        Task task;
+        if (!PopLocal(index, task) && !Steal(index, task)) {
+            // another worker got there first
+            continue;
+        }
+        _available -= 1u;
+
+        task(index);
+
+        bool done = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _unfinished -= 1u;
+            done = (_unfinished == 0u);
+        }
+        if (done) {
+            _finished.notify_all();
+        }
+    }
+}
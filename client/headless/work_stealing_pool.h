@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. Tasks are
+// handed out round-robin; a worker runs its own newest task first and,
+// once its deque is empty, steals the oldest task of another worker, so
+// a few long jobs do not leave the other cores idle.
+class WorkStealingPool {
+public:
+    // Receives the index of the worker running it
+    using Task = std::function<void(uint32_t worker)>;
+
+    explicit WorkStealingPool(uint32_t threadCount);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void Submit(Task task);
+
+    // Blocks until every submitted task has finished
+    void Wait();
+
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(_threads.size()); }
+    uint64_t GetStealCount() const { return _steals.load(); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerLoop(uint32_t index);
+    bool PopLocal(uint32_t index, Task& outTask);
+    bool Steal(uint32_t thief, Task& outTask);
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _threads;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _finished;
+    // both guarded by _mutex
+    uint64_t _unfinished = 0u;
+    bool _stopping = false;
+
+    // tasks sitting in a deque, waiting for a worker
+    std::atomic<uint64_t> _available {0u};
+    std::atomic<uint64_t> _steals {0u};
+    uint32_t _nextQueue = 0u;
+};
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include <math.h>
+#include <string.h>
 
 #include "beeper.h"
 
@@ -8,65 +9,127 @@ SDL_AudioDeviceID Beeper::m_audioDevice;
 SDL_AudioSpec Beeper::m_obtainedSpec;
 double Beeper::m_frequency;
 double Beeper::m_volume;
-int Beeper::m_pos;
-void (*Beeper::m_writeData)(uint8_t* ptr, double data);
-int (*Beeper::m_calculateOffset)(int sample, int channel);
+float Beeper::m_wavetable[Beeper::WavetableSize];
+uint32_t Beeper::m_phase;
+uint32_t Beeper::m_phaseStep;
+SoundEventQueue Beeper::m_events;
+std::atomic<uint64_t> Beeper::m_renderedSamples;
+bool Beeper::m_soundOn;
+uint64_t Beeper::m_nextFrameSample;
+uint64_t Beeper::m_frameSamples;
+double Beeper::m_frameTime = 1000.0 / 60.0;
+bool Beeper::m_queuedOn;
+float* Beeper::m_block;
+void (*Beeper::m_fillStream)(uint8_t* stream, const float* block, int samples, int channels);
 
 // ---
-// Calculate the offset in bytes from the start of the audio stream to the
-// memory address at `sample` and `channel`.
+// Convert a block of normalized mono samples (range: -1.0 .. 1.0) to the audio
+// format and write them to every channel. Channels are interleaved.
 //
-// Channels are interleaved.
+// The mono loops are kept trivial so the compiler can vectorize them.
 
-int calculateOffset_s16(int sample, int channel) {
-    return
-            (sample * sizeof(int16_t) * Beeper::m_obtainedSpec.channels) +
-            (channel * sizeof(int16_t));
-}
+void fillStream_s16(uint8_t* stream, const float* block, int samples, int channels) {
+    int16_t* out = (int16_t*)stream;
+    if (channels == 1) {
+        for (int sample = 0; sample < samples; ++sample) {
+            out[sample] = (int16_t)(block[sample] * (float)INT16_MAX);
+        }
+        return;
+    }
 
-int calculateOffset_f32(int sample, int channel) {
-    return
-            (sample * sizeof(float) * Beeper::m_obtainedSpec.channels) +
-            (channel * sizeof(float));
+    for (int sample = 0; sample < samples; ++sample) {
+        const int16_t data = (int16_t)(block[sample] * (float)INT16_MAX);
+        for (int channel = 0; channel < channels; ++channel) {
+            out[sample * channels + channel] = data;
+        }
+    }
 }
 
-// ---
-// Convert a normalized data value (range: 0.0 .. 1.0) to a data value matching
-// the audio format.
+void fillStream_f32(uint8_t* stream, const float* block, int samples, int channels) {
+    float* out = (float*)stream;
+    if (channels == 1) {
+        memcpy(out, block, samples * sizeof(float));
+        return;
+    }
 
-void writeData_s16(uint8_t* ptr, double data) {
-    int16_t* ptrTyped = (int16_t*)ptr;
-    double range = (double)INT16_MAX - (double)INT16_MIN;
-    double dataScaled = data * range / 2.0;
-    *ptrTyped = dataScaled;
+    for (int sample = 0; sample < samples; ++sample) {
+        for (int channel = 0; channel < channels; ++channel) {
+            out[sample * channels + channel] = block[sample];
+        }
+    }
 }
 
-void writeData_f32(uint8_t* ptr, double data) {
-    float* ptrTyped = (float*)ptr;
-    *ptrTyped = data;
+const char* formatName(SDL_AudioFormat format) {
+    switch (format) {
+        case AUDIO_S16: return "AUDIO_S16";
+        case AUDIO_F32: return "AUDIO_F32";
+        default: return "unsupported";
+    }
 }
 
 // ---
-// Generate audio data. This is how the waveform is generated.
+// Generate audio data. This is how the waveform is generated: the top bits of
+// the phase pick the wavetable entry, the volume scales it.
 
-double Beeper::getData() {
-    double sampleRate = (double)(m_obtainedSpec.freq);
+void Beeper::updatePhaseStep() {
+    if (m_obtainedSpec.freq <= 0) {
+        m_phaseStep = 0;
+        return;
+    }
 
-    // Units: samples
-    double period = sampleRate / m_frequency;
+    // Units: periods per sample, scaled to the full range of the phase
+    double step = m_frequency / (double)(m_obtainedSpec.freq) * 4294967296.0;
+    m_phaseStep = (uint32_t)(step + 0.5);
+}
 
-    // Reset m_pos when it reaches the start of a period so it doesn't run off
-    // to infinity (though this won't happen unless you are playing sound for a
-    // very long time)
-    if (m_pos % (int)period == 0) {
-        m_pos = 0;
+void Beeper::updateFrameSamples() {
+    double samples = m_frameTime / 1000.0 * (double)(m_obtainedSpec.freq);
+    m_frameSamples = (uint64_t)(samples * (double)(1u << FrameFractionBits) + 0.5);
+}
+
+void Beeper::renderTone(float* out, int samples) {
+    const float amplitude = (float)m_volume;
+    const uint32_t step = m_phaseStep;
+    uint32_t phase = m_phase;
+
+    for (int sample = 0; sample < samples; ++sample) {
+        out[sample] = m_wavetable[phase >> (32 - WavetableBits)] * amplitude;
+        phase += step;
     }
 
-    double pos = m_pos;
-    double angular_freq = (1.0 / period) * 2.0 * M_PI;
-    double amplitude = m_volume;
+    m_phase = phase;
+}
+
+void Beeper::renderBlock(int samples) {
+    const uint64_t blockStart = m_renderedSamples.load(std::memory_order_relaxed);
+
+    // Split the block where queued events switch the beep; events that are
+    // already due (the emulator ran late) apply at the start.
+    int pos = 0;
+    while (pos < samples) {
+        int end = samples;
+
+        SoundEvent event;
+        if (m_events.Peek(event)) {
+            if (event.Sample <= blockStart + pos) {
+                m_soundOn = event.On;
+                m_events.Pop();
+                continue;
+            }
+            if (event.Sample < blockStart + samples) {
+                end = (int)(event.Sample - blockStart);
+            }
+        }
+
+        if (m_soundOn) {
+            renderTone(m_block + pos, end - pos);
+        } else {
+            memset(m_block + pos, 0, (end - pos) * sizeof(float));
+        }
+        pos = end;
+    }
 
-    return sin(pos * angular_freq) * amplitude;
+    m_renderedSamples.store(blockStart + samples, std::memory_order_release);
 }
 
 void Beeper::audioCallback(
@@ -78,19 +141,9 @@ void Beeper::audioCallback(
     (void)userdata;
     (void)len;
 
-    // Write data to the entire buffer by iterating through all samples and
-    // channels.
-    for (int sample = 0; sample < m_obtainedSpec.samples; ++sample) {
-        double data = getData();
-        m_pos++;
-
-        // Write the same data to all channels
-        for (int channel = 0; channel < m_obtainedSpec.channels; ++channel) {
-            int offset = m_calculateOffset(sample, channel);
-            uint8_t* ptrData = stream + offset;
-            m_writeData(ptrData, data);
-        }
-    }
+    // Render the entire buffer as one block, then convert it in one go.
+    renderBlock(m_obtainedSpec.samples);
+    m_fillStream(stream, m_block, m_obtainedSpec.samples, m_obtainedSpec.channels);
 }
 
 void Beeper::open() {
@@ -147,25 +200,10 @@ void Beeper::open() {
         SDL_Log("Failed to open audio: %s", SDL_GetError());
         // TODO: throw exception
     } else {
-        std::string formatName;
-        switch (m_obtainedSpec.format) {
-            case AUDIO_S16:
-                m_writeData = writeData_s16;
-                m_calculateOffset = calculateOffset_s16;
-                formatName = "AUDIO_S16";
-                break;
-            case AUDIO_F32:
-                m_writeData = writeData_f32;
-                m_calculateOffset = calculateOffset_f32;
-                formatName = "AUDIO_F32";
-                break;
-            default:
-                SDL_Log("Unsupported audio format: %i", m_obtainedSpec.format);
-                // TODO: throw exception
-        }
+        configure(m_obtainedSpec);
 
         std::cout << "[Beeper] frequency: " << m_obtainedSpec.freq << std::endl;
-        std::cout << "[Beeper] format: " << formatName << std::endl;
+        std::cout << "[Beeper] format: " << formatName(m_obtainedSpec.format) << std::endl;
 
         std::cout
                 << "[Beeper] channels: "
@@ -178,18 +216,67 @@ void Beeper::open() {
     }
 }
 
+bool Beeper::configure(const SDL_AudioSpec& spec) {
+    m_obtainedSpec = spec;
+
+    // One period of a sine wave, computed once
+    for (uint32_t i = 0; i < WavetableSize; ++i) {
+        m_wavetable[i] = (float)sin((double)i / WavetableSize * 2.0 * M_PI);
+    }
+    m_phase = 0;
+
+    // Start silent with nothing queued
+    SoundEvent event;
+    while (m_events.Peek(event)) {
+        m_events.Pop();
+    }
+    m_renderedSamples.store(0);
+    m_soundOn = false;
+    m_queuedOn = false;
+    m_nextFrameSample = 0;
+
+    delete[] m_block;
+    m_block = new float[m_obtainedSpec.samples];
+    updatePhaseStep();
+    updateFrameSamples();
+
+    switch (m_obtainedSpec.format) {
+        case AUDIO_S16:
+            m_fillStream = fillStream_s16;
+            return true;
+        case AUDIO_F32:
+            m_fillStream = fillStream_f32;
+            return true;
+        default:
+            SDL_Log("Unsupported audio format: %i", m_obtainedSpec.format);
+            // TODO: throw exception
+            return false;
+    }
+}
+
 void Beeper::close() {
     SDL_CloseAudioDevice(m_audioDevice);
+    m_audioDevice = 0;
+
+    delete[] m_block;
+    m_block = nullptr;
 }
 
 // --
 
+// The audio thread reads these, so change them with the device locked.
+
 void Beeper::setFrequency(double frequency) {
+    SDL_LockAudioDevice(m_audioDevice);
     m_frequency = frequency;
+    updatePhaseStep();
+    SDL_UnlockAudioDevice(m_audioDevice);
 }
 
 void Beeper::setVolume(double volume) {
+    SDL_LockAudioDevice(m_audioDevice);
     m_volume = volume;
+    SDL_UnlockAudioDevice(m_audioDevice);
 }
 
 // ---
@@ -200,4 +287,39 @@ void Beeper::play() {
 
 void Beeper::stop() {
     SDL_PauseAudioDevice(m_audioDevice, 1);
-}
\ No newline at end of file
+}
+
+// ---
+
+void Beeper::setFrameTime(double frameTime) {
+    m_frameTime = frameTime;
+    updateFrameSamples();
+}
+
+void Beeper::queueFrame(bool soundOn) {
+    if (m_block == nullptr) {
+        return;
+    }
+
+    // Units: samples
+    const uint64_t rendered = m_renderedSamples.load(std::memory_order_acquire);
+    const uint64_t latency = m_obtainedSpec.samples;
+    const uint64_t frameSample = m_nextFrameSample >> FrameFractionBits;
+
+    // Re-anchor the frames one buffer ahead of the audio thread when they
+    // fell behind it (startup, a pause, a stall) or drifted too far ahead.
+    if (frameSample < rendered || frameSample > rendered + 4 * latency) {
+        m_nextFrameSample = (rendered + latency) << FrameFractionBits;
+    }
+
+    // Only changes are queued; when the ring is full the change is retried
+    // with the next frame.
+    if (soundOn != m_queuedOn) {
+        const SoundEvent event = {m_nextFrameSample >> FrameFractionBits, soundOn};
+        if (m_events.Push(event)) {
+            m_queuedOn = soundOn;
+        }
+    }
+
+    m_nextFrameSample += m_frameSamples;
+}
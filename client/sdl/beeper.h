@@ -1,7 +1,11 @@
 #pragma once
 
+#include <atomic>
+
 #include "SDL2/SDL.h"
 
+#include "sound_event_queue.h"
+
 // This class is a singleton, which is bad practice. However, this makes the
 // implementation more straightforward.
 class Beeper
@@ -10,12 +14,37 @@ public:
     static void open(); // Open the audio device
     static void close(); // Close the audio device
 
+    // Prepares rendering for a device with the given specifications; `open()`
+    // calls it with the obtained ones. Without a device, `audioCallback` can
+    // then be called directly, e.g. by the benchmarks. Returns false if the
+    // format is not supported.
+    static bool configure(const SDL_AudioSpec& spec);
+
+    // This is function is called repeatedly by SDL2 to send data to the audio
+    // device.
+    static void audioCallback(
+            void* userdata,
+            uint8_t* stream,
+            int len
+    );
+
     static void setFrequency(double frequency); // Units: Hz
     static void setVolume(double volume); // Range: 0.0 .. 1.0
 
+    // Unpause / pause the audio device. The device is meant to keep playing
+    // while open; beeps are switched with `queueFrame()`.
     static void play();
     static void stop();
 
+    // Length of an emulated frame. Units: ms
+    static void setFrameTime(double frameTime);
+
+    // Called once per emulated frame, from the emulator thread only: the beep
+    // is on or off for that frame. Frames are laid out back to back on the
+    // sample clock, one device buffer ahead of the audio thread, so beeps
+    // start and stop at the sample matching their frame.
+    static void queueFrame(bool soundOn);
+
     static SDL_AudioSpec m_obtainedSpec;
 
 private:
@@ -23,26 +52,50 @@ private:
     static double m_frequency; // Units: Hz
     static double m_volume; // Range: 0.0 .. 1.0
 
-    // The current playback position, according to `getData()` and
-    // `audioCallback()`. Units: samples
-    static int m_pos;
+    // One period of the waveform, sampled `WavetableSize` times. The audio
+    // thread looks samples up instead of calling `sin()` for each of them.
+    static constexpr uint32_t WavetableBits = 10;
+    static constexpr uint32_t WavetableSize = 1u << WavetableBits;
+    static float m_wavetable[WavetableSize];
 
-    // Pointer to function for offset calculate. Differs between different
-    // audio formats.
-    static int (*m_calculateOffset)(int sample, int channel);
+    // The playback position within a period as a 0.32 fixed-point fraction,
+    // and how far it moves per sample. The phase wraps around on its own.
+    static uint32_t m_phase;
+    static uint32_t m_phaseStep;
 
-    // Pointer to function for writing data. Differs between different audio
-    // formats.
-    static void (*m_writeData)(uint8_t* ptr, double data);
+    // Sound on/off changes on their way to the audio thread.
+    static SoundEventQueue m_events;
 
-    // Called by `audioCallback` to generate audio data.
-    static double getData();
+    // Audio thread: samples rendered since `configure()` and whether the beep
+    // is currently on.
+    static std::atomic<uint64_t> m_renderedSamples;
+    static bool m_soundOn;
 
-    // This is function is called repeatedly by SDL2 to send data to the audio
-    // device.
-    static void audioCallback(
-            void* userdata,
-            uint8_t* stream,
-            int len
-    );
+    // Emulator thread: sample at which the next queued frame starts, as 48.16
+    // fixed point since a frame rarely lasts a whole number of samples, the
+    // length of a frame, and the state last queued.
+    static constexpr uint32_t FrameFractionBits = 16;
+    static uint64_t m_nextFrameSample;
+    static uint64_t m_frameSamples;
+    static double m_frameTime; // Units: ms
+    static bool m_queuedOn;
+
+    // Block of mono samples rendered by `audioCallback` before it is
+    // converted to the device format.
+    static float* m_block;
+
+    // Pointer to function converting a block of mono samples to the audio
+    // format of the device, written to every channel. Chosen in `configure()`.
+    static void (*m_fillStream)(uint8_t* stream, const float* block, int samples, int channels);
+
+    // Recomputes `m_phaseStep` from `m_frequency` and the device sample rate.
+    static void updatePhaseStep();
+
+    // Recomputes `m_frameSamples` from `m_frameTime` and the device sample rate.
+    static void updateFrameSamples();
+
+    // Renders `samples` mono samples into `m_block`, switching the beep on and
+    // off where queued events say so.
+    static void renderBlock(int samples);
+    static void renderTone(float* out, int samples);
 };
\ No newline at end of file
@@ -1,6 +1,19 @@
 #include "emulator.h"
 
+#include <ctime>
+
+namespace {
+    const uint32_t ColorLit = 0xFF00FF00u;        // ARGB
+    const uint32_t ColorBackground = 0xFF000000u; // ARGB
+}
+
 Emulator::~Emulator() {
+    if (_texture != nullptr) {
+        SDL_DestroyTexture(_texture);
+    }
+    if (_renderer != nullptr) {
+        SDL_DestroyRenderer(_renderer);
+    }
     if (_window != nullptr) {
         SDL_DestroyWindow(_window);
     }
@@ -20,8 +33,66 @@ void Emulator::InitializeWindow() {
     assert(_window);
 
     // create SDL Renderer
-    _renderer = SDL_CreateRenderer(_window, -1, SDL_TEXTUREACCESS_TARGET);
+    uint32_t rendererFlags = SDL_TEXTUREACCESS_TARGET;
+    if (VSync) {
+        rendererFlags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+    _renderer = SDL_CreateRenderer(_window, -1, rendererFlags);
     assert(_renderer);
+
+    CreateScreenTexture();
+    InitializeTiming();
+
+    // the device keeps playing; frames switch the beep on and off
+    Beeper::setFrequency(BeepFrequency);
+    Beeper::setVolume(BeepVolume);
+    Beeper::setFrameTime(_console.Settings.FrameTime);
+    Beeper::open();
+    Beeper::play();
+}
+
+void Emulator::InitializeTiming() {
+    _counterFrequency = SDL_GetPerformanceFrequency();
+    assert(_counterFrequency > 0u);
+
+    const double ticksPerMs = static_cast<double>(_counterFrequency) / 1000.0;
+    _frameTime = static_cast<uint64_t>(_console.Settings.FrameTime * ticksPerMs * (1u << TimeFractionBits) + 0.5);
+    assert(_frameTime > 0u);
+
+    // with vsync, time advances in whole refreshes of the display
+    _refreshTime = 0u;
+    SDL_DisplayMode mode;
+    if (VSync && SDL_GetWindowDisplayMode(_window, &mode) == 0 && mode.refresh_rate > 0) {
+        _refreshTime = (_counterFrequency << TimeFractionBits) / static_cast<uint64_t>(mode.refresh_rate);
+    }
+}
+
+uint64_t Emulator::ElapsedTime(const uint64_t counterTicks) const {
+    const uint64_t elapsed = counterTicks << TimeFractionBits;
+    if (_refreshTime == 0u) return elapsed;
+
+    // resample to the display rate: the refreshes that passed, rounded, so
+    // scheduling noise around a vsync doesn't turn into 0/2 frame jitter
+    return (elapsed + _refreshTime / 2u) / _refreshTime * _refreshTime;
+}
+
+uint32_t Emulator::ToMilliseconds(const uint64_t time) const {
+    // rounded up: waking early would only spin until the frame is due
+    const uint64_t ticksPerMs = (_counterFrequency << TimeFractionBits) / 1000u;
+    return static_cast<uint32_t>((time + ticksPerMs - 1u) / ticksPerMs);
+}
+
+void Emulator::CreateScreenTexture() {
+    _textureScale = (Config::Screen::Padding > 0u) ? Config::Screen::SizeMultiplier : 1u;
+
+    const uint32_t width = CHIP8_SCREEN_WIDTH * _textureScale;
+    const uint32_t height = CHIP8_SCREEN_HEIGHT * _textureScale;
+    _texture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    assert(_texture);
+
+    // later uploads only cover what changed
+    _pixels.assign(width * height, ColorBackground);
+    SDL_UpdateTexture(_texture, nullptr, _pixels.data(), static_cast<int>(width * sizeof(uint32_t)));
 }
 
 void Emulator::Run(char* filePath) {
@@ -30,100 +101,229 @@ void Emulator::Run(char* filePath) {
     LoadCartridgeFromFile(filePath);
 
     _console.InsertCartridge(_cartridge);
+    ApplyCatalogEntry();
+    if (TracePath != nullptr) {
+        _recorder.reset(new FlightRecorder());
+        _recorder->AutoDumpPath = TracePath;
+        _console.Cpu.Recorder = _recorder.get();
+    }
+    StartMovie(static_cast<uint32_t>(time(nullptr)));
 
     InitializeWindow();
 
     // run game loop
     IsRunning = true;
-    uint64_t time = SDL_GetTicks64();
-    uint64_t prevTime = time;
+    uint64_t prevCounter = SDL_GetPerformanceCounter();
     uint64_t accumulatedTime = 0u;
     while (IsRunning) {
+        const uint64_t counter = SDL_GetPerformanceCounter();
 
         // if paused, ignore game loop but keep handling user inputs
         if (IsPaused) {
             accumulatedTime = 0u;
-            ReadInput();
+            prevCounter = counter;
+            Beeper::queueFrame(false);
+            WaitForInput(PausedWaitTime);
             continue;
         }
 
         // calculate the deltaTime
-        time = SDL_GetTicks64();
-        accumulatedTime += (time - prevTime);
+        accumulatedTime += ElapsedTime(counter - prevCounter);
+        prevCounter = counter;
+
+        // after a stall, drop the backlog rather than running it in one burst
+        const uint64_t maxBacklog = _frameTime * MaxCatchUpFrames;
+        if (accumulatedTime > maxBacklog) {
+            accumulatedTime = maxBacklog;
+        }
 
-        while (accumulatedTime >= static_cast<uint64_t>(Config::Cpu::FrameTime)) {
-            accumulatedTime -= static_cast<uint64_t>(Config::Cpu::FrameTime);
-            _console.Cycle();
+        while (accumulatedTime >= _frameTime) {
+            accumulatedTime -= _frameTime;
+            if (_isRewinding) {
+                StepBack();
+                Beeper::queueFrame(false);
+            } else {
+                ApplyFrameInput();
+                RecordFrame();
+                _console.Cycle();
+                Beeper::queueFrame(_console.Cpu.Flags.Sound);
+            }
         }
 
-        // draw (if needed)
-        if (_console.Screen.Dirty) {
+        // draw (if needed); with vsync presenting is what paces the loop
+        if (_refreshTime > 0u || _console.Screen.IsDirty()) {
             Draw();
         }
 
-        // play sound
-        if (_console.Cpu.Flags.Sound) {
-            Beeper::play();
+        if (_refreshTime > 0u) {
+            ReadInput();
         } else {
-            Beeper::stop();
+            // sleep until the next frame is due, waking up early for input
+            WaitForInput(ToMilliseconds(_frameTime - accumulatedTime));
         }
+    }
 
-        // read device inputs
-        ReadInput();
+    Beeper::close();
 
-        // update previous time
-        prevTime = time;
+    SDL_DestroyTexture(_texture);
+    _texture = nullptr;
+    SDL_DestroyRenderer(_renderer);
+    _renderer = nullptr;
+    SDL_DestroyWindow(_window);
+    _window = nullptr;
+
+    if (RecordPath != nullptr) {
+        const bool saved = _movie.SaveToFile(RecordPath);
+        std::cout << (saved ? "Movie saved to: " : "Failed to save movie to: ") << RecordPath
+                  << " (" << _movie.Frames.size() << " frames)" << std::endl;
     }
+}
 
-    SDL_DestroyWindow(_window);
+void Emulator::StartMovie(const uint32_t seed) {
+    _console.Cpu.Rng.Seed(seed);
+
+    Movie replay = {};
+    if (ReplayPath != nullptr && !replay.LoadFromFile(ReplayPath)) {
+        // runs the cartridge as inserted instead of a zeroed console
+        std::cout << "Failed to load movie: " << ReplayPath << std::endl;
+    } else if (ReplayPath != nullptr) {
+        std::cout << "Replaying movie: " << ReplayPath << std::endl;
+
+        _console.LoadState(replay.Start);
+        _console.Settings.CyclesPerFrame = replay.CyclesPerFrame;
+        _movie.Seed = replay.Seed;
+        _movie.Frames = std::move(replay.Frames);
+        _isReplaying = !_movie.Frames.empty();
+        _replayFrame = 0u;
+    }
+
+    if (RecordPath != nullptr) {
+        // a replay being re-recorded keeps its frames and adds the live ones
+        _movie.CyclesPerFrame = _console.Settings.CyclesPerFrame;
+        _console.SaveState(_movie.Start);
+        if (!_isReplaying) {
+            _movie.Seed = seed;
+            _movie.Frames.clear();
+        }
+    }
 }
 
-void Emulator::LoadCartridgeFromFile(char* filePath) {
-    std::cout << "Loading CHIP-8 Cartridge from path: " << filePath << std::endl;
+void Emulator::ApplyFrameInput() {
+    uint16_t keys = _keysHeld | _keysPressed;
+    _keysPressed = 0u;
 
-    // clear struct content
-    _cartridge.clear();
+    if (_isReplaying) {
+        keys = _movie.Frames[_replayFrame++];
+        if (_replayFrame == _movie.Frames.size()) {
+            std::cout << "Movie finished after " << _replayFrame << " frames" << std::endl;
+            _isReplaying = false;
+        }
+    } else if (RecordPath != nullptr) {
+        _movie.Frames.push_back(keys);
+    }
 
-    // load file
-    std::ifstream stream(filePath, std::ios_base::binary);
-    assert(stream.good());
+    _console.Keyboard.SetKeyMask(keys);
+}
+
+void Emulator::RecordFrame() {
+    // the state at the start of the frame, so the first step back shows the previous one
+    ConsoleState state {};
+    _console.SaveState(state);
+    _rewind.Push(state);
+}
 
-    // find file's size
-    stream.seekg (0, std::ios_base::end);
-    _cartridge.size = stream.tellg();
-    assert(_cartridge.size > 0);
+void Emulator::StepBack() {
+    ConsoleState state {};
+    if (!_rewind.Pop(state)) return;
 
-    _cartridge.filePath = filePath;
+    _console.LoadState(state);
 
-    // read file contents into the Cartridge's buffer
-    stream.seekg(0, std::ios_base::beg);
-    _cartridge.buffer = new uint8_t[_cartridge.size];
-    stream.read((char*)_cartridge.buffer, _cartridge.size);
+    // keep the movie in step with the console
+    if (_isReplaying) {
+        if (_replayFrame > 0u) {
+            _replayFrame -= 1u;
+        }
+    } else if (RecordPath != nullptr && !_movie.Frames.empty()) {
+        _movie.Frames.pop_back();
+    }
 }
 
-void Emulator::Draw() const {
-    // clear the Screen
-    SDL_SetRenderDrawColor(_renderer, 0u, 0u, 0u, 0u);
-    SDL_RenderClear(_renderer);
+void Emulator::LoadCartridgeFromFile(char* filePath) {
+    std::cout << "Loading CHIP-8 Cartridge from path: " << filePath << std::endl;
 
-    // draw active pixels as scalable rectangles
-    SDL_SetRenderDrawColor(_renderer, 0u, 255u, 0u, 0u);
-    SDL_Rect tempRect = {};
+    const bool loaded = _cartridge.loadFromFile(filePath);
+    assert(loaded);
+    (void)loaded;
+}
 
-    const uint32_t pixelSize = Config::Screen::SizeMultiplier - (Config::Screen::Padding * 2);
-    tempRect.w = pixelSize;
-    tempRect.h = pixelSize;
+void Emulator::ApplyCatalogEntry() {
+    if (CatalogPath == nullptr) return;
 
+    RomCatalog catalog = {};
+    if (!catalog.LoadFromFile(CatalogPath)) {
+        std::cout << "Cannot read the ROM catalog " << CatalogPath << std::endl;
+        return;
+    }
+
+    const RomEntry* entry = catalog.Find(_cartridge.hash(), _cartridge.size);
+    if (entry == nullptr) {
+        std::cout << "No entry for this ROM in " << CatalogPath << std::endl;
+        return;
+    }
+
+    std::cout << "Using the catalog entry " << entry->Name << std::endl;
+    _console.Apply(*entry);
+    for (int i = 0; i < CHIP8_KEYS_SIZE; i++) {
+        _keysRemap[i] = entry->KeyMap[i] & 0xFu;
+    }
+}
+
+void Emulator::DrawRow(const uint32_t y) {
+    const uint32_t scale = _textureScale;
+    const uint32_t padding = (scale > 1u) ? Config::Screen::Padding : 0u;
+    const uint32_t pitch = CHIP8_SCREEN_WIDTH * scale;
+    uint32_t* cellTop = &_pixels[y * scale * pitch];
+
+    // build the lit scanline of the row once, at the first line inside the padding
+    uint32_t* line = cellTop + padding * pitch;
+    const uint64_t row = _console.Screen.Rows[y];
     for (uint32_t x = 0; x < CHIP8_SCREEN_WIDTH; x++) {
-        for (uint32_t y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
-            if (_console.Screen.IsSet(x, y)) {
-                tempRect.x = (x * Config::Screen::SizeMultiplier) + Config::Screen::Padding;
-                tempRect.y = (y * Config::Screen::SizeMultiplier) + Config::Screen::Padding;
+        const uint32_t color = ((row >> (CHIP8_SCREEN_WIDTH - 1u - x)) & 1u) ? ColorLit : ColorBackground;
+        uint32_t* cell = line + x * scale;
+        for (uint32_t i = 0; i < scale; i++) {
+            cell[i] = (i < padding || i >= scale - padding) ? ColorBackground : color;
+        }
+    }
 
-                SDL_RenderFillRect(_renderer, &tempRect);
-            }
+    // the other lines inside the padding repeat it, the padding lines stay background
+    for (uint32_t i = padding + 1u; i < scale - padding; i++) {
+        memcpy(cellTop + i * pitch, line, pitch * sizeof(uint32_t));
+    }
+}
+
+void Emulator::Draw() {
+    Screen& screen = _console.Screen;
+    const uint32_t scale = _textureScale;
+    const uint32_t pitch = CHIP8_SCREEN_WIDTH * scale;
+
+    // only the damaged part of the texture is converted and uploaded
+    DamageRect damage[4];
+    const uint32_t count = screen.GetDamage(damage, 4u);
+    for (uint32_t i = 0; i < count; i++) {
+        const DamageRect& rect = damage[i];
+        for (uint32_t y = rect.Y; y < rect.Y + rect.Height; y++) {
+            DrawRow(y);
         }
+
+        const SDL_Rect region = {
+                static_cast<int>(rect.X * scale), static_cast<int>(rect.Y * scale),
+                static_cast<int>(rect.Width * scale), static_cast<int>(rect.Height * scale)
+        };
+        SDL_UpdateTexture(_texture, &region, &_pixels[region.y * pitch + region.x], static_cast<int>(pitch * sizeof(uint32_t)));
     }
+    screen.ClearDirty();
+
+    SDL_RenderCopy(_renderer, _texture, nullptr, nullptr);
     SDL_RenderPresent(_renderer);
 }
 
@@ -132,7 +332,7 @@ bool Emulator::FindCorrespondingVirtualKey(const SDL_Keycode keycode, uint8_t& v
     {
         if (_keysMap[i] == keycode)
         {
-            vKey = i;
+            vKey = _keysRemap[i];
             return true;
         }
     }
@@ -140,36 +340,67 @@ bool Emulator::FindCorrespondingVirtualKey(const SDL_Keycode keycode, uint8_t& v
     return false;
 }
 
+void Emulator::WaitForInput(const uint32_t timeoutMs) {
+    SDL_Event event;
+    if (SDL_WaitEventTimeout(&event, static_cast<int>(timeoutMs))) {
+        HandleEvent(event);
+    }
+
+    // whatever else arrived meanwhile
+    ReadInput();
+}
+
 void Emulator::ReadInput() {
     // handle input events
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
-        switch (event.type) {
-            case SDL_QUIT:
-                exit(0);
-                break;
-
-            case SDL_KEYDOWN: {
-                const SDL_Keycode keycode = event.key.keysym.sym;
-                uint8_t vKey;
-                if (FindCorrespondingVirtualKey(keycode, vKey)) {
-                    _console.Keyboard.SetKeyDown(vKey);
-                }
+        HandleEvent(event);
+    }
+}
+
+void Emulator::HandleEvent(const SDL_Event& event) {
+    switch (event.type) {
+        case SDL_QUIT:
+            IsRunning = false;
+            break;
+
+        case SDL_KEYDOWN: {
+            const SDL_Keycode keycode = event.key.keysym.sym;
+            uint8_t vKey;
+            if (keycode == _rewindKey) {
+                _isRewinding = true;
+            } else if (keycode == _traceKey) {
+                DumpTrace();
+            } else if (FindCorrespondingVirtualKey(keycode, vKey)) {
+                _keysHeld |= static_cast<uint16_t>(1u << vKey);
+                _keysPressed |= static_cast<uint16_t>(1u << vKey);
             }
-                break;
-
-            case SDL_KEYUP: {
-                const SDL_Keycode keycode = event.key.keysym.sym;
-                uint8_t vKey;
-                if (FindCorrespondingVirtualKey(keycode, vKey)) {
-                    _console.Keyboard.SetKeyUp(vKey);
-                }
+        }
+            break;
+
+        case SDL_KEYUP: {
+            const SDL_Keycode keycode = event.key.keysym.sym;
+            uint8_t vKey;
+            if (keycode == _rewindKey) {
+                _isRewinding = false;
+            } else if (FindCorrespondingVirtualKey(keycode, vKey)) {
+                _keysHeld &= static_cast<uint16_t>(~(1u << vKey));
             }
-                break;
         }
+            break;
     }
 }
 
+void Emulator::DumpTrace() {
+    if (_recorder == nullptr) return;
+
+    TraceDump dump {};
+    _recorder->Capture(_console.Cpu, TraceReason::OnDemand, 0u, dump);
+    const bool saved = dump.SaveToFile(TracePath);
+    std::cout << (saved ? "Trace saved to: " : "Failed to save trace to: ") << TracePath
+              << " (" << dump.Entries.size() << " instructions)" << std::endl;
+}
+
 void Emulator::Pause() {
     assert(IsRunning);
     IsPaused = true;
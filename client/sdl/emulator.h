@@ -4,33 +4,103 @@
 #include <cassert>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <vector>
 
 #include "SDL2/SDL.h"
 
 #include "chip8/console.h"
 #include "chip8/constants.h"
 #include "chip8/cartridge/cartridge.h"
+#include "chip8/cartridge/rom_catalog.h"
+#include "chip8/cpu/flight_recorder.h"
+#include "chip8/state/movie.h"
+#include "chip8/state/rewind_buffer.h"
 #include "beeper.h"
 
 class Emulator {
     Cartridge _cartridge = {};
     Console _console = {};
 
+    // Holding the rewind key steps back one recorded frame per frame
+    RewindBuffer _rewind {};
+    bool _isRewinding = false;
+
+    // Input reaches the console once per frame, as a key mask, so a Movie
+    // can reproduce it: keys held now plus keys tapped since the last frame
+    uint16_t _keysHeld = 0u;
+    uint16_t _keysPressed = 0u;
+
+    // Only with a TracePath; faults dump to it, F12 dumps on demand
+    std::unique_ptr<FlightRecorder> _recorder;
+
+    Movie _movie {};
+    bool _isReplaying = false;
+    size_t _replayFrame = 0u;
+
     SDL_Window* _window = nullptr;
     SDL_Renderer* _renderer = nullptr;
 
+    // The screen as ARGB, uploaded in one go and stretched by the renderer.
+    // Without padding it is 64x32; with padding every CHIP-8 pixel becomes a
+    // cell of SizeMultiplier texels so the grid is part of the texture.
+    SDL_Texture* _texture = nullptr;
+    std::vector<uint32_t> _pixels;
+    uint32_t _textureScale = 1u;
+
     const uint8_t _keysMap[CHIP8_KEYS_SIZE] = {
             SDLK_1, SDLK_2, SDLK_3, SDLK_4,
             SDLK_q, SDLK_w, SDLK_e, SDLK_r,
             SDLK_a, SDLK_s, SDLK_d, SDLK_f,
             SDLK_z, SDLK_x, SDLK_c, SDLK_v
     };
+    // CHIP-8 key pressed by each key of _keysMap, from the catalog entry
+    uint8_t _keysRemap[CHIP8_KEYS_SIZE] = {0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xA, 0xB, 0xC, 0xD, 0xE, 0xF};
+    const SDL_Keycode _rewindKey = SDLK_BACKSPACE;
+    const SDL_Keycode _traceKey = SDLK_F12;
+
+    // Frame pacing runs on the performance counter. Times are counter ticks
+    // with TimeFractionBits of fraction, so a frame of 16.67 ms is kept
+    // exactly instead of being rounded to whole ticks or milliseconds.
+    static constexpr uint32_t TimeFractionBits = 16u;
+    uint64_t _counterFrequency = 0u;
+    uint64_t _frameTime = 0u;
+    // One display refresh, only set when presenting with vsync
+    uint64_t _refreshTime = 0u;
+
+    static constexpr double BeepFrequency = 440.0; // Hz
+    static constexpr double BeepVolume = 0.25;
+
+    // Nothing is due while paused; wake up now and then regardless (ms)
+    static constexpr uint32_t PausedWaitTime = 250u;
+    // Frames run back to back at most after a stall; the rest is skipped
+    static constexpr uint32_t MaxCatchUpFrames = 4u;
 
     void LoadCartridgeFromFile(char* filePath);
+    void ApplyCatalogEntry();
     bool FindCorrespondingVirtualKey(SDL_Keycode keycode, uint8_t& vKey) const;
 
-    void Draw() const;
+    void InitializeTiming();
+    uint64_t ElapsedTime(uint64_t counterTicks) const;
+    uint32_t ToMilliseconds(uint64_t time) const;
+
+    void CreateScreenTexture();
+    void DrawRow(uint32_t y);
+    void Draw();
+
+    // Sleeps until an event arrives or the timeout runs out, then handles
+    // every pending event
+    void WaitForInput(uint32_t timeoutMs);
     void ReadInput();
+    void HandleEvent(const SDL_Event& event);
+
+    void RecordFrame();
+    void StepBack();
+
+    void DumpTrace();
+
+    void StartMovie(uint32_t seed);
+    void ApplyFrameInput();
 
 public:
     ~Emulator();
@@ -43,4 +113,16 @@ public:
 
     bool IsRunning = false;
     bool IsPaused = false;
+
+    // Present with vsync and run emulation time in whole display refreshes
+    bool VSync = false;
+
+    // Write the input of the session to this movie file on exit
+    char* RecordPath = nullptr;
+    // Play this movie file back, then hand control to the keyboard
+    char* ReplayPath = nullptr;
+    // Record the last instructions into a FlightRecorder dumped to this file
+    char* TracePath = nullptr;
+    // Start with the settings and key mapping of the ROM's entry in this RomCatalog
+    char* CatalogPath = nullptr;
 };
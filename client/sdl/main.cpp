@@ -1,5 +1,6 @@
 #include <cstdio>
 #include <cassert>
+#include <cstring>
 
 #include "emulator.h"
 
@@ -9,6 +10,20 @@ int main (int argc, char* argv[]) {
     char* filePath = argv[1];
 
     Emulator emulator = {};
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--vsync") == 0) {
+            emulator.VSync = true;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            emulator.RecordPath = argv[++i];
+        } else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+            emulator.ReplayPath = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            emulator.TracePath = argv[++i];
+        } else if (strcmp(argv[i], "--catalog") == 0 && i + 1 < argc) {
+            emulator.CatalogPath = argv[++i];
+        }
+    }
+
     emulator.Run(filePath);
 
     return 0;
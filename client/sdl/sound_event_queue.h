@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Beep switched on or off, from the given sample of the audio stream on
+struct SoundEvent {
+    uint64_t Sample;
+    bool On;
+};
+
+// Fixed-size ring handing SoundEvents from the emulator thread (the only
+// producer) to the audio callback (the only consumer) without locks: each
+// side owns one index and only reads the other's.
+class SoundEventQueue {
+public:
+    // Producer side; false when the ring is full
+    bool Push(const SoundEvent& event) {
+        const uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == Capacity) return false;
+
+        _events[tail & (Capacity - 1u)] = event;
+        _tail.store(tail + 1u, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; false when the ring is empty
+    bool Peek(SoundEvent& outEvent) const {
+        const uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) return false;
+
+        outEvent = _events[head & (Capacity - 1u)];
+        return true;
+    }
+
+    // Consumer side; drops the event Peek returned
+    void Pop() {
+        _head.store(_head.load(std::memory_order_relaxed) + 1u, std::memory_order_release);
+    }
+
+private:
+    static constexpr uint32_t Capacity = 256u;
+    static_assert((Capacity & (Capacity - 1u)) == 0u, "Capacity must be a power of two");
+
+    SoundEvent _events[Capacity];
+    // free-running, the slot is the index modulo Capacity
+    std::atomic<uint32_t> _head {0u};
+    std::atomic<uint32_t> _tail {0u};
+};
@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "chip8/cpu/flight_recorder.h"
+#include "chip8/cpu/opcode.h"
+
+// Prints a FlightRecorder trace: why it was taken, the registers and stack at
+// that moment, and the recorded instructions, oldest first.
+
+static void PrintUsage(const char* program) {
+    std::cout << "usage: " << program << " <trace> [options]" << std::endl
+              << "  --last <n>   only print the last n instructions" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    size_t last = 0u;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--last") == 0 && (i + 1) < argc) {
+            last = static_cast<size_t>(strtoull(argv[++i], nullptr, 10));
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    TraceDump dump {};
+    if (!dump.LoadFromFile(argv[1])) {
+        std::cerr << "[Trace] not a trace of this version: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    char line[160];
+    snprintf(line, sizeof(line), "reason: %s at 0x%03X, after %llu recorded instructions", TraceDump::GetReasonName(dump.Reason),
+             dump.FaultAddress, static_cast<unsigned long long>(dump.RecordedCount));
+    std::cout << line << std::endl;
+
+    snprintf(line, sizeof(line), "PC 0x%03X  I 0x%03X  SP %u  DT %u  ST %u", dump.PC, dump.I, dump.SP, dump.Delay, dump.Sound);
+    std::cout << line << std::endl;
+    for (uint32_t row = 0u; row < 2u; row++) {
+        std::cout << " ";
+        for (uint32_t i = row * 8u; i < row * 8u + 8u; i++) {
+            snprintf(line, sizeof(line), " V%X %02X", i, dump.V[i]);
+            std::cout << line;
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "stack:";
+    for (uint32_t i = 0u; i < dump.SP && i < CHIP8_MEMORY_STACK_SIZE; i++) {
+        snprintf(line, sizeof(line), " 0x%03X", dump.Stack[i]);
+        std::cout << line;
+    }
+    std::cout << std::endl;
+
+    const size_t count = dump.Entries.size();
+    const size_t first = (last > 0u && last < count) ? count - last : 0u;
+    const uint64_t firstInstruction = dump.RecordedCount - count;
+
+    std::cout << "instructions (" << (count - first) << " of " << count << "):" << std::endl;
+    char text[32];
+    for (size_t i = first; i < count; i++) {
+        const TraceEntry& entry = dump.Entries[i];
+        Opcode::Disassemble(entry.Opcode, text, sizeof(text));
+        snprintf(line, sizeof(line), "  %10llu  0x%03X  %04X  %-16s I 0x%03X  SP %2u  DT %3u  regs %08X",
+                 static_cast<unsigned long long>(firstInstruction + i), entry.PC, entry.Opcode, text,
+                 entry.I, entry.SP, entry.Delay, entry.Digest);
+        std::cout << line << std::endl;
+    }
+
+    return 0;
+}
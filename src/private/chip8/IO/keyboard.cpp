@@ -14,8 +14,8 @@ void Keyboard::SetKeyDown(int vKey)
     AssertKeyInBounds(vKey);
     _keyboard[vKey] = true;
 
-    if (OnKeyDownEvent != nullptr) {
-        OnKeyDownEvent(vKey);
+    if (_latchedKey < 0) {
+        _latchedKey = static_cast<int8_t>(vKey);
     }
 }
 
@@ -30,3 +30,38 @@ bool Keyboard::IsKeyDown(int vKey) const
     AssertKeyInBounds(vKey);
     return _keyboard[vKey];
 }
+
+uint16_t Keyboard::GetKeyMask() const
+{
+    uint16_t mask = 0u;
+    for (int i = 0; i < CHIP8_KEYS_SIZE; i++) {
+        if (_keyboard[i]) {
+            mask |= static_cast<uint16_t>(1u << i);
+        }
+    }
+    return mask;
+}
+
+void Keyboard::SetKeyMask(const uint16_t mask)
+{
+    for (int i = 0; i < CHIP8_KEYS_SIZE; i++) {
+        const bool down = (mask >> i) & 1u;
+        if (down == _keyboard[i]) continue;
+
+        if (down) {
+            SetKeyDown(i);
+        } else {
+            SetKeyUp(i);
+        }
+    }
+}
+
+int Keyboard::GetLatchedKey() const
+{
+    return _latchedKey;
+}
+
+void Keyboard::ClearLatch()
+{
+    _latchedKey = -1;
+}
@@ -1,55 +1,175 @@
 #include "chip8/IO/screen.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
 #include "chip8/constants.h"
 
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+static_assert(CHIP8_SCREEN_WIDTH == 64, "Screen rows are packed into a single uint64_t");
+
 static void AssertPixelInScreenBounds(const uint32_t x, const uint32_t y)
 {
     assert(x >= 0u && x < CHIP8_SCREEN_WIDTH
         && y >= 0u && y < CHIP8_SCREEN_HEIGHT);
 }
 
+static inline uint64_t PixelMask(const uint32_t x)
+{
+    return 0x8000'0000'0000'0000ull >> x;
+}
+
+static inline uint32_t LeadingZeros(const uint64_t value)
+{
+    // value must not be 0
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return 63u - index;
+#else
+    return static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+static inline uint32_t TrailingZeros(const uint64_t value)
+{
+    // value must not be 0
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+static inline uint64_t RotateRight(const uint64_t value, const uint32_t shift)
+{
+    // compilers turn this into a single rotate instruction
+    return (value >> shift) | (value << ((64u - shift) & 63u));
+}
+
 void Screen::Set(uint32_t x, uint32_t y)
 {
     AssertPixelInScreenBounds(x, y);
-    if (!Pixels[y][x]) {
-        Pixels[y][x] = true;
-        Dirty = true;
+    const uint64_t mask = PixelMask(x);
+    if ((Rows[y] & mask) == 0u) {
+        Rows[y] |= mask;
+        DirtyRows |= 1u << y;
+        DirtyPixels[y] |= mask;
     }
 }
 
 bool Screen::IsSet(uint32_t x, uint32_t y) const
 {
     AssertPixelInScreenBounds(x, y);
-    return Pixels[y][x];
+    return (Rows[y] & PixelMask(x)) != 0u;
 }
 
+template <bool Clip>
 bool Screen::DrawSprite(const uint32_t x, const uint32_t y, const uint8_t* sprite, const int numBytes)
 {
-    bool pixelCollision = false;
-    for (int ly = 0; ly < numBytes; ly++) {
-        const uint8_t c = sprite[ly];
-        for (int lx = 0; lx < 8; lx++) {
-            const bool isBitSet = (c & (0b1000'0000 >> lx)) != 0;
-            if (!isBitSet)
-            {
-                continue;
-            }
+    // the sprite row is placed at the left edge and rotated into place, so
+    // pixels going past the right edge wrap around to the left one; clipped
+    // sprites are shifted instead, which drops them
+    const uint32_t shift = x % CHIP8_SCREEN_WIDTH;
+    const uint32_t top = y % CHIP8_SCREEN_HEIGHT;
+    const int rows = Clip ? std::min(numBytes, static_cast<int>(CHIP8_SCREEN_HEIGHT - top)) : numBytes;
+
+    uint64_t collision = 0u;
+    for (int ly = 0; ly < rows; ly++) {
+        const uint64_t placed = static_cast<uint64_t>(sprite[ly]) << 56u;
+        const uint64_t spriteRow = Clip ? (placed >> shift) : RotateRight(placed, shift);
+        if (spriteRow == 0u)
+        {
+            continue;
+        }
+
+        const uint32_t rowIndex = (ly + top) % CHIP8_SCREEN_HEIGHT;
+        DirtyRows |= 1u << rowIndex;
+        DirtyPixels[rowIndex] |= spriteRow;
+
+        uint64_t& row = Rows[rowIndex];
+        collision |= row & spriteRow;
+        row ^= spriteRow;
+    }
+    return collision != 0u;
+}
 
-            Dirty = true;
+template bool Screen::DrawSprite<false>(uint32_t x, uint32_t y, const uint8_t* sprite, int numBytes);
+template bool Screen::DrawSprite<true>(uint32_t x, uint32_t y, const uint8_t* sprite, int numBytes);
 
-            bool& pixel = Pixels[(ly + y) % CHIP8_SCREEN_HEIGHT][(lx + x) % CHIP8_SCREEN_WIDTH];
-            pixelCollision |= pixel;
-            pixel ^= true;
+uint64_t Screen::Hash() const
+{
+    uint64_t hash = 0xCBF2'9CE4'8422'2325ull;
+    for (const uint64_t row : Rows) {
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            hash ^= (row >> shift) & 0xFFu;
+            hash *= 0x0000'0100'0000'01B3ull;
         }
     }
-    return pixelCollision;
+    return hash;
 }
 
 void Screen::Clear()
 {
-    memset(&Pixels, 0, sizeof(Pixels));
-    Dirty = true;
+    // only the lit pixels change
+    for (uint32_t y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+        if (Rows[y] != 0u) {
+            DirtyRows |= 1u << y;
+            DirtyPixels[y] |= Rows[y];
+        }
+    }
+    memset(&Rows, 0, sizeof(Rows));
+}
+
+void Screen::ClearDirty()
+{
+    DirtyRows = 0u;
+    memset(&DirtyPixels, 0, sizeof(DirtyPixels));
+}
+
+void Screen::MarkAllDirty()
+{
+    DirtyRows = ~0u;
+    memset(&DirtyPixels, 0xFF, sizeof(DirtyPixels));
+}
+
+uint32_t Screen::GetDamage(DamageRect* outRects, const uint32_t maxRects) const
+{
+    static_assert(CHIP8_SCREEN_HEIGHT == 32, "DirtyRows holds one bit per row");
+    if (maxRects == 0u) return 0u;
+
+    uint32_t count = 0u;
+    uint32_t y = 0u;
+    while (y < CHIP8_SCREEN_HEIGHT) {
+        if (((DirtyRows >> y) & 1u) == 0u) {
+            y += 1u;
+            continue;
+        }
+
+        // a run of dirty rows, or everything left once the array is full
+        const uint32_t top = y;
+        uint64_t columns = 0u;
+        uint32_t bottom = y;
+        for (; y < CHIP8_SCREEN_HEIGHT; y++) {
+            if ((DirtyRows >> y) & 1u) {
+                columns |= DirtyPixels[y];
+                bottom = y;
+            } else if (count + 1u < maxRects) {
+                break;
+            }
+        }
+
+        DamageRect& rect = outRects[count++];
+        rect.X = LeadingZeros(columns);
+        rect.Width = CHIP8_SCREEN_WIDTH - TrailingZeros(columns) - rect.X;
+        rect.Y = top;
+        rect.Height = bottom + 1u - top;
+    }
+    return count;
 }
@@ -0,0 +1,704 @@
+#include "chip8/batch/console_batch.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "chip8/console.h"
+#include "chip8/batch/lanes.h"
+
+namespace {
+    constexpr uint16_t AddressMask = CHIP8_MEMORY_SIZE - 1u;
+    constexpr uint32_t PageShift = 8u;
+    constexpr uint16_t AllPages = 0xFFFF;
+
+    static_assert((CHIP8_MEMORY_SIZE >> PageShift) == 16u, "One page bit per 256 bytes of memory");
+
+    uint16_t PageBit(const uint16_t address) {
+        return static_cast<uint16_t>(1u << ((address & AddressMask) >> PageShift));
+    }
+
+    void AssertKeyInBounds(const int vKey) {
+        assert(vKey >= 0 && vKey < CHIP8_KEYS_SIZE);
+        (void)vKey;
+    }
+
+    bool IsVectorOpcode(const uint16_t code) {
+        switch (code & 0xF000) {
+            case 0x1000:
+            case 0x3000:
+            case 0x4000:
+            case 0x5000:
+            case 0x6000:
+            case 0x7000:
+            case 0x9000:
+            case 0xA000:
+                return true;
+            case 0xE000:
+                return (code & 0x00FF) == 0x9E || (code & 0x00FF) == 0xA1;
+            case 0x8000:
+                return (code & 0x000F) <= 0x7 || (code & 0x000F) == 0xE;
+            case 0xF000:
+                switch (code & 0x00FF) {
+                    case 0x07:
+                    case 0x15:
+                    case 0x18:
+                    case 0x1E:
+                        return true;
+                    default:
+                        return false;
+                }
+            default:
+                return false;
+        }
+    }
+
+    void StoreMasked(uint8_t* p, const Lanes::Bytes mask, const Lanes::Bytes value) {
+        Lanes::Store(p, Lanes::Select(mask, value, Lanes::Load(p)));
+    }
+
+    // Calls kernel(n, mask) for every chunk of lanes that has at least one
+    // pending instance about to run `code`; the kernel returns how far each
+    // lane's PC moves (2, or 4 for a taken skip). Handled lanes stop being
+    // pending.
+    template <typename Kernel>
+    void Sweep(const uint16_t* opcodes, uint8_t* pending, uint16_t* pc,
+               const uint32_t stride, const uint16_t code, const Kernel kernel) {
+        for (uint32_t n = 0u; n < stride; n += Lanes::Width) {
+            const Lanes::Bytes mask = Lanes::Match(opcodes + n, code, pending + n);
+            if (!Lanes::Any(mask)) continue;
+
+            const Lanes::Bytes step = kernel(n, mask);
+            Lanes::AddWords(pc + n, Lanes::And(mask, step));
+            StoreMasked(pending + n, mask, Lanes::Set(0u));
+        }
+    }
+}
+
+ConsoleBatch::ConsoleBatch(const uint32_t size, const uint32_t seed) : _size(size) {
+    assert(size > 0u);
+    _stride = (size + MaxLaneWidth - 1u) / MaxLaneWidth * MaxLaneWidth;
+
+    _v.assign(CHIP8_DATA_REGISTERS_SIZE * _stride, 0u);
+    _i.assign(_stride, 0u);
+    _pc.assign(_stride, 0u);
+    _delay.assign(_stride, 0u);
+    _sound.assign(_stride, 0u);
+    _sp.assign(_stride, 0u);
+    _stack.assign(CHIP8_MEMORY_STACK_SIZE * _stride, 0u);
+    _keys.assign(CHIP8_KEYS_SIZE * _stride, 0u);
+    _random.assign(_stride, Random {});
+    _halted.assign(_stride, 0u);
+    _keyWaitRegister.assign(_stride, 0u);
+    _soundOn.assign(_stride, 0u);
+    _memory.assign(static_cast<size_t>(size) * MemoryStride, 0u);
+    _screens.assign(size, Screen {});
+
+    _opcode.assign(_stride, 0u);
+    _running.assign(_stride, 0u);
+    _pending.assign(_stride, 0u);
+    _frameCycles.assign(_stride, 0u);
+    _idleBackoff.assign(_stride, IdleLoop::Backoff {});
+    _groupCount.assign(0x10000, 0u);
+    _groups.reserve(0x100);
+
+    // every page is private until a cartridge is shared by all instances
+    _privatePages.assign(_stride, AllPages);
+
+    for (uint32_t n = 0u; n < size; n++) {
+        memcpy(InstanceMemory(n) + CHIP8_MEMORY_ADDRESS_CHARACTER_SET, Console::DefaultCharacterSet,
+               sizeof(Console::DefaultCharacterSet));
+        _random[n].Seed(seed + n);
+    }
+}
+
+void ConsoleBatch::InsertCartridge(const Cartridge& cartridge) {
+    assert((cartridge.size + CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD) < CHIP8_MEMORY_SIZE);
+    memcpy(_image + CHIP8_MEMORY_ADDRESS_CHARACTER_SET, Console::DefaultCharacterSet, sizeof(Console::DefaultCharacterSet));
+    memcpy(_image + CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD, cartridge.buffer, cartridge.size);
+    for (uint32_t address = 0u; address < CHIP8_MEMORY_SIZE; address++) {
+        _imageOpcodes[address] = (_image[address] << 8) | _image[(address + 1u) & AddressMask];
+    }
+
+    for (uint32_t n = 0u; n < _size; n++) {
+        memcpy(InstanceMemory(n), _image, CHIP8_MEMORY_SIZE);
+        _privatePages[n] = 0u;
+        _pc[n] = CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD;
+    }
+}
+
+void ConsoleBatch::InsertCartridge(const uint32_t index, const Cartridge& cartridge) {
+    assert(index < _size);
+    assert((cartridge.size + CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD) < CHIP8_MEMORY_SIZE);
+    memcpy(InstanceMemory(index) + CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD, cartridge.buffer, cartridge.size);
+    _privatePages[index] = AllPages;
+    _pc[index] = CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD;
+}
+
+void ConsoleBatch::Cycle() {
+    for (uint32_t n = 0u; n < _size; n++) {
+        _running[n] = _halted[n] ? 0x00 : 0xFF;
+        if (!_running[n]) continue;
+
+        _soundOn[n] = false;
+        _frameCycles[n] = Settings.CyclesPerFrame;
+        if (Settings.SkipIdleLoops) {
+            _frameCycles[n] -= SkipIdleLoop(n);
+        }
+    }
+
+    for (uint32_t cycle = 0u; cycle < Settings.CyclesPerFrame; cycle++) {
+        if (Fetch(cycle) == 0u) break;
+        RunGroups();
+    }
+
+    // instances that halted during the frame skip the timer update, like
+    // Console::Cycle; the ones that ran out of cycles early still tick
+    for (uint32_t n = 0u; n < _size; n++) {
+        if (_halted[n]) continue;
+
+        if (_delay[n] > 0u) {
+            _delay[n] -= 1u;
+        }
+        if (_sound[n] > 0u) {
+            _sound[n] -= 1u;
+        }
+        _soundOn[n] = (_sound[n] > 0u);
+    }
+}
+
+uint32_t ConsoleBatch::SkipIdleLoop(const uint32_t n) {
+    if (!_idleBackoff[n].ShouldCheck()) return 0u;
+
+    const uint8_t* memory = InstanceMemory(n);
+    IdleLoop loop;
+    if (!IdleLoop::Find(memory, _pc[n], loop)) {
+        _idleBackoff[n].Miss();
+        return 0u;
+    }
+
+    uint32_t skipped = 0u;
+    const uint32_t executed = loop.Run(_pc[n], Settings.CyclesPerFrame,
+        [this, n, memory]() {
+            const uint16_t pc = _pc[n];
+            _pc[n] += 2u;
+            ExecScalar(n, (memory[pc & AddressMask] << 8) | memory[(pc + 1u) & AddressMask]);
+            return _pc[n];
+        },
+        [this, n](IdleLoop::State& outState) {
+            for (uint8_t x = 0u; x < CHIP8_DATA_REGISTERS_SIZE; x++) {
+                outState.V[x] = V(x)[n];
+            }
+            outState.I = _i[n];
+        },
+        skipped);
+
+    InstructionCount += executed + skipped;
+    IdleInstructionCount += skipped;
+    if (skipped > 0u) {
+        _idleBackoff[n].Hit();
+    } else {
+        _idleBackoff[n].Miss();
+    }
+    return executed + skipped;
+}
+
+uint32_t ConsoleBatch::Fetch(const uint32_t cycle) {
+    uint32_t active = 0u;
+
+    // neighbouring instances usually sit on the same opcode, so counts are
+    // accumulated per run instead of bumping the table entry for every lane
+    uint16_t runCode = 0u;
+    uint32_t runLength = 0u;
+    const auto FlushRun = [this, &runCode, &runLength]() {
+        if (runLength == 0u) return;
+        if (_groupCount[runCode] == 0u) {
+            _groups.push_back(runCode);
+        }
+        _groupCount[runCode] += runLength;
+    };
+
+    for (uint32_t n = 0u; n < _size; n++) {
+        if (!_running[n]) continue;
+        if (cycle >= _frameCycles[n]) {
+            _running[n] = 0x00;
+            continue;
+        }
+
+        const uint16_t pc = _pc[n];
+        uint16_t code = _imageOpcodes[pc & AddressMask];
+        if (_privatePages[n] & (PageBit(pc) | PageBit(pc + 1u))) {
+            const uint8_t* memory = InstanceMemory(n);
+            code = (memory[pc & AddressMask] << 8) | memory[(pc + 1u) & AddressMask];
+        }
+
+        _opcode[n] = code;
+        _pending[n] = 0xFF;
+        if (code != runCode) {
+            FlushRun();
+            runCode = code;
+            runLength = 0u;
+        }
+        runLength += 1u;
+        active += 1u;
+    }
+    FlushRun();
+
+    InstructionCount += active;
+    return active;
+}
+
+void ConsoleBatch::RunGroups() {
+    // a masked kernel sweeps every lane, so it only pays off once the
+    // group is a few percent of them
+    for (const uint16_t code : _groups) {
+        const uint32_t count = _groupCount[code];
+        if (IsVectorOpcode(code) && count * Lanes::Width * 4u >= _size) {
+            RunVectorGroup(code);
+            VectorInstructionCount += count;
+        }
+        _groupCount[code] = 0u;
+    }
+    _groups.clear();
+
+    // whatever the kernels left pending runs one instance at a time
+    for (uint32_t base = 0u; base < _stride; base += Lanes::Width) {
+        uint32_t bits = Lanes::Bits(Lanes::Load(&_pending[base]));
+        while (bits != 0u) {
+            const uint32_t n = base + LowestBit(bits);
+            bits &= bits - 1u;
+
+            _pending[n] = 0x00;
+            _pc[n] += 2u;
+            ExecScalar(n, _opcode[n]);
+
+            if (_halted[n]) {
+                _running[n] = 0x00;
+            }
+        }
+    }
+}
+
+void ConsoleBatch::RunVectorGroup(const uint16_t code) {
+    uint8_t* const vx = V((code >> 8) & 0x0F);
+    uint8_t* const vy = V((code >> 4) & 0x0F);
+    uint8_t* const vf = V(REGISTER_CARRY_FLAG_INDEX);
+
+    const Lanes::Bytes kk = Lanes::Set(code & 0xFF);
+    const Lanes::Bytes one = Lanes::Set(1u);
+    const Lanes::Bytes two = Lanes::Set(2u);
+    const Lanes::Bytes four = Lanes::Set(4u);
+    const Lanes::Bytes zero = Lanes::Set(0u);
+
+    const uint16_t* opcodes = _opcode.data();
+    uint8_t* pending = _pending.data();
+    uint16_t* pc = _pc.data();
+    uint16_t* i = _i.data();
+    uint8_t* delay = _delay.data();
+    uint8_t* sound = _sound.data();
+
+    // VF is always written before Vx is re-read, so the kernels match the
+    // interpreter when x or y is F
+    switch (code & 0xF000) {
+        case 0x1000: // [1nnn] JP addr
+            Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                Lanes::SetWords(pc + n, mask, (code & 0x0FFF));
+                return zero;
+            });
+            break;
+
+        case 0xA000: // [Annn] LD I, addr
+            Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                Lanes::SetWords(i + n, mask, (code & 0x0FFF));
+                return two;
+            });
+            break;
+
+        case 0xF000:
+            switch (code & 0x00FF) {
+                case 0x07: // [Fx07] LD Vx, DT
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        StoreMasked(vx + n, mask, Lanes::Load(delay + n));
+                        return two;
+                    });
+                    break;
+
+                case 0x15: // [Fx15] LD DT, Vx
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        StoreMasked(delay + n, mask, Lanes::Load(vx + n));
+                        return two;
+                    });
+                    break;
+
+                case 0x18: // [Fx18] LD ST, Vx
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        StoreMasked(sound + n, mask, Lanes::Load(vx + n));
+                        return two;
+                    });
+                    break;
+
+                case 0x1E: // [Fx1E] ADD I, Vx
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        Lanes::AddWords(i + n, Lanes::And(mask, Lanes::Load(vx + n)));
+                        return two;
+                    });
+                    break;
+            }
+            break;
+
+        case 0xE000: {
+            // Ex9E skips when the key is down, ExA1 when it is up
+            const Lanes::Bytes skipWhen = Lanes::Set(((code & 0x00FF) == 0x9E) ? 0xFF : 0x00);
+            Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                const Lanes::Bytes key = Lanes::Load(vx + n);
+                assert(!Lanes::Any(Lanes::And(mask, Lanes::Greater(key, Lanes::Set(CHIP8_KEYS_SIZE - 1u)))));
+                (void)mask;
+
+                // only keys 0-F are compared, so a larger Vx reads as up
+                // without indexing out of the key rows, as in ExecScalar
+                Lanes::Bytes down = Lanes::Set(0u);
+                for (uint8_t k = 0u; k < CHIP8_KEYS_SIZE; k++) {
+                    down = Lanes::Or(down, Lanes::And(Lanes::Equal(key, Lanes::Set(k)), Lanes::Load(Key(k) + n)));
+                }
+                return Lanes::Add(two, Lanes::And(Lanes::Equal(down, skipWhen), two));
+            });
+            break;
+        }
+
+        case 0x3000: // [3xkk] SE Vx, byte
+            Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, Lanes::Bytes) {
+                return Lanes::Add(two, Lanes::And(Lanes::Equal(Lanes::Load(vx + n), kk), two));
+            });
+            break;
+
+        case 0x4000: // [4xkk] SNE Vx, byte
+            Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, Lanes::Bytes) {
+                return Lanes::Sub(four, Lanes::And(Lanes::Equal(Lanes::Load(vx + n), kk), two));
+            });
+            break;
+
+        case 0x5000: // [5xy0] SE Vx, Vy
+            Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, Lanes::Bytes) {
+                return Lanes::Add(two, Lanes::And(Lanes::Equal(Lanes::Load(vx + n), Lanes::Load(vy + n)), two));
+            });
+            break;
+
+        case 0x9000: // [9xy0] SNE Vx, Vy
+            Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, Lanes::Bytes) {
+                return Lanes::Sub(four, Lanes::And(Lanes::Equal(Lanes::Load(vx + n), Lanes::Load(vy + n)), two));
+            });
+            break;
+
+        case 0x6000: // [6xkk] LD Vx, byte
+            Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                StoreMasked(vx + n, mask, kk);
+                return two;
+            });
+            break;
+
+        case 0x7000: // [7xkk] ADD Vx, byte
+            Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                StoreMasked(vx + n, mask, Lanes::Add(Lanes::Load(vx + n), kk));
+                return two;
+            });
+            break;
+
+        case 0x8000:
+            switch (code & 0x000F) {
+                case 0x0: // [8xy0] LD Vx, Vy
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        StoreMasked(vx + n, mask, Lanes::Load(vy + n));
+                        return two;
+                    });
+                    break;
+
+                case 0x1: // [8xy1] OR Vx, Vy
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        StoreMasked(vx + n, mask, Lanes::Or(Lanes::Load(vx + n), Lanes::Load(vy + n)));
+                        return two;
+                    });
+                    break;
+
+                case 0x2: // [8xy2] AND Vx, Vy
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        StoreMasked(vx + n, mask, Lanes::And(Lanes::Load(vx + n), Lanes::Load(vy + n)));
+                        return two;
+                    });
+                    break;
+
+                case 0x3: // [8xy3] XOR Vx, Vy
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        StoreMasked(vx + n, mask, Lanes::Xor(Lanes::Load(vx + n), Lanes::Load(vy + n)));
+                        return two;
+                    });
+                    break;
+
+                case 0x4: // [8xy4] ADD Vx, Vy - VF = carry
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        const Lanes::Bytes a = Lanes::Load(vx + n);
+                        const Lanes::Bytes sum = Lanes::Add(a, Lanes::Load(vy + n));
+                        StoreMasked(vf + n, mask, Lanes::And(Lanes::Greater(a, sum), one));
+                        StoreMasked(vx + n, mask, sum);
+                        return two;
+                    });
+                    break;
+
+                case 0x5: // [8xy5] SUB Vx, Vy - VF = NOT borrow
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        StoreMasked(vf + n, mask, Lanes::And(Lanes::Greater(Lanes::Load(vx + n), Lanes::Load(vy + n)), one));
+                        StoreMasked(vx + n, mask, Lanes::Sub(Lanes::Load(vx + n), Lanes::Load(vy + n)));
+                        return two;
+                    });
+                    break;
+
+                case 0x6: // [8xy6] SHR Vx
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        StoreMasked(vf + n, mask, Lanes::And(Lanes::Load(vx + n), one));
+                        StoreMasked(vx + n, mask, Lanes::ShiftRight1(Lanes::Load(vx + n)));
+                        return two;
+                    });
+                    break;
+
+                case 0x7: // [8xy7] SUBN Vx, Vy
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        StoreMasked(vf + n, mask, Lanes::And(Lanes::Greater(Lanes::Load(vy + n), Lanes::Load(vx + n)), one));
+                        StoreMasked(vx + n, mask, Lanes::Sub(Lanes::Load(vy + n), Lanes::Load(vx + n)));
+                        return two;
+                    });
+                    break;
+
+                case 0xE: // [8xyE] SHL Vx
+                    Sweep(opcodes, pending, pc, _stride, code, [&](const uint32_t n, const Lanes::Bytes mask) {
+                        StoreMasked(vf + n, mask, Lanes::And(Lanes::Greater(Lanes::Load(vx + n), Lanes::Set(0x7F)), one));
+                        StoreMasked(vx + n, mask, Lanes::Add(Lanes::Load(vx + n), Lanes::Load(vx + n)));
+                        return two;
+                    });
+                    break;
+            }
+            break;
+    }
+}
+
+// Mirrors CPU::Exec over the batch's arrays; PC already points past the opcode
+void ConsoleBatch::ExecScalar(const uint32_t n, const uint16_t code) {
+    // decoded inline, this runs once per instance and cycle
+    const uint8_t x = (code >> 8) & 0x0F;
+    const uint8_t y = (code >> 4) & 0x0F;
+    const uint8_t nibble = code & 0x0F;
+    const uint8_t kk = code & 0xFF;
+    const uint16_t nnn = code & 0x0FFF;
+    uint8_t& Vx = V(x)[n];
+    uint8_t& Vy = V(y)[n];
+    uint8_t& VF = V(REGISTER_CARRY_FLAG_INDEX)[n];
+    uint8_t* memory = InstanceMemory(n);
+
+    switch (code & 0xF000) {
+        case 0x0000:
+            if (code == 0x00E0) { // [00E0] CLS
+                _screens[n].Clear();
+            } else if (code == 0x00EE) { // [00EE] RET
+                // like Stack::Pop, an empty stack returns 0
+                assert(_sp[n] > 0u);
+                if (_sp[n] == 0u) {
+                    _pc[n] = 0u;
+                } else {
+                    _sp[n] -= 1u;
+                    _pc[n] = _stack[_sp[n] * _stride + n];
+                }
+            }
+            break;
+
+        case 0x1000: // [1nnn] JP addr
+            _pc[n] = nnn;
+            break;
+
+        case 0x2000: // [2nnn] CALL addr
+            // like Stack::Push, a full stack drops the return address
+            assert(_sp[n] < CHIP8_MEMORY_STACK_SIZE);
+            if (_sp[n] < CHIP8_MEMORY_STACK_SIZE) {
+                _stack[_sp[n] * _stride + n] = _pc[n];
+                _sp[n] += 1u;
+            }
+            _pc[n] = nnn;
+            break;
+
+        case 0x3000: // [3xkk] SE Vx, byte
+            if (Vx == kk) _pc[n] += 2u;
+            break;
+
+        case 0x4000: // [4xkk] SNE Vx, byte
+            if (Vx != kk) _pc[n] += 2u;
+            break;
+
+        case 0x5000: // [5xy0] SE Vx, Vy
+            if (Vx == Vy) _pc[n] += 2u;
+            break;
+
+        case 0x6000: // [6xkk] LD Vx, byte
+            Vx = kk;
+            break;
+
+        case 0x7000: // [7xkk] ADD Vx, byte
+            Vx += kk;
+            break;
+
+        case 0x8000:
+            switch (code & 0x000F) {
+                case 0x0: Vx = Vy; break;
+                case 0x1: Vx |= Vy; break;
+                case 0x2: Vx &= Vy; break;
+                case 0x3: Vx ^= Vy; break;
+                case 0x4: {
+                    const uint16_t tmp16 = Vx + Vy;
+                    VF = tmp16 > 0xFF;
+                    Vx = tmp16;
+                    break;
+                }
+                case 0x5:
+                    VF = Vx > Vy;
+                    Vx -= Vy;
+                    break;
+                case 0x6:
+                    VF = Vx & 0x01;
+                    Vx /= 2;
+                    break;
+                case 0x7:
+                    VF = Vy > Vx;
+                    Vx = Vy - Vx;
+                    break;
+                case 0xE:
+                    VF = (Vx & 0b1000'0000) >> 7;
+                    Vx *= 2;
+                    break;
+            }
+            break;
+
+        case 0x9000: // [9xy0] SNE Vx, Vy
+            if (Vx != Vy) _pc[n] += 2u;
+            break;
+
+        case 0xA000: // [Annn] LD I, addr
+            _i[n] = nnn;
+            break;
+
+        case 0xB000: // [Bnnn] JP V0, addr
+            _pc[n] = nnn + V(0)[n];
+            break;
+
+        case 0xC000: // [Cxkk] RND Vx, byte
+            Vx = _random[n].Next() % 255 & kk;
+            break;
+
+        case 0xD000: { // [Dxyn] DRW Vx, Vy, nibble
+            // copied so a sprite near the end of memory wraps instead of overrunning
+            uint8_t sprite[16];
+            for (uint8_t i = 0u; i < nibble; i++) {
+                sprite[i] = memory[(_i[n] + i) & AddressMask];
+            }
+            VF = _screens[n].DrawSprite(Vx, Vy, sprite, nibble);
+            break;
+        }
+
+        case 0xE000: {
+            const auto IsKeyDown = [this, n](const uint8_t key) {
+                AssertKeyInBounds(key);
+                return key < CHIP8_KEYS_SIZE && Key(key)[n] != 0u;
+            };
+            if ((code & 0x00FF) == 0x9E && IsKeyDown(Vx)) { // [Ex9E] SKP Vx
+                _pc[n] += 2u;
+            } else if ((code & 0x00FF) == 0xA1 && !IsKeyDown(Vx)) { // [ExA1] SKNP Vx
+                _pc[n] += 2u;
+            }
+            break;
+        }
+
+        case 0xF000:
+            switch (code & 0x00FF) {
+                case 0x07: Vx = _delay[n]; break;
+                case 0x0A: // [Fx0A] LD Vx, K - resumed by SetKeyDown
+                    _halted[n] = 1u;
+                    _keyWaitRegister[n] = x;
+                    break;
+                case 0x15: _delay[n] = Vx; break;
+                case 0x18: _sound[n] = Vx; break;
+                case 0x1E: _i[n] += Vx; break;
+                case 0x29: _i[n] = Vx * CHIP8_DEFAULT_SPRITE_HEIGHT; break;
+                case 0x33: {
+                    const uint8_t value = Vx;
+                    memory[_i[n] & AddressMask] = value / 100;
+                    memory[(_i[n] + 1u) & AddressMask] = value / 10 % 10;
+                    memory[(_i[n] + 2u) & AddressMask] = value % 10;
+                    _privatePages[n] |= PageBit(_i[n]) | PageBit(_i[n] + 2u);
+                    break;
+                }
+                case 0x55:
+                    for (uint8_t i = 0u; i <= x; i++) {
+                        memory[(_i[n] + i) & AddressMask] = V(i)[n];
+                    }
+                    _privatePages[n] |= PageBit(_i[n]) | PageBit(_i[n] + x);
+                    break;
+                case 0x65:
+                    for (uint8_t i = 0u; i <= x; i++) {
+                        V(i)[n] = memory[(_i[n] + i) & AddressMask];
+                    }
+                    break;
+            }
+            break;
+    }
+}
+
+void ConsoleBatch::SetKeyDown(const uint32_t index, const int vKey) {
+    assert(index < _size);
+    AssertKeyInBounds(vKey);
+    Key(vKey)[index] = 0xFF;
+
+    if (_halted[index]) {
+        V(_keyWaitRegister[index])[index] = static_cast<uint8_t>(vKey);
+        _halted[index] = 0u;
+    }
+}
+
+void ConsoleBatch::SetKeyUp(const uint32_t index, const int vKey) {
+    assert(index < _size);
+    AssertKeyInBounds(vKey);
+    Key(vKey)[index] = 0x00;
+}
+
+uint8_t ConsoleBatch::GetV(const uint32_t index, const uint8_t x) const {
+    assert(index < _size && x < CHIP8_DATA_REGISTERS_SIZE);
+    return _v[x * _stride + index];
+}
+
+uint16_t ConsoleBatch::GetI(const uint32_t index) const {
+    assert(index < _size);
+    return _i[index];
+}
+
+uint16_t ConsoleBatch::GetPC(const uint32_t index) const {
+    assert(index < _size);
+    return _pc[index];
+}
+
+uint8_t ConsoleBatch::GetDelay(const uint32_t index) const {
+    assert(index < _size);
+    return _delay[index];
+}
+
+uint8_t ConsoleBatch::GetSound(const uint32_t index) const {
+    assert(index < _size);
+    return _sound[index];
+}
+
+bool ConsoleBatch::IsHalted(const uint32_t index) const {
+    assert(index < _size);
+    return _halted[index] != 0u;
+}
+
+bool ConsoleBatch::IsSoundOn(const uint32_t index) const {
+    assert(index < _size);
+    return _soundOn[index] != 0u;
+}
+
+const Screen& ConsoleBatch::GetScreen(const uint32_t index) const {
+    assert(index < _size);
+    return _screens[index];
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+
+// Byte-lane SIMD primitives used by the ConsoleBatch kernels. Masks are
+// 0xFF in selected lanes and 0x00 elsewhere. The widest instruction set
+// enabled at compile time is used (-mavx2 or /arch:AVX2 selects AVX2,
+// every x86-64 compiler has SSE2); other targets get a one-lane fallback.
+
+#if defined(__AVX2__)
+#define CHIP8_LANES_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHIP8_LANES_SSE2 1
+#endif
+
+#if defined(CHIP8_LANES_AVX2) || defined(CHIP8_LANES_SSE2)
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#if defined(CHIP8_LANES_SSE2)
+struct Sse2Lanes {
+    using Bytes = __m128i;
+    static constexpr uint32_t Width = 16u;
+
+    static Bytes Load(const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void Store(uint8_t* p, const Bytes v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static Bytes Set(const uint8_t value) { return _mm_set1_epi8(static_cast<char>(value)); }
+
+    static Bytes Add(const Bytes a, const Bytes b) { return _mm_add_epi8(a, b); }
+    static Bytes Sub(const Bytes a, const Bytes b) { return _mm_sub_epi8(a, b); }
+    static Bytes And(const Bytes a, const Bytes b) { return _mm_and_si128(a, b); }
+    static Bytes Or(const Bytes a, const Bytes b) { return _mm_or_si128(a, b); }
+    static Bytes Xor(const Bytes a, const Bytes b) { return _mm_xor_si128(a, b); }
+    static Bytes ShiftRight1(const Bytes a) { return _mm_and_si128(_mm_srli_epi16(a, 1), Set(0x7F)); }
+
+    static Bytes Equal(const Bytes a, const Bytes b) { return _mm_cmpeq_epi8(a, b); }
+    // unsigned a > b
+    static Bytes Greater(const Bytes a, const Bytes b) {
+        return _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(a, b), _mm_setzero_si128()), Set(0xFF));
+    }
+    static Bytes Select(const Bytes mask, const Bytes a, const Bytes b) {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+    static bool Any(const Bytes mask) { return _mm_movemask_epi8(mask) != 0; }
+    static uint32_t Bits(const Bytes mask) { return static_cast<uint32_t>(_mm_movemask_epi8(mask)); }
+
+    // lanes whose opcode equals `code` and whose running byte is set
+    static Bytes Match(const uint16_t* opcodes, const uint16_t code, const uint8_t* running) {
+        const __m128i value = _mm_set1_epi16(static_cast<short>(code));
+        const __m128i low = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(opcodes)), value);
+        const __m128i high = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(opcodes + 8)), value);
+        return _mm_and_si128(_mm_packs_epi16(low, high), Load(running));
+    }
+
+    // words[i] += bytes[i], zero-extended
+    static void AddWords(uint16_t* words, const Bytes bytes) {
+        __m128i* p = reinterpret_cast<__m128i*>(words);
+        const __m128i zero = _mm_setzero_si128();
+        _mm_storeu_si128(p, _mm_add_epi16(_mm_loadu_si128(p), _mm_unpacklo_epi8(bytes, zero)));
+        _mm_storeu_si128(p + 1, _mm_add_epi16(_mm_loadu_si128(p + 1), _mm_unpackhi_epi8(bytes, zero)));
+    }
+
+    // words[i] = value in the selected lanes
+    static void SetWords(uint16_t* words, const Bytes mask, const uint16_t value) {
+        __m128i* p = reinterpret_cast<__m128i*>(words);
+        const __m128i v = _mm_set1_epi16(static_cast<short>(value));
+        const __m128i low = _mm_unpacklo_epi8(mask, mask);
+        const __m128i high = _mm_unpackhi_epi8(mask, mask);
+        _mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(low, v), _mm_andnot_si128(low, _mm_loadu_si128(p))));
+        _mm_storeu_si128(p + 1, _mm_or_si128(_mm_and_si128(high, v), _mm_andnot_si128(high, _mm_loadu_si128(p + 1))));
+    }
+};
+using Lanes = Sse2Lanes;
+#endif
+
+#if defined(CHIP8_LANES_AVX2)
+struct Avx2Lanes {
+    using Bytes = __m256i;
+    static constexpr uint32_t Width = 32u;
+
+    static Bytes Load(const uint8_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void Store(uint8_t* p, const Bytes v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    static Bytes Set(const uint8_t value) { return _mm256_set1_epi8(static_cast<char>(value)); }
+
+    static Bytes Add(const Bytes a, const Bytes b) { return _mm256_add_epi8(a, b); }
+    static Bytes Sub(const Bytes a, const Bytes b) { return _mm256_sub_epi8(a, b); }
+    static Bytes And(const Bytes a, const Bytes b) { return _mm256_and_si256(a, b); }
+    static Bytes Or(const Bytes a, const Bytes b) { return _mm256_or_si256(a, b); }
+    static Bytes Xor(const Bytes a, const Bytes b) { return _mm256_xor_si256(a, b); }
+    static Bytes ShiftRight1(const Bytes a) { return _mm256_and_si256(_mm256_srli_epi16(a, 1), Set(0x7F)); }
+
+    static Bytes Equal(const Bytes a, const Bytes b) { return _mm256_cmpeq_epi8(a, b); }
+    // unsigned a > b
+    static Bytes Greater(const Bytes a, const Bytes b) {
+        return _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_subs_epu8(a, b), _mm256_setzero_si256()), Set(0xFF));
+    }
+    static Bytes Select(const Bytes mask, const Bytes a, const Bytes b) { return _mm256_blendv_epi8(b, a, mask); }
+    static bool Any(const Bytes mask) { return _mm256_movemask_epi8(mask) != 0; }
+    static uint32_t Bits(const Bytes mask) { return static_cast<uint32_t>(_mm256_movemask_epi8(mask)); }
+
+    // lanes whose opcode equals `code` and whose running byte is set
+    static Bytes Match(const uint16_t* opcodes, const uint16_t code, const uint8_t* running) {
+        const __m256i value = _mm256_set1_epi16(static_cast<short>(code));
+        const __m256i low = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(opcodes)), value);
+        const __m256i high = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(opcodes + 16)), value);
+        // packs works within 128-bit halves, put the quadwords back in order
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+        return _mm256_and_si256(packed, Load(running));
+    }
+
+    // words[i] += bytes[i], zero-extended
+    static void AddWords(uint16_t* words, const Bytes bytes) {
+        __m256i* p = reinterpret_cast<__m256i*>(words);
+        const __m256i low = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes));
+        const __m256i high = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1));
+        _mm256_storeu_si256(p, _mm256_add_epi16(_mm256_loadu_si256(p), low));
+        _mm256_storeu_si256(p + 1, _mm256_add_epi16(_mm256_loadu_si256(p + 1), high));
+    }
+
+    // words[i] = value in the selected lanes
+    static void SetWords(uint16_t* words, const Bytes mask, const uint16_t value) {
+        __m256i* p = reinterpret_cast<__m256i*>(words);
+        const __m256i v = _mm256_set1_epi16(static_cast<short>(value));
+        const __m256i low = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(mask));
+        const __m256i high = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(mask, 1));
+        _mm256_storeu_si256(p, _mm256_blendv_epi8(_mm256_loadu_si256(p), v, low));
+        _mm256_storeu_si256(p + 1, _mm256_blendv_epi8(_mm256_loadu_si256(p + 1), v, high));
+    }
+};
+using Lanes = Avx2Lanes;
+#endif
+
+#if !defined(CHIP8_LANES_AVX2) && !defined(CHIP8_LANES_SSE2)
+struct ScalarLanes {
+    using Bytes = uint8_t;
+    static constexpr uint32_t Width = 1u;
+
+    static Bytes Load(const uint8_t* p) { return *p; }
+    static void Store(uint8_t* p, const Bytes v) { *p = v; }
+    static Bytes Set(const uint8_t value) { return value; }
+
+    static Bytes Add(const Bytes a, const Bytes b) { return static_cast<uint8_t>(a + b); }
+    static Bytes Sub(const Bytes a, const Bytes b) { return static_cast<uint8_t>(a - b); }
+    static Bytes And(const Bytes a, const Bytes b) { return a & b; }
+    static Bytes Or(const Bytes a, const Bytes b) { return a | b; }
+    static Bytes Xor(const Bytes a, const Bytes b) { return a ^ b; }
+    static Bytes ShiftRight1(const Bytes a) { return a >> 1; }
+
+    static Bytes Equal(const Bytes a, const Bytes b) { return (a == b) ? 0xFF : 0x00; }
+    static Bytes Greater(const Bytes a, const Bytes b) { return (a > b) ? 0xFF : 0x00; }
+    static Bytes Select(const Bytes mask, const Bytes a, const Bytes b) { return mask ? a : b; }
+    static bool Any(const Bytes mask) { return mask != 0u; }
+    static uint32_t Bits(const Bytes mask) { return mask & 1u; }
+
+    static Bytes Match(const uint16_t* opcodes, const uint16_t code, const uint8_t* running) {
+        return (*opcodes == code) ? *running : 0x00;
+    }
+
+    static void AddWords(uint16_t* words, const Bytes bytes) { *words += bytes; }
+
+    static void SetWords(uint16_t* words, const Bytes mask, const uint16_t value) {
+        if (mask) *words = value;
+    }
+};
+using Lanes = ScalarLanes;
+#endif
+
+// every kernel width divides this, so padded arrays never need a tail loop
+constexpr uint32_t MaxLaneWidth = 32u;
+
+// index of the lowest set bit, bits must not be 0
+inline uint32_t LowestBit(const uint32_t bits) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctz(bits));
+#endif
+}
@@ -1,12 +1,51 @@
 #include "chip8/cartridge/cartridge.h"
 
+#include <fstream>
+
 Cartridge::~Cartridge() {
     clear();
 }
 
+bool Cartridge::loadFromFile(char* path) {
+    // clear struct content
+    clear();
+
+    // load file
+    std::ifstream stream(path, std::ios_base::binary);
+    if (!stream.good()) {
+        return false;
+    }
+
+    // find file's size
+    stream.seekg(0, std::ios_base::end);
+    const std::streamoff fileSize = stream.tellg();
+    if (fileSize <= 0) {
+        return false;
+    }
+
+    filePath = path;
+    size = static_cast<size_t>(fileSize);
+
+    // read file contents into the Cartridge's buffer
+    stream.seekg(0, std::ios_base::beg);
+    buffer = new uint8_t[size];
+    stream.read((char*)buffer, size);
+    return true;
+}
+
 void Cartridge::clear() {
     delete[] buffer;
 
+    buffer = nullptr;
     filePath = nullptr;
     size = 0;
 }
+
+uint64_t Cartridge::hash() const {
+    uint64_t hash = 0xCBF2'9CE4'8422'2325ull;
+    for (size_t i = 0u; i < size; i++) {
+        hash ^= buffer[i];
+        hash *= 0x0000'0100'0000'01B3ull;
+    }
+    return hash;
+}
@@ -0,0 +1,195 @@
+#include "chip8/cartridge/rom_catalog.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    std::string Trim(const std::string& text) {
+        const size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos) return {};
+
+        const size_t last = text.find_last_not_of(" \t\r");
+        return text.substr(first, last - first + 1u);
+    }
+
+    bool ParseNumber(const std::string& text, const int base, uint64_t& outValue) {
+        if (text.empty()) return false;
+
+        char* end = nullptr;
+        outValue = strtoull(text.c_str(), &end, base);
+        return *end == '\0';
+    }
+
+    void WriteAddresses(std::ostream& out, const AddressSet& addresses) {
+        // opcodes at odd addresses make runs of their own, interleaved with the even ones
+        AddressSet left = addresses;
+        char range[16];
+        for (uint32_t address = 0u; address < CHIP8_MEMORY_SIZE; address++) {
+            if (!left[address]) continue;
+
+            uint32_t last = address;
+            left.reset(address);
+            while (last + 2u < CHIP8_MEMORY_SIZE && left[last + 2u]) {
+                last += 2u;
+                left.reset(last);
+            }
+            snprintf(range, sizeof(range), " %x-%x", address, last);
+            out << range;
+        }
+    }
+
+    bool ReadAddresses(const std::string& text, AddressSet& outAddresses) {
+        std::istringstream fields(text);
+        std::string range;
+        while (fields >> range) {
+            const size_t dash = range.find('-');
+            uint64_t first = 0u;
+            uint64_t last = 0u;
+            if (dash == std::string::npos
+                || !ParseNumber(range.substr(0u, dash), 16, first)
+                || !ParseNumber(range.substr(dash + 1u), 16, last)
+                || first > last || last >= CHIP8_MEMORY_SIZE) {
+                return false;
+            }
+
+            for (uint64_t address = first; address <= last; address += 2u) {
+                outAddresses.set(address);
+            }
+        }
+        return true;
+    }
+}
+
+const RomEntry* RomCatalog::Find(const uint64_t hash, const size_t size) const {
+    const auto it = _entries.find(hash);
+    if (it == _entries.end() || it->second.Size != size) return nullptr;
+    return &it->second;
+}
+
+RomEntry& RomCatalog::Get(const uint64_t hash, const size_t size) {
+    RomEntry& entry = _entries[hash];
+    if (entry.Hash != hash || entry.Size != size) {
+        entry = RomEntry();
+        entry.Hash = hash;
+        entry.Size = size;
+    }
+    return entry;
+}
+
+bool RomCatalog::SaveToFile(const char* path) const {
+    std::ofstream stream(path);
+    if (!stream.good()) {
+        return false;
+    }
+
+    stream << "version = " << Version << std::endl;
+
+    char text[64];
+    for (const auto& pair : _entries) {
+        const RomEntry& entry = pair.second;
+
+        snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(entry.Hash));
+        stream << std::endl << "[rom " << text << "]" << std::endl;
+        if (!entry.Name.empty()) {
+            stream << "name = " << entry.Name << std::endl;
+        }
+        stream << "size = " << entry.Size << std::endl;
+        if (entry.CyclesPerFrame != 0u) {
+            stream << "cycles-per-frame = " << entry.CyclesPerFrame << std::endl;
+        }
+
+        Quirk::Format(entry.Quirks, text, sizeof(text));
+        stream << "quirks = " << text << std::endl;
+
+        for (size_t i = 0u; i < CHIP8_KEYS_SIZE; i++) {
+            snprintf(text + i, sizeof(text) - i, "%x", entry.KeyMap[i] & 0xFu);
+        }
+        stream << "keys = " << text << std::endl;
+
+        if (entry.IdleLoops.any()) {
+            stream << "idle-loops =";
+            WriteAddresses(stream, entry.IdleLoops);
+            stream << std::endl;
+        }
+        if (entry.Code.any()) {
+            stream << "code =";
+            WriteAddresses(stream, entry.Code);
+            stream << std::endl;
+        }
+    }
+    return stream.good();
+}
+
+bool RomCatalog::LoadFromFile(const char* path) {
+    _entries.clear();
+
+    std::ifstream stream(path);
+    if (!stream.good()) {
+        return true;
+    }
+
+    std::map<uint64_t, RomEntry> entries;
+    RomEntry* entry = nullptr;
+    bool versionRead = false;
+
+    std::string line;
+    while (std::getline(stream, line)) {
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        line = Trim(line);
+        if (line.empty()) continue;
+
+        if (line.front() == '[') {
+            uint64_t hash = 0u;
+            if (line.back() != ']' || line.compare(0u, 5u, "[rom ") != 0
+                || !ParseNumber(Trim(line.substr(5u, line.size() - 6u)), 16, hash)) {
+                return false;
+            }
+
+            entry = &entries[hash];
+            entry->Hash = hash;
+            continue;
+        }
+
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) return false;
+
+        const std::string key = Trim(line.substr(0u, equals));
+        const std::string value = Trim(line.substr(equals + 1u));
+        uint64_t number = 0u;
+
+        if (entry == nullptr) {
+            if (key != "version") continue;
+            if (!ParseNumber(value, 10, number) || number != Version) return false;
+            versionRead = true;
+        } else if (key == "name") {
+            entry->Name = value;
+        } else if (key == "size") {
+            if (!ParseNumber(value, 10, number)) return false;
+            entry->Size = static_cast<size_t>(number);
+        } else if (key == "cycles-per-frame") {
+            if (!ParseNumber(value, 10, number) || number > UINT32_MAX) return false;
+            entry->CyclesPerFrame = static_cast<uint32_t>(number);
+        } else if (key == "quirks") {
+            if (!Quirk::Parse(value.c_str(), entry->Quirks)) return false;
+        } else if (key == "keys") {
+            if (value.size() != CHIP8_KEYS_SIZE) return false;
+            for (size_t i = 0u; i < CHIP8_KEYS_SIZE; i++) {
+                if (!ParseNumber(value.substr(i, 1u), 16, number)) return false;
+                entry->KeyMap[i] = static_cast<uint8_t>(number);
+            }
+        } else if (key == "idle-loops") {
+            if (!ReadAddresses(value, entry->IdleLoops)) return false;
+        } else if (key == "code") {
+            if (!ReadAddresses(value, entry->Code)) return false;
+        }
+    }
+    if (!versionRead && !entries.empty()) return false;
+
+    _entries = std::move(entries);
+    return true;
+}
@@ -0,0 +1,22 @@
+#include "chip8/cartridge/rom_profile.h"
+
+namespace {
+    // The ROMs in rom/, all written for interpreters that shift Vx in place
+    // and leave I alone, which is what the CPU does without quirks
+    const RomProfile Profiles[] = {
+            {0x25E9'6E10'86CE'43CBull, "maze", Quirk::None},
+            {0x0F81'C6A7'4DCD'366Eull, "pong", Quirk::None},
+            {0x618A'84F0'6FE3'2861ull, "space-invaders", Quirk::None},
+            {0xB45B'7F67'1FD4'E77Bull, "test-opcode", Quirk::None},
+            {0x04EB'2109'DC29'B1ABull, "tetris", Quirk::None},
+    };
+}
+
+const RomProfile* RomProfile::Find(const uint64_t hash) {
+    for (const RomProfile& profile : Profiles) {
+        if (profile.Hash == hash) {
+            return &profile;
+        }
+    }
+    return nullptr;
+}
@@ -1,7 +1,10 @@
 #include "chip8/console.h"
+#include "chip8/cartridge/rom_catalog.h"
+#include "chip8/cartridge/rom_profile.h"
 
 #include <cstdint>
 #include <cassert>
+#include <cstring>
 #include <ctime>
 
 Console::Console()
@@ -10,50 +13,143 @@ Console::Console()
 
     LoadDefaultCharacterSet();
 
-    //TODO: Move this into another place
-    srand(clock());
+    // differs on every run; seed Cpu.Rng again for a reproducible one
+    Cpu.Rng.Seed(static_cast<uint32_t>(clock()));
 }
 
+const uint8_t Console::DefaultCharacterSet[] = {
+        0xF0, 0x90, 0x90, 0x90, 0xF0,
+        0x20, 0x60, 0x20, 0x20, 0x70,
+        0xF0, 0x10, 0xF0, 0x80, 0xF0,
+        0xF0, 0x10, 0xF0, 0x10, 0xF0,
+        0x90, 0x90, 0xF0, 0x10, 0x10,
+        0xF0, 0x80, 0xF0, 0x10, 0xF0,
+        0xF0, 0x80, 0xF0, 0x90, 0xF0,
+        0xF0, 0x10, 0x20, 0x40, 0x40,
+        0xF0, 0x90, 0xF0, 0x90, 0xF0,
+        0xF0, 0x90, 0xF0, 0x10, 0xF0,
+        0xF0, 0x90, 0xF0, 0x90, 0x90,
+        0xE0, 0x90, 0xE0, 0x90, 0xE0,
+        0xF0, 0x80, 0x80, 0x80, 0xF0,
+        0xE0, 0x90, 0x90, 0x90, 0xE0,
+        0xF0, 0x80, 0xF0, 0x80, 0xF0,
+        0xF0, 0x80, 0xF0, 0x80, 0x80
+};
+
 void Console::LoadDefaultCharacterSet() {
-    constexpr uint8_t defaultCharacterSet[] = {
-            0xF0, 0x90, 0x90, 0x90, 0xF0,
-            0x20, 0x60, 0x20, 0x20, 0x70,
-            0xF0, 0x10, 0xF0, 0x80, 0xF0,
-            0xF0, 0x10, 0xF0, 0x10, 0xF0,
-            0x90, 0x90, 0xF0, 0x10, 0x10,
-            0xF0, 0x80, 0xF0, 0x10, 0xF0,
-            0xF0, 0x80, 0xF0, 0x90, 0xF0,
-            0xF0, 0x10, 0x20, 0x40, 0x40,
-            0xF0, 0x90, 0xF0, 0x90, 0xF0,
-            0xF0, 0x90, 0xF0, 0x10, 0xF0,
-            0xF0, 0x90, 0xF0, 0x90, 0x90,
-            0xE0, 0x90, 0xE0, 0x90, 0xE0,
-            0xF0, 0x80, 0x80, 0x80, 0xF0,
-            0xE0, 0x90, 0x90, 0x90, 0xE0,
-            0xF0, 0x80, 0xF0, 0x80, 0xF0,
-            0xF0, 0x80, 0xF0, 0x80, 0x80
-    };
-    Memory.WriteBuffer(CHIP8_MEMORY_ADDRESS_CHARACTER_SET, defaultCharacterSet, sizeof(defaultCharacterSet));
+    Memory.WriteBuffer(CHIP8_MEMORY_ADDRESS_CHARACTER_SET, DefaultCharacterSet, sizeof(DefaultCharacterSet));
 }
 
 void Console::InsertCartridge(const Cartridge& outCartridge) {
     assert((outCartridge.size + CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD) < CHIP8_MEMORY_SIZE);
     Memory.WriteBuffer(CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD, outCartridge.buffer, outCartridge.size);
     Cpu.PC = CHIP8_MEMORY_ADDRESS_PROGRAM_LOAD;
+
+    const RomProfile* profile = RomProfile::Find(outCartridge.hash());
+    Cpu.SetQuirks((profile != nullptr) ? profile->Quirks : Quirk::None);
 }
 
 void Console::Cycle() {
-    if (Cpu.Halted) return;
+    if (!Cpu.ResumeFromKeyWait()) return;
 
-    Screen.Dirty = false;
     Cpu.Flags.Sound = false;
 
-    for (uint32_t i = 0u; i < Config::Cpu::CyclesPerFrame; i++) {
-        Cpu.ExecNextOpcode();
-        if (Cpu.Halted) return;
+    const uint32_t done = Settings.SkipIdleLoops ? Cpu.SkipIdleLoop(Settings.CyclesPerFrame) : 0u;
+    if (done < Settings.CyclesPerFrame) {
+        Cpu.Run(Settings.CyclesPerFrame - done);
     }
+    if (Cpu.Halted) return;
 
     Cpu.UpdateTimers();
 
     Cpu.Flags.Sound = (Cpu.Sound > 0u);
 }
+
+void Console::Apply(const RomEntry& entry) {
+    if (entry.CyclesPerFrame != 0u) {
+        Settings.CyclesPerFrame = entry.CyclesPerFrame;
+    }
+    Cpu.SetQuirks(entry.Quirks);
+    Cpu.Predecode(entry.Code);
+    Cpu.IdleLoopAddresses |= entry.IdleLoops;
+}
+
+void Console::Analyze(RomEntry& outEntry) const {
+    Cpu.CollectCode(outEntry.Code);
+    outEntry.IdleLoops |= Cpu.IdleLoopAddresses;
+}
+
+void Console::SaveState(ConsoleState& outState) const {
+    outState.InstructionCount = Cpu.InstructionCount;
+    memcpy(outState.ScreenRows, Screen.Rows, sizeof(outState.ScreenRows));
+    outState.RandomState = Cpu.Rng.State;
+
+    outState.I = Cpu.I;
+    outState.PC = Cpu.PC;
+    memcpy(outState.Stack, Stack.stack, sizeof(outState.Stack));
+
+    memcpy(outState.V, Cpu.V, sizeof(outState.V));
+    outState.Delay = Cpu.Delay;
+    outState.Sound = Cpu.Sound;
+    outState.SP = Stack.SP;
+    outState.KeyWaitRegister = Cpu.KeyWaitRegister;
+    outState.LatchedKey = Keyboard._latchedKey;
+    outState.Halted = Cpu.Halted;
+    outState.DrawFlag = Cpu.Flags.Draw;
+    outState.SoundFlag = Cpu.Flags.Sound;
+    outState.Quirks = Cpu.GetQuirks();
+    memcpy(outState.Keys, Keyboard._keyboard, sizeof(outState.Keys));
+
+    memcpy(outState.Memory, Memory.GetPtr(0u), sizeof(outState.Memory));
+}
+
+void Console::LoadState(const ConsoleState& state) {
+    // before the memory, as switching drops every decoded opcode
+    if (Cpu.GetQuirks() != state.Quirks) {
+        Cpu.SetQuirks(state.Quirks);
+    }
+
+    // states forked from one another mostly share their code, so compare
+    // first and keep the decoded opcodes of every chunk that is unchanged
+    constexpr uint16_t chunkSize = 64u;
+    const uint8_t* memory = Memory.GetPtr(0u);
+    for (uint16_t address = 0u; address < CHIP8_MEMORY_SIZE; address += chunkSize) {
+        if (memcmp(memory + address, state.Memory + address, chunkSize) != 0) {
+            Memory.WriteBuffer(address, state.Memory + address, chunkSize);
+        }
+    }
+
+    Cpu.InstructionCount = state.InstructionCount;
+    memcpy(Screen.Rows, state.ScreenRows, sizeof(Screen.Rows));
+    Cpu.Rng.State = state.RandomState;
+
+    Cpu.I = state.I;
+    Cpu.PC = state.PC;
+    memcpy(Stack.stack, state.Stack, sizeof(Stack.stack));
+
+    memcpy(Cpu.V, state.V, sizeof(Cpu.V));
+    Cpu.Delay = state.Delay;
+    Cpu.Sound = state.Sound;
+    Stack.SP = state.SP;
+    Cpu.KeyWaitRegister = state.KeyWaitRegister;
+    Keyboard._latchedKey = state.LatchedKey;
+    Cpu.Halted = state.Halted;
+    Cpu.Flags.Draw = state.DrawFlag;
+    Cpu.Flags.Sound = state.SoundFlag;
+    Screen.MarkAllDirty();
+    memcpy(Keyboard._keyboard, state.Keys, sizeof(Keyboard._keyboard));
+}
+
+void Console::SaveState(std::vector<uint8_t>& outBlob) const {
+    ConsoleState state;
+    SaveState(state);
+    state.Serialize(outBlob);
+}
+
+bool Console::LoadState(const uint8_t* blob, const size_t size) {
+    ConsoleState state;
+    if (!state.Deserialize(blob, size)) return false;
+
+    LoadState(state);
+    return true;
+}
@@ -4,6 +4,7 @@ namespace Config {
     namespace Cpu {
         uint32_t CyclesPerFrame = 10u;
         double FrameTime = (1000.0 / 60.0);
+        bool SkipIdleLoops = true;
     }
     namespace Screen {
         uint32_t SizeMultiplier = 10u;
@@ -0,0 +1,147 @@
+#include "chip8/cpu/code_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "chip8/cpu/cpu.h"
+#include "chip8/cpu/jit.h"
+#include "chip8/state/byte_stream.h"
+#include "chip8/state/mapped_file.h"
+
+namespace {
+    // "C8CC", version, engine version, ROM hash, quirks, decoded opcodes, Jit blocks
+    const uint8_t Magic[4] = {'C', '8', 'C', 'C'};
+    constexpr size_t HeaderSize = sizeof(Magic) + 2u + 2u + 8u + 1u;
+    // address, opcode, OpId
+    constexpr size_t OpcodeSize = 2u + 2u + 1u;
+}
+
+void CodeCache::Serialize(const CPU& cpu, const uint64_t romHash, std::vector<uint8_t>& outBlob) {
+    ByteWriter w {outBlob};
+    w.Bytes(Magic, sizeof(Magic));
+    w.U16(Version);
+    w.U16(EngineVersion);
+    w.U64(romHash);
+    w.U8(cpu._quirks);
+
+    uint32_t count = 0u;
+    for (uint16_t address = 0u; address < CHIP8_MEMORY_SIZE; address++) {
+        if (cpu._decodeCache.IsDecoded(address)) count += 1u;
+    }
+    w.U32(count);
+
+    // the operands and the handler follow from the opcode and the quirks
+    const uint8_t* memory = cpu._memory->GetPtr(0);
+    for (uint16_t address = 0u; address < CHIP8_MEMORY_SIZE; address++) {
+        if (!cpu._decodeCache.IsDecoded(address)) continue;
+
+        const DecodedOpcode& entry = cpu._decodeCache.Get(address);
+        w.U16(address);
+        w.U16(static_cast<uint16_t>((memory[address] << 8) | memory[(address + 1u) & (CHIP8_MEMORY_SIZE - 1u)]));
+        w.U8(static_cast<uint8_t>(entry.Op));
+    }
+
+    w.U8((cpu._jit != nullptr) ? 1u : 0u);
+    if (cpu._jit != nullptr) {
+        cpu._jit->Save(w);
+    }
+}
+
+bool CodeCache::Install(CPU& cpu, const uint64_t romHash, const uint8_t* blob, const size_t size) {
+    Opcodes = 0u;
+    Blocks = 0u;
+
+    if (blob == nullptr || size < HeaderSize + 4u) return false;
+    if (memcmp(blob, Magic, sizeof(Magic)) != 0) return false;
+
+    ByteReader r {blob + sizeof(Magic)};
+    if (r.U16() != Version || r.U16() != EngineVersion) return false;
+    if (r.U64() != romHash || r.U8() != cpu._quirks) return false;
+
+    const uint8_t* end = blob + size;
+    const size_t count = r.U32();
+    if (count * OpcodeSize > static_cast<size_t>(end - r.data)) return false;
+
+    // the OpId only saves classifying the opcode again; a file that disagrees
+    // with the opcode it stores is corrupt or foreign, and installs nothing
+    ByteReader check {r.data};
+    for (size_t i = 0u; i < count; i++) {
+        check.U16();
+        const uint16_t code = check.U16();
+        const uint8_t op = check.U8();
+        if (op >= static_cast<uint8_t>(OpId::Count)) return false;
+        if (static_cast<OpId>(op) != CPU::DecodeOp(code)) return false;
+    }
+
+    const uint8_t* memory = cpu._memory->GetPtr(0);
+    for (size_t i = 0u; i < count; i++) {
+        const uint16_t address = r.U16() & (CHIP8_MEMORY_SIZE - 1u);
+        const uint16_t code = r.U16();
+        const uint8_t op = r.U8();
+
+        // a rewritten opcode decodes again when it runs
+        if (code != ((memory[address] << 8) | memory[(address + 1u) & (CHIP8_MEMORY_SIZE - 1u)])) continue;
+
+        DecodedOpcode& entry = cpu._decodeCache.Get(address);
+        if (entry.Handler != nullptr) continue;
+        entry = CPU::Decode(code, static_cast<OpId>(op), cpu._quirks);
+        cpu.Fuse(address, entry);
+        Opcodes += 1u;
+    }
+
+    // the opcodes are in place; a file cut before the Jit blocks just has none
+    if (r.data == end) return true;
+    if (r.U8() == 0u || cpu.Engine != CpuEngine::Jit) return true;
+
+    if (cpu._jit == nullptr) {
+        cpu._jit.reset(new Jit(cpu));
+    }
+    return cpu._jit->Load(r, end, Blocks);
+}
+
+bool CodeCache::SaveToFile(const CPU& cpu, const uint64_t romHash, const char* path) {
+    std::vector<uint8_t> blob;
+    Serialize(cpu, romHash, blob);
+    return SaveToFile(blob, path);
+}
+
+bool CodeCache::SaveToFile(const std::vector<uint8_t>& blob, const char* path) {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%llx.tmp", static_cast<unsigned long long>(std::chrono::steady_clock::now().time_since_epoch().count()));
+    const std::string temporaryPath = std::string(path) + suffix;
+    {
+        std::ofstream stream(temporaryPath, std::ios_base::binary);
+        if (!stream.good()) {
+            return false;
+        }
+        stream.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+        if (!stream.good()) {
+            stream.close();
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    // rename doesn't replace an existing file everywhere
+    if (std::rename(temporaryPath.c_str(), path) != 0) {
+        std::remove(path);
+        if (std::rename(temporaryPath.c_str(), path) != 0) {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CodeCache::LoadFromFile(CPU& cpu, const uint64_t romHash, const char* path) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        Opcodes = 0u;
+        Blocks = 0u;
+        return false;
+    }
+    return Install(cpu, romHash, file.GetData(), file.GetSize());
+}
@@ -1,10 +1,47 @@
 #include "chip8/cpu/cpu.h"
+#include "chip8/cpu/flight_recorder.h"
+#include "chip8/cpu/jit.h"
+#include "chip8/cpu/ops.h"
+#include "chip8/cpu/profiler.h"
+
+CPU::CPU() = default;
+CPU::~CPU() = default;
 
 void CPU::Init(Memory* memory, Stack* stack, Screen* screen, Keyboard* keyboard) {
     this->_memory = memory;
     this->_stack = stack;
     this->_screen = screen;
     this->_keyboard = keyboard;
+
+    _decodeCache.Clear();
+    _memory->SetObserver(this);
+}
+
+void CPU::SetQuirks(const uint8_t quirks) {
+    if ((quirks & Quirk::All) == _quirks) return;
+
+    _quirks = quirks & Quirk::All;
+    _decodeCache.Clear();
+    _jit.reset();
+}
+
+void CPU::OnMemoryWrite(const uint16_t address, const size_t size) {
+    MemoryWriteCount += 1u;
+    _decodeCache.Invalidate(address, size);
+
+    if (_jit != nullptr) {
+        _jit->Invalidate(address, size);
+    }
+}
+
+void CPU::OnMemoryFault(const uint16_t address) {
+    Fault(TraceReason::MemoryOutOfRange, address);
+}
+
+void CPU::Fault(const TraceReason reason, const uint16_t address) {
+    if (Recorder != nullptr) {
+        Recorder->OnFault(*this, reason, address);
+    }
 }
 
 void CPU::UpdateTimers() {
@@ -18,14 +55,184 @@ void CPU::UpdateTimers() {
 }
 
 void CPU::ExecNextOpcode() {
-    const uint16_t code = ReadNextOpcode();
-    Exec(code);
+    Run(1u);
+}
+
+bool CPU::ResumeFromKeyWait() {
+    if (!Halted) return true;
+
+    const int key = _keyboard->GetLatchedKey();
+    if (key < 0) return false;
+
+    V[KeyWaitRegister] = static_cast<uint8_t>(key);
+    Halted = false;
+    return true;
+}
+
+uint32_t CPU::SkipIdleLoop(const uint32_t count) {
+    // the recorder and the profiler have to see every instruction
+    if (Recorder != nullptr || Halted) return 0u;
+#if CHIP8_PROFILE
+    if (Profile != nullptr) return 0u;
+#endif
+
+    const bool knownLoop = IdleLoopAddresses[PC & (CHIP8_MEMORY_SIZE - 1u)];
+    if (!_idleBackoff.ShouldCheck() && !knownLoop) return 0u;
+
+    IdleLoop loop;
+    if (!IdleLoop::Find(_memory->GetPtr(0u), PC, loop)) {
+        _idleBackoff.Miss();
+        return 0u;
+    }
+
+    uint32_t skipped = 0u;
+    const uint32_t executed = loop.Run(PC, count,
+        [this]() {
+            Exec(ReadNextOpcode());
+            return PC;
+        },
+        [this](IdleLoop::State& outState) {
+            memcpy(outState.V, V, sizeof(V));
+            outState.I = I;
+        },
+        skipped);
+
+    InstructionCount += executed + skipped;
+    IdleInstructionCount += skipped;
+    if (skipped > 0u) {
+        _idleBackoff.Hit();
+        for (uint16_t address = loop.Top; address <= loop.End; address += 2u) {
+            IdleLoopAddresses.set(address);
+        }
+    } else {
+        _idleBackoff.Miss();
+    }
+    return executed + skipped;
+}
+
+void CPU::CollectCode(AddressSet& outCode) const {
+    for (uint16_t address = 0u; address < CHIP8_MEMORY_SIZE; address++) {
+        if (_decodeCache.IsDecoded(address)) {
+            outCode.set(address);
+        }
+    }
+
+    if (_jit != nullptr) {
+        _jit->CollectCode(outCode);
+    }
+}
+
+void CPU::Predecode(const AddressSet& code) {
+    for (uint16_t address = 0u; address < CHIP8_MEMORY_SIZE; address++) {
+        if (code[address]) {
+            FetchDecoded(address);
+        }
+    }
+}
+
+uint32_t CPU::Run(const uint32_t count) {
+    if (!ResumeFromKeyWait()) return 0u;
+
+    if (Recorder != nullptr) {
+        return RunRecorded(count);
+    }
+
+    switch (Engine) {
+        case CpuEngine::Switch: return RunSwitch(count);
+        case CpuEngine::Cached: return RunCached(count);
+        case CpuEngine::Threaded: return RunThreaded(count);
+        case CpuEngine::Jit: return RunJit(count);
+    }
+    return 0u;
+}
+
+uint32_t CPU::RunJit(const uint32_t count) {
+    if (_jit == nullptr) {
+        _jit.reset(new Jit(*this));
+    }
+
+    if (!_jit->IsAvailable()) {
+        return RunThreaded(count);
+    }
+#if CHIP8_PROFILE
+    if (Profile != nullptr) {
+        return RunThreaded(count);
+    }
+#endif
+    return _jit->Run(count);
+}
+
+uint32_t CPU::RunSwitch(const uint32_t count) {
+    return WithQuirkPolicy(_quirks, [&](auto policy) { return RunSwitchWith<decltype(policy)>(count); });
+}
+
+template <typename Policy>
+uint32_t CPU::RunSwitchWith(const uint32_t count) {
+    uint32_t executed = 0u;
+    while (executed < count) {
+        const uint16_t code = ReadNextOpcode();
+        CHIP8_PROFILE_OP(*this, DecodeOp(code), PC - 2u);
+        ExecWith<Policy>(code);
+        executed += 1u;
+
+        if (Halted) break;
+    }
+
+    InstructionCount += executed;
+    return executed;
+}
+
+uint32_t CPU::RunCached(const uint32_t count) {
+    uint32_t executed = 0u;
+    while (executed < count) {
+        const DecodedOpcode& opcode = FetchDecoded(PC);
+        CHIP8_PROFILE_OP(*this, opcode.Op, PC);
+        SkipNextBytes(2);
+
+        if (CanRunFused(opcode, count - executed)) {
+            executed += RunFused(opcode);
+        } else {
+            opcode.Handler(*this, opcode);
+            executed += 1u;
+        }
+
+        if (Halted) break;
+    }
+
+    InstructionCount += executed;
+    return executed;
+}
+
+uint32_t CPU::RunFused(const DecodedOpcode& opcode) {
+    return WithQuirkPolicy(_quirks, [&](auto policy) { return QuirkOps<decltype(policy)>::Fused(*this, opcode); });
+}
+
+uint32_t CPU::RunRecorded(const uint32_t count) {
+    const uint8_t* const memory = _memory->GetPtr(0u);
+
+    uint32_t executed = 0u;
+    while (executed < count) {
+        const uint16_t code = static_cast<uint16_t>((memory[PC & (CHIP8_MEMORY_SIZE - 1u)] << 8) | memory[(PC + 1u) & (CHIP8_MEMORY_SIZE - 1u)]);
+        Recorder->Record(*this, code);
+
+        const DecodedOpcode& opcode = FetchDecoded(PC);
+        CHIP8_PROFILE_OP(*this, opcode.Op, PC);
+        SkipNextBytes(2);
+
+        opcode.Handler(*this, opcode);
+        executed += 1u;
+
+        if (Halted) break;
+    }
+
+    InstructionCount += executed;
+    return executed;
 }
 
 uint16_t CPU::ReadNextOpcode() {
 // read the next opcode
-    const uint8_t byte1 = _memory->Read(PC);
-    const uint8_t byte2 = _memory->Read(PC + 1u);
+    const uint8_t byte1 = _memory->Read(PC & (CHIP8_MEMORY_SIZE - 1u));
+    const uint8_t byte2 = _memory->Read((PC + 1u) & (CHIP8_MEMORY_SIZE - 1u));
 
     SkipNextBytes(2);
 
@@ -34,23 +241,33 @@ uint16_t CPU::ReadNextOpcode() {
 }
 
 void CPU::Exec(const uint16_t code) {
+    WithQuirkPolicy(_quirks, [&](auto policy) { ExecWith<decltype(policy)>(code); });
+}
+
+template <typename Policy>
+void CPU::ExecWith(const uint16_t code) {
     switch (code) {
         case 0x00E0: { // CLS: Clear the display
+            CHIP8_PROFILE_SCOPE(*this, Clear);
             _screen->Clear();
             break;
         }
         case 0x00EE: { // Ret: Return from subroutine
+            if (_stack->SP == 0u) {
+                Fault(TraceReason::StackUnderflow, PC - 2u);
+            }
             PC = _stack->Pop();
             break;
         }
         default: {
             const Opcode opcode = Opcode(code);
-            ExecExtended(opcode);
+            ExecExtended<Policy>(opcode);
             break;
         }
     }
 }
 
+template <typename Policy>
 void CPU::ExecExtended(const Opcode &opcode) {
     switch (opcode.Code & 0xF000) {
         case 0x1000: // [1nnn] JP addr, 1nnn - Jump to location nnn's
@@ -58,6 +275,9 @@ void CPU::ExecExtended(const Opcode &opcode) {
             break;
 
         case 0x2000: // [2nnn] CALL addr, 2nnn - Call subroutine at location nnn
+            if (_stack->SP >= CHIP8_MEMORY_STACK_SIZE) {
+                Fault(TraceReason::StackOverflow, PC - 2u);
+            }
             _stack->Push(PC);
             PC = opcode.NNN();
             break;
@@ -89,7 +309,7 @@ void CPU::ExecExtended(const Opcode &opcode) {
             break;
 
         case 0x8000: // [8xy(0...E)]
-            ExecExtended_8(opcode);
+            ExecExtended_8<Policy>(opcode);
             break;
 
         case 0x9000: // [9xy0] - SNE Vx, Vy - Skit next instruction if Vx != Vy
@@ -102,20 +322,22 @@ void CPU::ExecExtended(const Opcode &opcode) {
             I = opcode.NNN();
             break;
 
-        case 0xB000: // [Bnnn] - JP V0, addr - Jump to location nnn + V0
-            PC = opcode.NNN() + V[0];
+        case 0xB000: // [Bnnn] - JP V0, addr - Jump to location nnn + V0 ([Bxnn] - xnn + Vx with Quirk::JumpUsesVx)
+            PC = opcode.NNN() + V[Policy::JumpUsesVx ? opcode.X() : 0u];
             break;
 
         case 0xC000: // [Cxkk] - RND Vx, byte - Set Vx = random byte AND kk
-            V[opcode.X()] = rand() % 255 & opcode.KK();
+            V[opcode.X()] = Rng.Next() % 255 & opcode.KK();
             break;
 
         case 0xD000: { // [Dxyn] - DRW Vx, Vy, nibble
             const uint8_t Vx = V[opcode.X()];
             const uint8_t Vy = V[opcode.Y()];
-            const uint8_t* spritePtr = _memory->GetPtr(I);
+            uint8_t rows[16];
+            const uint8_t* spritePtr = _memory->GetRange(I, opcode.N(), rows);
 
-            const bool pixelCollision = _screen->DrawSprite(Vx, Vy, spritePtr, opcode.N());
+            CHIP8_PROFILE_SCOPE(*this, DrawSprite);
+            const bool pixelCollision = _screen->DrawSprite<Policy::ClipSprites>(Vx, Vy, spritePtr, opcode.N());
             V[REGISTER_CARRY_FLAG_INDEX] = pixelCollision;
             break;
         }
@@ -136,11 +358,12 @@ void CPU::ExecExtended(const Opcode &opcode) {
             break;
         }
         case 0xF000:
-            ExecExtended_F(opcode);
+            ExecExtended_F<Policy>(opcode);
             break;
     }
 }
 
+template <typename Policy>
 void CPU::ExecExtended_8(const Opcode &opcode) {
     switch (opcode.Code & 0x000F) {
         case 0x0: { // [8xy0] - LD Vx, Vy - Set Vx = Vy
@@ -149,14 +372,17 @@ void CPU::ExecExtended_8(const Opcode &opcode) {
         }
         case 0x1: { // [8xy1] - OR Vx, Vy - Set Vx = Vx OR Vy
             V[opcode.X()] |= V[opcode.Y()];
+            if (Policy::LogicResetsVF) V[REGISTER_CARRY_FLAG_INDEX] = 0u;
             break;
         }
         case 0x2: { // [8xy2] - AND Vx, Vy - Set Vx = Vx AND Vy
             V[opcode.X()] &= V[opcode.Y()];
+            if (Policy::LogicResetsVF) V[REGISTER_CARRY_FLAG_INDEX] = 0u;
             break;
         }
         case 0x3: { // [8xy3] - XOR Vx, Vy - Set Vx = Vx XOR Vy
             V[opcode.X()] ^= V[opcode.Y()];
+            if (Policy::LogicResetsVF) V[REGISTER_CARRY_FLAG_INDEX] = 0u;
             break;
         }
         case 0x4: { // [8xy4] - ADD Vx, Vy - Set Vx = Vx + Vy, set VF = carry
@@ -170,9 +396,10 @@ void CPU::ExecExtended_8(const Opcode &opcode) {
             V[opcode.X()] -= V[opcode.Y()];
             break;
         }
-        case 0x6: { // [8xy6] - SHR Vx {, Vy}
-            V[REGISTER_CARRY_FLAG_INDEX] = V[opcode.X()] & 0x01;
-            V[opcode.X()] /= 2;
+        case 0x6: { // [8xy6] - SHR Vx {, Vy} - shifts Vy into Vx with Quirk::ShiftUsesVy
+            const uint8_t Vy = V[opcode.Y()];
+            V[REGISTER_CARRY_FLAG_INDEX] = (Policy::ShiftUsesVy ? Vy : V[opcode.X()]) & 0x01;
+            V[opcode.X()] = (Policy::ShiftUsesVy ? Vy : V[opcode.X()]) / 2;
             break;
         }
         case 0x7: { // [8xy7] - SUBN Vx, Vy
@@ -180,14 +407,16 @@ void CPU::ExecExtended_8(const Opcode &opcode) {
             V[opcode.X()] = V[opcode.Y()] - V[opcode.X()];
             break;
         }
-        case 0xE: { // [8xyE] - SHL Vx {, Vy}
-            V[REGISTER_CARRY_FLAG_INDEX] = (V[opcode.X()] & 0b1000'0000) >> 7;
-            V[opcode.X()] *= 2;
+        case 0xE: { // [8xyE] - SHL Vx {, Vy} - shifts Vy into Vx with Quirk::ShiftUsesVy
+            const uint8_t Vy = V[opcode.Y()];
+            V[REGISTER_CARRY_FLAG_INDEX] = ((Policy::ShiftUsesVy ? Vy : V[opcode.X()]) & 0b1000'0000) >> 7;
+            V[opcode.X()] = (Policy::ShiftUsesVy ? Vy : V[opcode.X()]) * 2;
             break;
         }
     }
 }
 
+template <typename Policy>
 void CPU::ExecExtended_F(const Opcode &opcode) {
     switch (opcode.Code & 0x00FF) {
         case 0x07: { // [Fx07] - LD Vx, DT - Set Vx = delay timer value
@@ -196,14 +425,8 @@ void CPU::ExecExtended_F(const Opcode &opcode) {
         }
         case 0x0A: { //[Fx0A] - LD Vx, K - Wait for a key press, store the value of the key in Vx
             Halted = true;
-
-            _keyboard->OnKeyDownEvent = [this, opcode](uint8_t vKey) {
-                const uint8_t x = opcode.X();
-                this->V[x] = vKey;
-
-                _keyboard->OnKeyDownEvent = nullptr;
-                Halted = false;
-            };
+            KeyWaitRegister = opcode.X();
+            _keyboard->ClearLatch();
             break;
         }
         case 0x15: { // [Fx15] - LD DT, Vx - Set delay timer = Vx
@@ -237,6 +460,7 @@ void CPU::ExecExtended_F(const Opcode &opcode) {
                 const uint16_t address = I + i;
                 _memory->Write(address, V[i]);
             }
+            if (Policy::LoadStoreIncrementsI) I += opcode.X() + 1u;
             break;
         }
         case 0x65: { // [Fx65] - LD Vx, [I] - Read Registers V0 through Vx from Memory starting at location I
@@ -244,6 +468,7 @@ void CPU::ExecExtended_F(const Opcode &opcode) {
                 const uint16_t address = I + i;
                 V[i] = _memory->Read(address);
             }
+            if (Policy::LoadStoreIncrementsI) I += opcode.X() + 1u;
             break;
         }
     }
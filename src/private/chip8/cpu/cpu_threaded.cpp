@@ -0,0 +1,121 @@
+#include "chip8/cpu/cpu.h"
+#include "chip8/cpu/ops.h"
+#include "chip8/cpu/profiler.h"
+
+// Computed goto ("labels as values") is a GNU extension; other compilers run
+// the same decoded opcodes through the handler loop of the cached engine.
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_COMPUTED_GOTO 1
+#else
+#define CHIP8_COMPUTED_GOTO 0
+#endif
+
+uint32_t CPU::RunThreaded(const uint32_t count) {
+#if CHIP8_COMPUTED_GOTO
+    return WithQuirkPolicy(_quirks, [&](auto policy) { return RunThreadedWith<decltype(policy)>(count); });
+#else
+    return RunCached(count);
+#endif
+}
+
+#if CHIP8_COMPUTED_GOTO
+template <typename Policy>
+uint32_t CPU::RunThreadedWith(const uint32_t count) {
+    static void* const labels[] = {
+#define CHIP8_OPCODE_LABEL(name) &&op_##name,
+        CHIP8_OPCODE_LIST(CHIP8_OPCODE_LABEL)
+#undef CHIP8_OPCODE_LABEL
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == static_cast<size_t>(OpId::Count),
+                  "Every OpId needs a label");
+
+    uint32_t executed = 0u;
+    const DecodedOpcode* opcode = nullptr;
+
+    // every handler ends with its own copy of the dispatch, so each one gets
+    // its own indirect branch and its own branch predictor history
+#define DISPATCH()                                           \
+    if (executed == count) goto done;                        \
+    opcode = &FetchDecoded(PC);                              \
+    CHIP8_PROFILE_OP(*this, opcode->Op, PC);                 \
+    PC += 2u;                                                \
+    executed += 1u;                                          \
+    goto *labels[static_cast<size_t>(opcode->Op)]
+
+#define OPCODE(name)                                         \
+    op_##name:                                               \
+        QuirkOps<Policy>::name(*this, *opcode);              \
+        DISPATCH();
+
+    // an opcode that may start a superinstruction, run as a whole when the
+    // rest of it fits in the count
+#define FUSABLE_OPCODE(name, fused)                          \
+    op_##name:                                               \
+        if (CanRunFused(*opcode, count - executed + 1u)) {   \
+            executed += QuirkOps<Policy>::fused(*this, *opcode) - 1u; \
+        } else {                                             \
+            QuirkOps<Policy>::name(*this, *opcode);          \
+        }                                                    \
+        DISPATCH();
+
+    DISPATCH();
+
+    OPCODE(Nop)
+    OPCODE(Cls)
+    OPCODE(Ret)
+    OPCODE(Jp)
+    OPCODE(Call)
+    OPCODE(SeByte)
+    OPCODE(SneByte)
+    OPCODE(SeReg)
+    FUSABLE_OPCODE(LdByte, LdByteLdByte)
+    FUSABLE_OPCODE(AddByte, AddByteSeByteJp)
+    OPCODE(LdReg)
+    OPCODE(Or)
+    OPCODE(And)
+    OPCODE(Xor)
+    OPCODE(AddReg)
+    OPCODE(Sub)
+    OPCODE(Shr)
+    OPCODE(Subn)
+    OPCODE(Shl)
+    OPCODE(SneReg)
+    FUSABLE_OPCODE(LdI, LdIDrw)
+    OPCODE(JpV0)
+    OPCODE(Rnd)
+    OPCODE(Drw)
+    OPCODE(Skp)
+    OPCODE(Sknp)
+    FUSABLE_OPCODE(LdVxDt, LdVxDtSeByteJp)
+    OPCODE(LdDtVx)
+    OPCODE(LdStVx)
+    OPCODE(AddIVx)
+    OPCODE(LdFVx)
+    OPCODE(LdIVx)
+    OPCODE(LdVxI)
+
+    // the only opcode that can halt the CPU
+    op_LdVxK:
+        QuirkOps<Policy>::LdVxK(*this, *opcode);
+        goto done;
+
+    // fused with Fy65, it runs whatever its digits wrote over Fy65, which
+    // may be Fx0A
+    op_LdBVx:
+        if (CanRunFused(*opcode, count - executed + 1u)) {
+            executed += QuirkOps<Policy>::LdBVxLdVxI(*this, *opcode) - 1u;
+            if (Halted) goto done;
+        } else {
+            QuirkOps<Policy>::LdBVx(*this, *opcode);
+        }
+        DISPATCH();
+
+#undef FUSABLE_OPCODE
+#undef OPCODE
+#undef DISPATCH
+
+done:
+    InstructionCount += executed;
+    return executed;
+}
+#endif
@@ -0,0 +1,22 @@
+#include "chip8/cpu/decode_cache.h"
+
+static_assert((CHIP8_MEMORY_SIZE & (CHIP8_MEMORY_SIZE - 1u)) == 0u, "Memory size must be a power of two");
+
+void DecodeCache::Invalidate(const uint16_t address, const size_t size) {
+    // the opcode starting one byte before the range also reads its first
+    // byte, and a fused sequence starting before that may read it too.
+    // Only the handler is reset, so an opcode overwriting itself can still
+    // read its own operands while it finishes executing.
+    const size_t reach = MaxFusedLength * 2u - 1u;
+    const size_t first = (address > reach) ? address - reach : 0u;
+    const size_t last = address + size;
+    for (size_t i = first; i < last && i < CHIP8_MEMORY_SIZE; i++) {
+        _entries[i].Handler = nullptr;
+    }
+}
+
+void DecodeCache::Clear() {
+    for (DecodedOpcode& entry : _entries) {
+        entry.Handler = nullptr;
+    }
+}
@@ -0,0 +1,174 @@
+#include "chip8/cpu/cpu.h"
+#include "chip8/cpu/ops.h"
+
+namespace {
+    // Tables are indexed by a single nibble or byte of the opcode and built at
+    // compile time; keeping them small stays well inside the constexpr
+    // evaluation limits of every compiler we build with.
+    struct OpTable {
+        OpId Ops[256];
+    };
+
+    constexpr OpTable BuildPrimaryTable() {
+        OpTable table = {};
+        table.Ops[0x1] = OpId::Jp;
+        table.Ops[0x2] = OpId::Call;
+        table.Ops[0x3] = OpId::SeByte;
+        table.Ops[0x4] = OpId::SneByte;
+        table.Ops[0x5] = OpId::SeReg;
+        table.Ops[0x6] = OpId::LdByte;
+        table.Ops[0x7] = OpId::AddByte;
+        table.Ops[0x9] = OpId::SneReg;
+        table.Ops[0xA] = OpId::LdI;
+        table.Ops[0xB] = OpId::JpV0;
+        table.Ops[0xC] = OpId::Rnd;
+        table.Ops[0xD] = OpId::Drw;
+        return table;
+    }
+
+    // [8xy(0...E)] by the lowest nibble
+    constexpr OpTable BuildArithmeticTable() {
+        OpTable table = {};
+        table.Ops[0x0] = OpId::LdReg;
+        table.Ops[0x1] = OpId::Or;
+        table.Ops[0x2] = OpId::And;
+        table.Ops[0x3] = OpId::Xor;
+        table.Ops[0x4] = OpId::AddReg;
+        table.Ops[0x5] = OpId::Sub;
+        table.Ops[0x6] = OpId::Shr;
+        table.Ops[0x7] = OpId::Subn;
+        table.Ops[0xE] = OpId::Shl;
+        return table;
+    }
+
+    // [Exkk] by the lowest byte
+    constexpr OpTable BuildKeyboardTable() {
+        OpTable table = {};
+        table.Ops[0x9E] = OpId::Skp;
+        table.Ops[0xA1] = OpId::Sknp;
+        return table;
+    }
+
+    // [Fxkk] by the lowest byte
+    constexpr OpTable BuildMiscTable() {
+        OpTable table = {};
+        table.Ops[0x07] = OpId::LdVxDt;
+        table.Ops[0x0A] = OpId::LdVxK;
+        table.Ops[0x15] = OpId::LdDtVx;
+        table.Ops[0x18] = OpId::LdStVx;
+        table.Ops[0x1E] = OpId::AddIVx;
+        table.Ops[0x29] = OpId::LdFVx;
+        table.Ops[0x33] = OpId::LdBVx;
+        table.Ops[0x55] = OpId::LdIVx;
+        table.Ops[0x65] = OpId::LdVxI;
+        return table;
+    }
+
+    constexpr OpTable PrimaryTable = BuildPrimaryTable();
+    constexpr OpTable ArithmeticTable = BuildArithmeticTable();
+    constexpr OpTable KeyboardTable = BuildKeyboardTable();
+    constexpr OpTable MiscTable = BuildMiscTable();
+}
+
+OpId CPU::DecodeOp(const uint16_t code) {
+    switch (code >> 12) {
+        case 0x0:
+            if (code == 0x00E0) return OpId::Cls;
+            if (code == 0x00EE) return OpId::Ret;
+            return OpId::Nop;
+        case 0x8: return ArithmeticTable.Ops[code & 0x000F];
+        case 0xE: return KeyboardTable.Ops[code & 0x00FF];
+        case 0xF: return MiscTable.Ops[code & 0x00FF];
+        default: return PrimaryTable.Ops[code >> 12];
+    }
+}
+
+DecodedOpcode CPU::Decode(const uint16_t code, const uint8_t quirks) {
+    return Decode(code, DecodeOp(code), quirks);
+}
+
+DecodedOpcode CPU::Decode(const uint16_t code, const OpId op, const uint8_t quirks) {
+    const OpcodeHandler* const handlers = WithQuirkPolicy(quirks, [](auto policy) -> const OpcodeHandler* {
+        using Policy = decltype(policy);
+        static constexpr OpcodeHandler table[] = {
+#define CHIP8_OPCODE_HANDLER(name) QuirkOps<Policy>::name,
+            CHIP8_OPCODE_LIST(CHIP8_OPCODE_HANDLER)
+#undef CHIP8_OPCODE_HANDLER
+        };
+        static_assert(sizeof(table) / sizeof(table[0]) == static_cast<size_t>(OpId::Count),
+                      "Every OpId needs a handler");
+        return table;
+    });
+
+    const Opcode opcode = Opcode(code);
+
+    DecodedOpcode decoded = {};
+    decoded.Op = op;
+    decoded.Handler = handlers[static_cast<size_t>(decoded.Op)];
+    decoded.NNN = opcode.NNN();
+    decoded.X = opcode.X();
+    decoded.Y = opcode.Y();
+    decoded.N = opcode.N();
+    decoded.KK = opcode.KK();
+    return decoded;
+}
+
+void CPU::DecodeAt(const uint16_t address, DecodedOpcode& outEntry) {
+    const uint8_t byte1 = _memory->Read(address & (CHIP8_MEMORY_SIZE - 1u));
+    const uint8_t byte2 = _memory->Read((address + 1u) & (CHIP8_MEMORY_SIZE - 1u));
+    outEntry = Decode((byte1 << 8) | byte2, _quirks);
+    Fuse(address, outEntry);
+}
+
+void CPU::Fuse(const uint16_t address, DecodedOpcode& entry) const {
+    entry.FusedLength = 0u;
+
+    // a sequence wrapping around the end of memory is left alone, writes
+    // at the start of memory don't invalidate entries at its end
+    const size_t start = address & (CHIP8_MEMORY_SIZE - 1u);
+    if (start + DecodeCache::MaxFusedLength * 2u > CHIP8_MEMORY_SIZE) return;
+
+    const uint8_t* const memory = _memory->GetPtr(0u);
+    const uint16_t next = static_cast<uint16_t>((memory[start + 2u] << 8) | memory[start + 3u]);
+    const uint16_t third = static_cast<uint16_t>((memory[start + 4u] << 8) | memory[start + 5u]);
+    const Opcode second = Opcode(next);
+
+    switch (entry.Op) {
+        case OpId::LdByte: // [6xkk][6ykk]
+            if ((next & 0xF000) != 0x6000) return;
+            entry.Y = second.X();
+            entry.N = second.KK();
+            entry.FusedLength = 2u;
+            return;
+
+        case OpId::LdI: // [Annn][Dxyn]
+            if ((next & 0xF000) != 0xD000) return;
+            entry.X = second.X();
+            entry.Y = second.Y();
+            entry.N = second.N();
+            entry.FusedLength = 2u;
+            return;
+
+        case OpId::LdVxDt: // [Fx07][3x00][1nnn]
+            if (next != (0x3000 | (entry.X << 8)) || (third & 0xF000) != 0x1000) return;
+            entry.NNN = third & 0x0FFF;
+            entry.FusedLength = 3u;
+            return;
+
+        case OpId::LdBVx: // [Fx33][Fy65]
+            if ((next & 0xF0FF) != 0xF065) return;
+            entry.Y = second.X();
+            entry.FusedLength = 2u;
+            return;
+
+        case OpId::AddByte: // [7xkk][3xkk][1nnn]
+            if ((next & 0xFF00) != (0x3000 | (entry.X << 8)) || (third & 0xF000) != 0x1000) return;
+            entry.N = second.KK();
+            entry.NNN = third & 0x0FFF;
+            entry.FusedLength = 3u;
+            return;
+
+        default:
+            return;
+    }
+}
@@ -0,0 +1,179 @@
+#include "chip8/cpu/flight_recorder.h"
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "chip8/state/byte_stream.h"
+
+namespace {
+    // "C8FR", version, reason, fault address, recorded count, registers,
+    // stack, entry count, entries
+    const uint8_t Magic[4] = {'C', '8', 'F', 'R'};
+    constexpr size_t HeaderSize = sizeof(Magic) + 2u + 1u + 2u + 8u
+            + 2u + 2u + 3u + CHIP8_DATA_REGISTERS_SIZE + 2u * CHIP8_MEMORY_STACK_SIZE
+            + 4u;
+    constexpr size_t EntrySize = 2u + 2u + 2u + 1u + 1u + 4u;
+
+    const char* const ReasonNames[] = {
+            "on demand",
+            "stack overflow",
+            "stack underflow",
+            "memory out of range",
+            "key wait",
+    };
+    static_assert(sizeof(ReasonNames) / sizeof(ReasonNames[0]) == static_cast<size_t>(TraceReason::Count),
+                  "Every TraceReason needs a name");
+}
+
+void TraceDump::Serialize(std::vector<uint8_t>& outBlob) const {
+    outBlob.reserve(outBlob.size() + HeaderSize + Entries.size() * EntrySize);
+
+    ByteWriter w {outBlob};
+    w.Bytes(Magic, sizeof(Magic));
+    w.U16(Version);
+    w.U8(static_cast<uint8_t>(Reason));
+    w.U16(FaultAddress);
+    w.U64(RecordedCount);
+
+    w.U16(PC);
+    w.U16(I);
+    w.U8(SP);
+    w.U8(Delay);
+    w.U8(Sound);
+    w.Bytes(V, sizeof(V));
+    for (const uint16_t entry : Stack) {
+        w.U16(entry);
+    }
+
+    w.U32(static_cast<uint32_t>(Entries.size()));
+    for (const TraceEntry& entry : Entries) {
+        w.U16(entry.PC);
+        w.U16(entry.Opcode);
+        w.U16(entry.I);
+        w.U8(entry.SP);
+        w.U8(entry.Delay);
+        w.U32(entry.Digest);
+    }
+}
+
+bool TraceDump::Deserialize(const uint8_t* blob, const size_t size) {
+    if (blob == nullptr || size < HeaderSize) return false;
+    if (memcmp(blob, Magic, sizeof(Magic)) != 0) return false;
+
+    ByteReader r {blob + sizeof(Magic)};
+    if (r.U16() != Version) return false;
+
+    TraceDump dump;
+    const uint8_t reason = r.U8();
+    if (reason >= static_cast<uint8_t>(TraceReason::Count)) return false;
+    dump.Reason = static_cast<TraceReason>(reason);
+    dump.FaultAddress = r.U16();
+    dump.RecordedCount = r.U64();
+
+    dump.PC = r.U16();
+    dump.I = r.U16();
+    dump.SP = r.U8();
+    dump.Delay = r.U8();
+    dump.Sound = r.U8();
+    r.Bytes(dump.V, sizeof(dump.V));
+    for (uint16_t& entry : dump.Stack) {
+        entry = r.U16();
+    }
+
+    const size_t entryCount = r.U32();
+    if (entryCount * EntrySize != size - HeaderSize) return false;
+
+    dump.Entries.resize(entryCount);
+    for (TraceEntry& entry : dump.Entries) {
+        entry.PC = r.U16();
+        entry.Opcode = r.U16();
+        entry.I = r.U16();
+        entry.SP = r.U8();
+        entry.Delay = r.U8();
+        entry.Digest = r.U32();
+    }
+
+    *this = std::move(dump);
+    return true;
+}
+
+bool TraceDump::SaveToFile(const char* path) const {
+    std::vector<uint8_t> blob;
+    Serialize(blob);
+
+    std::ofstream stream(path, std::ios_base::binary);
+    if (!stream.good()) {
+        return false;
+    }
+    stream.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+    return stream.good();
+}
+
+bool TraceDump::LoadFromFile(const char* path) {
+    std::ifstream stream(path, std::ios_base::binary);
+    if (!stream.good()) {
+        return false;
+    }
+
+    const std::vector<uint8_t> blob((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    return Deserialize(blob.data(), blob.size());
+}
+
+const char* TraceDump::GetReasonName(const TraceReason reason) {
+    const size_t index = static_cast<size_t>(reason);
+    return (index < static_cast<size_t>(TraceReason::Count)) ? ReasonNames[index] : "?";
+}
+
+FlightRecorder::FlightRecorder(const size_t capacity) {
+    assert(capacity > 0u);
+
+    size_t size = 1u;
+    while (size < capacity) {
+        size <<= 1u;
+    }
+    _entries.resize(size);
+    _mask = size - 1u;
+}
+
+void FlightRecorder::Capture(const CPU& cpu, const TraceReason reason, const uint16_t faultAddress, TraceDump& outDump) const {
+    outDump.Reason = reason;
+    outDump.FaultAddress = faultAddress;
+    outDump.RecordedCount = _recorded;
+
+    outDump.PC = cpu.PC;
+    outDump.I = cpu.I;
+    outDump.SP = cpu._stack->SP;
+    outDump.Delay = cpu.Delay;
+    outDump.Sound = cpu.Sound;
+    memcpy(outDump.V, cpu.V, sizeof(outDump.V));
+    memcpy(outDump.Stack, cpu._stack->stack, sizeof(outDump.Stack));
+
+    // the ring, oldest entry first
+    const size_t count = (_recorded < _entries.size()) ? static_cast<size_t>(_recorded) : _entries.size();
+    outDump.Entries.resize(count);
+    for (size_t i = 0u; i < count; i++) {
+        outDump.Entries[i] = _entries[static_cast<size_t>(_recorded - count + i) & _mask];
+    }
+}
+
+void FlightRecorder::OnFault(const CPU& cpu, const TraceReason reason, const uint16_t faultAddress) {
+    FaultCount += 1u;
+    if (FaultCount > 1u) return;
+
+    Capture(cpu, reason, faultAddress, LastFault);
+    if (AutoDumpPath == nullptr) return;
+
+    if (LastFault.SaveToFile(AutoDumpPath)) {
+        std::cerr << "[FlightRecorder] " << TraceDump::GetReasonName(reason) << ", trace written to " << AutoDumpPath << std::endl;
+    } else {
+        std::cerr << "[FlightRecorder] " << TraceDump::GetReasonName(reason) << ", failed to write " << AutoDumpPath << std::endl;
+    }
+}
+
+void FlightRecorder::Clear() {
+    _recorded = 0u;
+    FaultCount = 0u;
+    LastFault = TraceDump {};
+}
@@ -0,0 +1,67 @@
+#include "chip8/cpu/idle_loop.h"
+
+namespace {
+    constexpr uint16_t AddressMask = CHIP8_MEMORY_SIZE - 1u;
+
+    uint16_t ReadOpcode(const uint8_t* memory, const uint16_t address) {
+        return static_cast<uint16_t>((memory[address & AddressMask] << 8) | memory[(address + 1u) & AddressMask]);
+    }
+}
+
+bool IdleLoop::IsSideEffectFree(const uint16_t code) {
+    switch (code & 0xF000) {
+        case 0x3000: // [3xkk] SE Vx, byte
+        case 0x4000: // [4xkk] SNE Vx, byte
+        case 0x6000: // [6xkk] LD Vx, byte
+        case 0x7000: // [7xkk] ADD Vx, byte
+        case 0xA000: // [Annn] LD I, addr
+            return true;
+        case 0x5000: // [5xy0] SE Vx, Vy
+        case 0x9000: // [9xy0] SNE Vx, Vy
+            return (code & 0x000F) == 0x0;
+        case 0x8000: // [8xy0] - [8xy7], [8xyE]
+            return (code & 0x000F) <= 0x7 || (code & 0x000F) == 0xE;
+        case 0xE000: // [Ex9E] SKP Vx, [ExA1] SKNP Vx
+            return (code & 0x00FF) == 0x9E || (code & 0x00FF) == 0xA1;
+        case 0xF000:
+            switch (code & 0x00FF) {
+                case 0x07: // [Fx07] LD Vx, DT
+                case 0x1E: // [Fx1E] ADD I, Vx
+                case 0x29: // [Fx29] LD F, Vx
+                case 0x65: // [Fx65] LD Vx, [I]
+                    return true;
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+bool IdleLoop::Find(const uint8_t* memory, const uint16_t pc, IdleLoop& outLoop) {
+    // look for the closing jump at or after pc
+    for (uint32_t i = 0u; i < MaxLength; i++) {
+        const uint32_t address = pc + 2u * i;
+        if (address >= CHIP8_MEMORY_SIZE) return false;
+
+        const uint16_t code = ReadOpcode(memory, static_cast<uint16_t>(address));
+        if ((code & 0xF000) != 0x1000) {
+            if (!IsSideEffectFree(code)) return false;
+            continue;
+        }
+
+        const uint16_t top = code & 0x0FFF;
+        if (top > pc || ((pc - top) & 1u) != 0u) return false;
+        if ((address - top) / 2u + 1u > MaxLength) return false;
+
+        // the opcodes from pc on were checked on the way here
+        for (uint16_t before = top; before < pc; before += 2u) {
+            if (!IsSideEffectFree(ReadOpcode(memory, before))) return false;
+        }
+
+        outLoop.Top = top;
+        outLoop.End = static_cast<uint16_t>(address);
+        return true;
+    }
+    return false;
+}
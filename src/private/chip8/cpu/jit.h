@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "chip8/constants.h"
+#include "chip8/cpu/cpu.h"
+
+struct ByteReader;
+struct ByteWriter;
+
+// Translates straight-line runs of CHIP-8 opcodes (basic blocks) into native
+// x86-64 code. Registers stay in the CPU object and are addressed relative to
+// it; opcodes touching the screen, keyboard, stack or memory call back into
+// the interpreter's opcode handlers. Blocks end at jumps, calls, returns and at opcodes that write
+// memory, so a block never runs code it has just overwritten. A skip leaves
+// the block through a side exit when the opcode it skips is one of those, and
+// ends the block when it can't be translated.
+class Jit {
+public:
+    explicit Jit(CPU& cpu);
+    ~Jit();
+
+    // false when the host isn't x86-64 or executable memory can't be mapped
+    bool IsAvailable() const { return _code != nullptr; }
+
+    // Executes up to `count` opcodes, stopping early if the CPU halts.
+    // Returns the number of opcodes executed.
+    uint32_t Run(uint32_t count);
+
+    void Invalidate(uint16_t address, size_t size);
+
+    // Adds the address of every opcode of the translated blocks
+    void CollectCode(AddressSet& outCode) const;
+
+    // Writes where the translated blocks start and end to a CodeCache blob,
+    // each with the memory it was translated from. No native code is saved.
+    void Save(ByteWriter& w) const;
+    // Reads what Save wrote, up to `end`, and translates again the blocks
+    // whose memory still matches. Returns false on a malformed blob.
+    bool Load(ByteReader& r, const uint8_t* end, uint32_t& outBlocks);
+
+private:
+    // runs at most `budget` opcodes (at least one) and returns how many ran
+    using BlockFn = uint32_t (*)(CPU* cpu, uint32_t budget);
+
+    struct Block {
+        BlockFn Code = nullptr; // nullptr when the first opcode is left to the interpreter
+        uint16_t End = 0u;      // address right after the last translated opcode
+        bool Valid = false;     // false until the address has been translated
+    };
+
+    struct Shadow;
+
+    const Block& GetBlock(uint16_t address);
+    Block Translate(uint16_t address);
+    void Flush();
+    // Flips the code buffer between writable and executable. On failure the
+    // buffer is released and IsAvailable() turns false.
+    bool SetWritable(bool writable);
+    void CaptureLockstep();
+    void CheckLockstep(uint16_t startAddress, uint32_t length);
+
+    CPU& _cpu;
+
+    // where the registers live, relative to the CPU object
+    int32_t _offsetV = 0;
+    int32_t _offsetI = 0;
+    int32_t _offsetPC = 0;
+    int32_t _offsetDelay = 0;
+    int32_t _offsetSound = 0;
+
+    uint8_t* _code = nullptr;
+    size_t _codeUsed = 0u;
+    bool _writable = false;
+
+    Block _blocks[CHIP8_MEMORY_SIZE] {};
+    // number of blocks translated from each byte of memory
+    uint8_t _coverage[CHIP8_MEMORY_SIZE] {};
+    // operands passed to the handlers called from translated code
+    DecodedOpcode _operands[CHIP8_MEMORY_SIZE] {};
+
+    std::unique_ptr<Shadow> _shadow;
+};
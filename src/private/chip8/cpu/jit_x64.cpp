@@ -0,0 +1,801 @@
+#include "chip8/cpu/jit.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "chip8/cpu/opcode.h"
+#include "chip8/state/byte_stream.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_JIT_X64 1
+#else
+#define CHIP8_JIT_X64 0
+#endif
+
+#if CHIP8_JIT_X64
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+namespace {
+    constexpr size_t CodeCapacity = 1u << 20;
+    // worst case for a block of MaxBlockLength opcodes, with room to spare
+    constexpr size_t MaxBlockCodeSize = 4096u;
+    constexpr uint32_t MaxBlockLength = 32u;
+
+    // Mapped writable; ProtectExecutable flips it to executable once written
+    uint8_t* AllocateExecutable(const size_t size) {
+#if !CHIP8_JIT_X64
+        (void)size;
+        return nullptr;
+#elif defined(_WIN32)
+        return static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return (memory == MAP_FAILED) ? nullptr : static_cast<uint8_t*>(memory);
+#endif
+    }
+
+    // Makes the code either executable or writable, never both, so hosts
+    // refusing writable and executable memory still run the Jit
+    bool ProtectExecutable(uint8_t* memory, const size_t size, const bool executable) {
+#if !CHIP8_JIT_X64
+        (void)memory;
+        (void)size;
+        (void)executable;
+        return false;
+#elif defined(_WIN32)
+        DWORD previous = 0;
+        if (!VirtualProtect(memory, size, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &previous)) return false;
+        if (executable) FlushInstructionCache(GetCurrentProcess(), memory, size);
+        return true;
+#else
+        return mprotect(memory, size, executable ? (PROT_READ | PROT_EXEC) : (PROT_READ | PROT_WRITE)) == 0;
+#endif
+    }
+
+    void FreeExecutable(uint8_t* memory, const size_t size) {
+#if !CHIP8_JIT_X64
+        (void)memory;
+        (void)size;
+#elif defined(_WIN32)
+        (void)size;
+        VirtualFree(memory, 0, MEM_RELEASE);
+#else
+        munmap(memory, size);
+#endif
+    }
+
+    // Condition codes, as used by SETcc, CMOVcc and Jcc
+    enum Condition : uint8_t {
+        Carry = 0x2,
+        Equal = 0x4,
+        NotEqual = 0x5,
+        Above = 0x7,
+    };
+
+    // ALU opcodes of the "op r/m8, r8" and "op r8, r/m8" forms
+    enum AluOp : uint8_t {
+        OrMemAl = 0x08,
+        AndMemAl = 0x20,
+        XorMemAl = 0x30,
+        AddAlMem = 0x02,
+        SubAlMem = 0x2A,
+        CmpAlMem = 0x3A,
+    };
+
+    // Minimal x86-64 encoder. For the whole block the CPU object is kept in
+    // rbx, the number of opcodes skipped so far in r12d and the remaining
+    // budget in r13d; eax and ecx are scratch registers.
+    class Emitter {
+        uint8_t* _out;
+        size_t _size = 0u;
+
+        void ModRmRbx(const uint8_t reg, const int32_t disp) {
+            Byte(0x80 | (reg << 3) | 0x03); // [rbx + disp32]
+            Dword(static_cast<uint32_t>(disp));
+        }
+
+    public:
+        explicit Emitter(uint8_t* out) : _out(out) { }
+
+        size_t Size() const { return _size; }
+
+        void Byte(const uint8_t value) { _out[_size++] = value; }
+        void Word(const uint16_t value) { memcpy(&_out[_size], &value, sizeof(value)); _size += sizeof(value); }
+        void Dword(const uint32_t value) { memcpy(&_out[_size], &value, sizeof(value)); _size += sizeof(value); }
+        void Qword(const uint64_t value) { memcpy(&_out[_size], &value, sizeof(value)); _size += sizeof(value); }
+
+        void Prologue() {
+            Byte(0x53);                                     // push rbx
+            Byte(0x41); Byte(0x54);                         // push r12
+            Byte(0x41); Byte(0x55);                         // push r13
+#if defined(_WIN32)
+            Byte(0x48); Byte(0x83); Byte(0xEC); Byte(0x20); // sub rsp, 32 (shadow space)
+            Byte(0x48); Byte(0x89); Byte(0xCB);             // mov rbx, rcx
+            Byte(0x41); Byte(0x89); Byte(0xD5);             // mov r13d, edx
+#else
+            Byte(0x48); Byte(0x89); Byte(0xFB);             // mov rbx, rdi
+            Byte(0x41); Byte(0x89); Byte(0xF5);             // mov r13d, esi
+#endif
+            Byte(0x45); Byte(0x31); Byte(0xE4);             // xor r12d, r12d
+        }
+
+        // returns `length` minus the opcodes skipped on the way here
+        void Return(const uint32_t length) {
+            MovEaxImm(length);
+            Byte(0x44); Byte(0x29); Byte(0xE0);             // sub eax, r12d
+#if defined(_WIN32)
+            Byte(0x48); Byte(0x83); Byte(0xC4); Byte(0x20); // add rsp, 32
+#endif
+            Byte(0x41); Byte(0x5D);                         // pop r13
+            Byte(0x41); Byte(0x5C);                         // pop r12
+            Byte(0x5B);                                     // pop rbx
+            Byte(0xC3);                                     // ret
+        }
+
+        void IncSkipped() { Byte(0x41); Byte(0xFF); Byte(0xC4); } // inc r12d
+
+        // takes one opcode from the budget; jumps to the returned position
+        // (patched with Bind()) when the budget was already used up
+        size_t SpendBudget() {
+            Byte(0x41); Byte(0x83); Byte(0xED); Byte(0x01); // sub r13d, 1
+            return Jcc(Carry);
+        }
+
+        // forward jumps; the returned position is patched with Bind()
+        size_t Jcc(const Condition condition) { Byte(0x0F); Byte(0x80 | condition); Dword(0u); return _size - 4u; }
+        size_t Jmp() { Byte(0xE9); Dword(0u); return _size - 4u; }
+        void Bind(const size_t position) {
+            const uint32_t rel = static_cast<uint32_t>(_size - (position + 4u));
+            memcpy(&_out[position], &rel, sizeof(rel));
+        }
+
+        // byte [rbx + disp] = imm8 / += imm8 / cmp imm8
+        void MovMemImm8(const int32_t disp, const uint8_t imm) { Byte(0xC6); ModRmRbx(0, disp); Byte(imm); }
+        void AddMemImm8(const int32_t disp, const uint8_t imm) { Byte(0x80); ModRmRbx(0, disp); Byte(imm); }
+        void CmpMemImm8(const int32_t disp, const uint8_t imm) { Byte(0x80); ModRmRbx(7, disp); Byte(imm); }
+
+        void LoadAl(const int32_t disp) { Byte(0x8A); ModRmRbx(0, disp); }  // mov al, [rbx + disp]
+        void StoreAl(const int32_t disp) { Byte(0x88); ModRmRbx(0, disp); } // mov [rbx + disp], al
+        void StoreCl(const int32_t disp) { Byte(0x88); ModRmRbx(1, disp); } // mov [rbx + disp], cl
+
+        void Alu(const AluOp op, const int32_t disp) { Byte(op); ModRmRbx(0, disp); }
+
+        void SetCl(const Condition condition) { Byte(0x0F); Byte(0x90 | condition); Byte(0xC1); } // setcc cl
+        void AndAlImm(const uint8_t imm) { Byte(0x24); Byte(imm); }              // and al, imm8
+        void ShrAlImm(const uint8_t imm) { Byte(0xC0); Byte(0xE8); Byte(imm); }  // shr al, imm8
+        void ShrMem1(const int32_t disp) { Byte(0xD0); ModRmRbx(5, disp); }      // shr byte [rbx + disp], 1
+        void ShlMem1(const int32_t disp) { Byte(0xD0); ModRmRbx(4, disp); }      // shl byte [rbx + disp], 1
+        void MovClAl() { Byte(0x88); Byte(0xC1); }                               // mov cl, al
+        void ShrCl1() { Byte(0xD0); Byte(0xE9); }                                // shr cl, 1
+        void ShlCl1() { Byte(0xD0); Byte(0xE1); }                                // shl cl, 1
+
+        void MovMemImm16(const int32_t disp, const uint16_t imm) { Byte(0x66); Byte(0xC7); ModRmRbx(0, disp); Word(imm); }
+        void CmpMemImm16(const int32_t disp, const uint16_t imm) { Byte(0x66); Byte(0x81); ModRmRbx(7, disp); Word(imm); }
+        void MovzxEaxMem8(const int32_t disp) { Byte(0x0F); Byte(0xB6); ModRmRbx(0, disp); } // movzx eax, byte [rbx + disp]
+        void AddMemAx(const int32_t disp) { Byte(0x66); Byte(0x01); ModRmRbx(0, disp); }     // add [rbx + disp], ax
+        void StoreAx(const int32_t disp) { Byte(0x66); Byte(0x89); ModRmRbx(0, disp); }      // mov [rbx + disp], ax
+        void LeaEaxTimes5() { Byte(0x8D); Byte(0x04); Byte(0x80); }                         // lea eax, [rax + rax * 4]
+        void AddEaxImm(const uint32_t imm) { Byte(0x05); Dword(imm); }                     // add eax, imm32
+        void MovEaxImm(const uint32_t imm) { Byte(0xB8); Dword(imm); }                     // mov eax, imm32
+        void MovEcxImm(const uint32_t imm) { Byte(0xB9); Dword(imm); }                     // mov ecx, imm32
+        void CmovEaxEcx(const Condition condition) { Byte(0x0F); Byte(0x40 | condition); Byte(0xC1); } // cmovcc eax, ecx
+
+        // handler(cpu, operands)
+        void CallHandler(const OpcodeHandler handler, const DecodedOpcode* operands) {
+#if defined(_WIN32)
+            Byte(0x48); Byte(0x89); Byte(0xD9);         // mov rcx, rbx
+            Byte(0x48); Byte(0xBA);                     // mov rdx, operands
+#else
+            Byte(0x48); Byte(0x89); Byte(0xDF);         // mov rdi, rbx
+            Byte(0x48); Byte(0xBE);                     // mov rsi, operands
+#endif
+            Qword(reinterpret_cast<uint64_t>(operands));
+            Byte(0x48); Byte(0xB8);                     // mov rax, handler
+            Qword(reinterpret_cast<uint64_t>(handler));
+            Byte(0xFF); Byte(0xD0);                     // call rax
+        }
+    };
+
+    enum class OpKind {
+        Straight,     // falls through to the next opcode
+        Exit,         // sets PC itself and must end the block
+        Skip,         // may skip the next opcode
+        Interpreted,  // left to the interpreter
+    };
+
+    OpKind Classify(const uint16_t code) {
+        switch (code & 0xF000) {
+            case 0x0000: return (code == 0x00EE) ? OpKind::Exit : OpKind::Straight;
+            case 0x1000:
+            case 0x2000:
+            case 0xB000: return OpKind::Exit;
+            case 0x3000:
+            case 0x4000:
+            case 0x5000:
+            case 0x9000: return OpKind::Skip;
+            case 0xE000:
+                switch (code & 0x00FF) {
+                    case 0x9E:
+                    case 0xA1: return OpKind::Skip;
+                    default: return OpKind::Straight;
+                }
+            case 0xF000:
+                switch (code & 0x00FF) {
+                    case 0x0A: // halts the CPU
+                    case 0x33: // writes memory
+                    case 0x55: // writes memory
+                        return OpKind::Exit;
+                    default: return OpKind::Straight;
+                }
+            default: return OpKind::Straight;
+        }
+    }
+}
+
+struct Jit::Shadow {
+    Memory memory {};
+    Stack stack {};
+    Screen screen {};
+    Keyboard keyboard {};
+    CPU cpu {};
+
+    Shadow() {
+        cpu.Init(&memory, &stack, &screen, &keyboard);
+        cpu.Engine = CpuEngine::Switch;
+    }
+};
+
+Jit::Jit(CPU& cpu) : _cpu(cpu) {
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(&cpu);
+    _offsetV = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(&cpu.V[0]) - base);
+    _offsetI = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(&cpu.I) - base);
+    _offsetPC = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(&cpu.PC) - base);
+    _offsetDelay = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(&cpu.Delay) - base);
+    _offsetSound = static_cast<int32_t>(reinterpret_cast<const uint8_t*>(&cpu.Sound) - base);
+
+    _code = AllocateExecutable(CodeCapacity);
+    _writable = true;
+    SetWritable(false);
+}
+
+Jit::~Jit() {
+    if (_code != nullptr) {
+        FreeExecutable(_code, CodeCapacity);
+    }
+}
+
+uint32_t Jit::Run(const uint32_t count) {
+    uint32_t executed = 0u;
+    while (executed < count) {
+        // copied, as the block may invalidate itself while it runs
+        const uint16_t start = _cpu.PC;
+        const Block block = (start < CHIP8_MEMORY_SIZE) ? GetBlock(start) : Block {};
+
+        if (block.Code == nullptr) {
+            executed += _cpu.RunCached(1u);
+        } else {
+            if (_cpu.JitLockstep) {
+                CaptureLockstep();
+            }
+
+            const uint32_t ran = block.Code(&_cpu, count - executed);
+            _cpu.InstructionCount += ran;
+            executed += ran;
+
+            if (_cpu.JitLockstep) {
+                CheckLockstep(start, ran);
+            }
+        }
+
+        if (_cpu.Halted) break;
+    }
+    return executed;
+}
+
+const Jit::Block& Jit::GetBlock(const uint16_t address) {
+    Block& block = _blocks[address];
+    if (!block.Valid && SetWritable(true)) {
+        block = Translate(address);
+
+        for (uint16_t i = address; i < block.End; i++) {
+            _coverage[i] += 1u;
+        }
+        SetWritable(false);
+    }
+    return block;
+}
+
+bool Jit::SetWritable(const bool writable) {
+    if (_code == nullptr) return false;
+    if (_writable == writable) return true;
+
+    if (!ProtectExecutable(_code, CodeCapacity, !writable)) {
+        // without a way back to executable code, run everything interpreted
+        std::cerr << "[Jit] cannot change the protection of the code buffer, disabling the jit" << std::endl;
+        Flush();
+        FreeExecutable(_code, CodeCapacity);
+        _code = nullptr;
+        return false;
+    }
+    _writable = writable;
+    return true;
+}
+
+Jit::Block Jit::Translate(const uint16_t address) {
+    if (_codeUsed + MaxBlockCodeSize > CodeCapacity) {
+        Flush();
+    }
+
+    uint8_t* const memory = _cpu._memory->GetPtr(0);
+    const auto ReadCode = [memory](const uint16_t pc) -> uint16_t {
+        return (memory[pc] << 8) | memory[pc + 1u];
+    };
+    const auto VX = [this](const uint8_t x) { return _offsetV + x; };
+    const int32_t VF = VX(REGISTER_CARRY_FLAG_INDEX);
+    // read here rather than at every opcode: SetQuirks() drops the Jit
+    const uint8_t quirks = _cpu._quirks;
+
+    Emitter e(_code + _codeUsed);
+
+    // calls the interpreter's handler for the opcode at `pc`, with PC already
+    // pointing past it
+    const auto EmitExec = [&](const uint16_t code, const uint16_t pc) {
+        DecodedOpcode& operands = _operands[pc];
+        operands = CPU::Decode(code, quirks);
+
+        e.MovMemImm16(_offsetPC, pc + 2u);
+        e.CallHandler(operands.Handler, &operands);
+    };
+
+    // Emits a Straight or Exit opcode; Exit opcodes leave the next PC in PC
+    const auto EmitOpcode = [&](const uint16_t code, const uint16_t pc) {
+        const Opcode opcode = Opcode(code);
+        const uint8_t x = opcode.X();
+        const uint8_t y = opcode.Y();
+
+        switch (code & 0xF000) {
+            case 0x0000: // [00E0] CLS, [00EE] RET, [0nnn] is ignored
+                if (code == 0x00E0 || code == 0x00EE) {
+                    EmitExec(code, pc);
+                }
+                break;
+
+            case 0x1000: // [1nnn] JP addr
+                e.MovMemImm16(_offsetPC, opcode.NNN());
+                break;
+
+            case 0x2000: // [2nnn] CALL addr
+                EmitExec(code, pc);
+                break;
+
+            case 0x6000: // [6xkk] LD Vx, byte
+                e.MovMemImm8(VX(x), opcode.KK());
+                break;
+
+            case 0x7000: // [7xkk] ADD Vx, byte
+                e.AddMemImm8(VX(x), opcode.KK());
+                break;
+
+            case 0x8000:
+                switch (code & 0x000F) {
+                    case 0x0: // [8xy0] LD Vx, Vy
+                        e.LoadAl(VX(y));
+                        e.StoreAl(VX(x));
+                        break;
+                    case 0x1: // [8xy1] OR Vx, Vy
+                        e.LoadAl(VX(y));
+                        e.Alu(OrMemAl, VX(x));
+                        if (quirks & Quirk::LogicResetsVF) {
+                            e.MovMemImm8(VF, 0u);
+                        }
+                        break;
+                    case 0x2: // [8xy2] AND Vx, Vy
+                        e.LoadAl(VX(y));
+                        e.Alu(AndMemAl, VX(x));
+                        if (quirks & Quirk::LogicResetsVF) {
+                            e.MovMemImm8(VF, 0u);
+                        }
+                        break;
+                    case 0x3: // [8xy3] XOR Vx, Vy
+                        e.LoadAl(VX(y));
+                        e.Alu(XorMemAl, VX(x));
+                        if (quirks & Quirk::LogicResetsVF) {
+                            e.MovMemImm8(VF, 0u);
+                        }
+                        break;
+                    case 0x4: // [8xy4] ADD Vx, Vy - VF = carry, then Vx = sum
+                        e.LoadAl(VX(x));
+                        e.Alu(AddAlMem, VX(y));
+                        e.SetCl(Carry);
+                        e.StoreCl(VF);
+                        e.StoreAl(VX(x));
+                        break;
+                    case 0x5: // [8xy5] SUB Vx, Vy - VF = Vx > Vy, then Vx -= Vy (reloaded, as x or y may be F)
+                        e.LoadAl(VX(x));
+                        e.Alu(CmpAlMem, VX(y));
+                        e.SetCl(Above);
+                        e.StoreCl(VF);
+                        e.LoadAl(VX(x));
+                        e.Alu(SubAlMem, VX(y));
+                        e.StoreAl(VX(x));
+                        break;
+                    case 0x6: // [8xy6] SHR Vx
+                        if (quirks & Quirk::ShiftUsesVy) { // VF = Vy & 1, then Vx = Vy >> 1 (Vy kept in cl, as y may be F)
+                            e.LoadAl(VX(y));
+                            e.MovClAl();
+                            e.AndAlImm(0x01);
+                            e.StoreAl(VF);
+                            e.ShrCl1();
+                            e.StoreCl(VX(x));
+                            break;
+                        }
+                        e.LoadAl(VX(x));
+                        e.AndAlImm(0x01);
+                        e.StoreAl(VF);
+                        e.ShrMem1(VX(x));
+                        break;
+                    case 0x7: // [8xy7] SUBN Vx, Vy - VF = Vy > Vx, then Vx = Vy - Vx
+                        e.LoadAl(VX(y));
+                        e.Alu(CmpAlMem, VX(x));
+                        e.SetCl(Above);
+                        e.StoreCl(VF);
+                        e.LoadAl(VX(y));
+                        e.Alu(SubAlMem, VX(x));
+                        e.StoreAl(VX(x));
+                        break;
+                    case 0xE: // [8xyE] SHL Vx
+                        if (quirks & Quirk::ShiftUsesVy) { // VF = Vy >> 7, then Vx = Vy << 1
+                            e.LoadAl(VX(y));
+                            e.MovClAl();
+                            e.ShrAlImm(7);
+                            e.StoreAl(VF);
+                            e.ShlCl1();
+                            e.StoreCl(VX(x));
+                            break;
+                        }
+                        e.LoadAl(VX(x));
+                        e.ShrAlImm(7);
+                        e.StoreAl(VF);
+                        e.ShlMem1(VX(x));
+                        break;
+                }
+                break;
+
+            case 0xA000: // [Annn] LD I, addr
+                e.MovMemImm16(_offsetI, opcode.NNN());
+                break;
+
+            case 0xB000: // [Bnnn] JP V0, addr ([Bxnn] JP Vx, addr with Quirk::JumpUsesVx)
+                e.MovzxEaxMem8(VX((quirks & Quirk::JumpUsesVx) ? x : 0u));
+                e.AddEaxImm(opcode.NNN());
+                e.StoreAx(_offsetPC);
+                break;
+
+            case 0xC000: // [Cxkk] RND Vx, byte
+            case 0xD000: // [Dxyn] DRW Vx, Vy, nibble
+                EmitExec(code, pc);
+                break;
+
+            case 0xF000:
+                switch (code & 0x00FF) {
+                    case 0x07: // [Fx07] LD Vx, DT
+                        e.LoadAl(_offsetDelay);
+                        e.StoreAl(VX(x));
+                        break;
+                    case 0x15: // [Fx15] LD DT, Vx
+                        e.LoadAl(VX(x));
+                        e.StoreAl(_offsetDelay);
+                        break;
+                    case 0x18: // [Fx18] LD ST, Vx
+                        e.LoadAl(VX(x));
+                        e.StoreAl(_offsetSound);
+                        break;
+                    case 0x0A: // [Fx0A] LD Vx, K
+                    case 0x33: // [Fx33] LD B, Vx
+                    case 0x55: // [Fx55] LD [I], Vx
+                    case 0x65: // [Fx65] LD Vx, [I]
+                        EmitExec(code, pc);
+                        break;
+                    case 0x1E: // [Fx1E] ADD I, Vx
+                        e.MovzxEaxMem8(VX(x));
+                        e.AddMemAx(_offsetI);
+                        break;
+                    case 0x29: // [Fx29] LD F, Vx
+                        e.MovzxEaxMem8(VX(x));
+                        e.LeaEaxTimes5();
+                        e.StoreAx(_offsetI);
+                        break;
+                }
+                break;
+        }
+    };
+
+    // Emits the test of a Skip opcode; returns the condition under which the
+    // next opcode is skipped
+    const auto EmitSkipTest = [&](const uint16_t code, const uint16_t pc) -> Condition {
+        const Opcode opcode = Opcode(code);
+        switch (code & 0xF000) {
+            case 0x3000: // [3xkk] SE Vx, byte
+                e.CmpMemImm8(VX(opcode.X()), opcode.KK());
+                return Equal;
+            case 0x4000: // [4xkk] SNE Vx, byte
+                e.CmpMemImm8(VX(opcode.X()), opcode.KK());
+                return NotEqual;
+            case 0x5000: // [5xy0] SE Vx, Vy
+                e.LoadAl(VX(opcode.X()));
+                e.Alu(CmpAlMem, VX(opcode.Y()));
+                return Equal;
+            case 0x9000: // [9xy0] SNE Vx, Vy
+                e.LoadAl(VX(opcode.X()));
+                e.Alu(CmpAlMem, VX(opcode.Y()));
+                return NotEqual;
+            default: // [Ex9E] SKP Vx, [ExA1] SKNP Vx - the helper moves PC past the skipped opcode
+                EmitExec(code, pc);
+                e.CmpMemImm16(_offsetPC, pc + 4u);
+                return Equal;
+        }
+    };
+
+    // an early exit taken when the budget runs out before the opcode at `pc`
+    struct BudgetExit {
+        size_t Branch;
+        uint16_t PC;
+        uint32_t Length;
+    };
+    BudgetExit budgetExits[MaxBlockLength] = {};
+    uint32_t budgetExitCount = 0u;
+
+    const auto SpendBudget = [&](const uint16_t pc, const uint32_t length) {
+        // the caller guarantees a budget of at least one opcode
+        if (length == 0u) {
+            e.Byte(0x41); e.Byte(0x83); e.Byte(0xED); e.Byte(0x01); // sub r13d, 1
+            return;
+        }
+        budgetExits[budgetExitCount++] = { e.SpendBudget(), pc, length };
+    };
+
+    e.Prologue();
+
+    // `length` counts every opcode on the path that skips nothing; opcodes
+    // skipped at runtime are counted in r12d and subtracted on return
+    uint16_t pc = address;
+    uint32_t length = 0u;
+    bool terminated = false;
+    while (!terminated && length < MaxBlockLength && pc + 1u < CHIP8_MEMORY_SIZE) {
+        const uint16_t code = ReadCode(pc);
+        const uint16_t next = pc + 2u;
+        const OpKind kind = Classify(code);
+
+        if (kind == OpKind::Interpreted) break;
+
+        SpendBudget(pc, length);
+
+        if (kind != OpKind::Skip) {
+            EmitOpcode(code, pc);
+            pc = next;
+            length += 1u;
+
+            if (kind == OpKind::Exit) {
+                e.Return(length);
+                terminated = true;
+            }
+            continue;
+        }
+
+        const Condition skipped = EmitSkipTest(code, pc);
+        length += 1u;
+
+        const OpKind nextKind = (next + 1u < CHIP8_MEMORY_SIZE && length + 1u < MaxBlockLength)
+                ? Classify(ReadCode(next))
+                : OpKind::Interpreted;
+
+        if (nextKind == OpKind::Straight || nextKind == OpKind::Exit) {
+            // the skipped opcode is translated behind a branch
+            const size_t skipBranch = e.Jcc(skipped);
+            SpendBudget(next, length);
+            EmitOpcode(ReadCode(next), next);
+            length += 1u;
+
+            if (nextKind == OpKind::Exit) {
+                e.Return(length);
+                e.Bind(skipBranch);
+                e.IncSkipped();
+            } else {
+                const size_t joinBranch = e.Jmp();
+                e.Bind(skipBranch);
+                e.IncSkipped();
+                e.Bind(joinBranch);
+            }
+            pc = next + 2u;
+        } else {
+            // ends the block here, picking the next PC from the test
+            e.MovEaxImm(next);
+            e.MovEcxImm(next + 2u);
+            e.CmovEaxEcx(skipped);
+            e.StoreAx(_offsetPC);
+            e.Return(length);
+
+            pc = next;
+            terminated = true;
+        }
+    }
+
+    Block block = {};
+    block.Valid = true;
+
+    if (length == 0u) {
+        // covers its first opcode, so a rewrite gives it another chance; at
+        // 0xFFF that opcode is cut off by the end of memory
+        block.End = (address + 2u < CHIP8_MEMORY_SIZE) ? address + 2u : CHIP8_MEMORY_SIZE;
+        return block;
+    }
+
+    if (!terminated) {
+        e.MovMemImm16(_offsetPC, pc);
+        e.Return(length);
+    }
+
+    for (uint32_t i = 0u; i < budgetExitCount; i++) {
+        const BudgetExit& exit = budgetExits[i];
+        e.Bind(exit.Branch);
+        e.MovMemImm16(_offsetPC, exit.PC);
+        e.Return(exit.Length);
+    }
+
+    block.Code = reinterpret_cast<BlockFn>(_code + _codeUsed);
+    block.End = pc;
+
+    _codeUsed += e.Size();
+    return block;
+}
+
+void Jit::Invalidate(const uint16_t address, const size_t size) {
+    const size_t last = (address + size < CHIP8_MEMORY_SIZE) ? address + size : CHIP8_MEMORY_SIZE;
+
+    bool translated = false;
+    for (size_t i = address; i < last && !translated; i++) {
+        translated = _coverage[i] != 0u;
+    }
+    if (!translated) return;
+
+    // a block starts at most MaxBlockLength opcodes before any byte it covers
+    const size_t first = (address > MaxBlockLength * 2u) ? address - MaxBlockLength * 2u : 0u;
+    for (size_t start = first; start < last; start++) {
+        Block& block = _blocks[start];
+        if (!block.Valid || block.End <= address) continue;
+
+        for (size_t i = start; i < block.End; i++) {
+            _coverage[i] -= 1u;
+        }
+        block = {};
+    }
+}
+
+void Jit::CollectCode(AddressSet& outCode) const {
+    for (uint16_t start = 0u; start < CHIP8_MEMORY_SIZE; start++) {
+        const Block& block = _blocks[start];
+        if (block.Code == nullptr) continue;
+
+        for (uint32_t address = start; address < block.End; address += 2u) {
+            outCode.set(address);
+        }
+    }
+}
+
+void Jit::Save(ByteWriter& w) const {
+    uint32_t count = 0u;
+    for (const Block& block : _blocks) {
+        if (block.Code != nullptr) count += 1u;
+    }
+    w.U32(count);
+
+    const uint8_t* memory = _cpu._memory->GetPtr(0);
+    for (uint16_t start = 0u; start < CHIP8_MEMORY_SIZE; start++) {
+        const Block& block = _blocks[start];
+        if (block.Code == nullptr) continue;
+
+        w.U16(start);
+        w.U16(block.End);
+        w.Bytes(memory + start, block.End - start);
+    }
+}
+
+bool Jit::Load(ByteReader& r, const uint8_t* end, uint32_t& outBlocks) {
+    outBlocks = 0u;
+    const auto Has = [&r, end](const size_t size) { return static_cast<size_t>(end - r.data) >= size; };
+
+    if (!Has(4u)) return false;
+    const uint32_t count = r.U32();
+
+    const uint8_t* memory = _cpu._memory->GetPtr(0);
+    // writable for the whole batch, executable again on every way out
+    struct ProtectOnExit {
+        Jit& jit;
+        ~ProtectOnExit() { jit.SetWritable(false); }
+    } protect {*this};
+    const bool writable = SetWritable(true);
+
+    for (uint32_t i = 0u; i < count; i++) {
+        if (!Has(4u)) return false;
+        const uint16_t start = r.U16();
+        const uint16_t blockEnd = r.U16();
+        if (start >= blockEnd || blockEnd > CHIP8_MEMORY_SIZE) return false;
+        if (!Has(blockEnd - start)) return false;
+
+        const uint8_t* source = r.data;
+        r.data += blockEnd - start;
+
+        if (!writable || _blocks[start].Valid) continue;
+        if (memcmp(memory + start, source, blockEnd - start) != 0) continue;
+        // Translate flushes a full buffer, that would drop the blocks installed so far
+        if (_codeUsed + MaxBlockCodeSize > CodeCapacity) continue;
+
+        Block& block = _blocks[start];
+        block = Translate(start);
+        for (uint16_t address = start; address < block.End; address++) {
+            _coverage[address] += 1u;
+        }
+        if (block.Code != nullptr) outBlocks += 1u;
+    }
+    return true;
+}
+
+void Jit::Flush() {
+    for (Block& block : _blocks) {
+        block = {};
+    }
+    memset(_coverage, 0, sizeof(_coverage));
+    _codeUsed = 0u;
+}
+
+void Jit::CaptureLockstep() {
+    if (_shadow == nullptr) {
+        _shadow.reset(new Shadow());
+    }
+
+    Shadow& shadow = *_shadow;
+    shadow.memory.WriteBuffer(0u, _cpu._memory->GetPtr(0u), CHIP8_MEMORY_SIZE);
+    shadow.stack = *_cpu._stack;
+    shadow.screen = *_cpu._screen;
+    shadow.keyboard = *_cpu._keyboard;
+
+    memcpy(shadow.cpu.V, _cpu.V, sizeof(_cpu.V));
+    shadow.cpu.I = _cpu.I;
+    shadow.cpu.PC = _cpu.PC;
+    shadow.cpu.Delay = _cpu.Delay;
+    shadow.cpu.Sound = _cpu.Sound;
+    shadow.cpu.Rng = _cpu.Rng;
+    shadow.cpu.Halted = false;
+    shadow.cpu.SetQuirks(_cpu._quirks);
+}
+
+void Jit::CheckLockstep(const uint16_t startAddress, const uint32_t length) {
+    Shadow& shadow = *_shadow;
+    shadow.cpu.Run(length);
+
+    const bool registersMatch = memcmp(shadow.cpu.V, _cpu.V, sizeof(_cpu.V)) == 0
+            && shadow.cpu.I == _cpu.I
+            && shadow.cpu.PC == _cpu.PC
+            && shadow.stack.SP == _cpu._stack->SP;
+    const bool screenMatches = memcmp(shadow.screen.Rows, _cpu._screen->Rows, sizeof(shadow.screen.Rows)) == 0;
+    if (registersMatch && screenMatches) return;
+
+    _cpu.LockstepMismatches += 1u;
+
+    std::cerr << std::hex
+              << "[Jit] lockstep mismatch in block 0x" << startAddress << " (" << std::dec << length << " opcodes)"
+              << std::hex << ": PC 0x" << _cpu.PC << " vs 0x" << shadow.cpu.PC
+              << ", I 0x" << _cpu.I << " vs 0x" << shadow.cpu.I
+              << (screenMatches ? "" : ", screen differs") << std::dec << std::endl;
+    for (int i = 0; i < CHIP8_DATA_REGISTERS_SIZE; i++) {
+        if (shadow.cpu.V[i] != _cpu.V[i]) {
+            std::cerr << "[Jit]   V" << std::hex << i << ": " << std::dec
+                      << static_cast<int>(_cpu.V[i]) << " vs " << static_cast<int>(shadow.cpu.V[i]) << std::endl;
+        }
+    }
+}
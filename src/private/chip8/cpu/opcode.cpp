@@ -1,5 +1,7 @@
 #include "chip8/cpu/opcode.h"
 
+#include <cstdio>
+
 Opcode::Opcode(const uint16_t code) : Code(code) { }
 
 uint8_t Opcode::X() const {
@@ -26,3 +28,60 @@ uint16_t Opcode::NNN() const {
     const uint16_t nnn = Code & 0x0FFF;
     return nnn;
 }
+
+void Opcode::Disassemble(const uint16_t code, char* out, const size_t size) {
+    const uint8_t x = (code >> 8) & 0x0Fu;
+    const uint8_t y = (code >> 4) & 0x0Fu;
+    const uint8_t n = code & 0x0Fu;
+    const uint8_t kk = code & 0xFFu;
+    const uint16_t nnn = code & 0x0FFFu;
+
+    switch (code & 0xF000u) {
+        case 0x0000u:
+            if (code == 0x00E0u) { snprintf(out, size, "CLS"); return; }
+            if (code == 0x00EEu) { snprintf(out, size, "RET"); return; }
+            snprintf(out, size, "SYS  0x%03X", nnn);
+            return;
+        case 0x1000u: snprintf(out, size, "JP   0x%03X", nnn); return;
+        case 0x2000u: snprintf(out, size, "CALL 0x%03X", nnn); return;
+        case 0x3000u: snprintf(out, size, "SE   V%X, 0x%02X", x, kk); return;
+        case 0x4000u: snprintf(out, size, "SNE  V%X, 0x%02X", x, kk); return;
+        case 0x5000u: snprintf(out, size, "SE   V%X, V%X", x, y); return;
+        case 0x6000u: snprintf(out, size, "LD   V%X, 0x%02X", x, kk); return;
+        case 0x7000u: snprintf(out, size, "ADD  V%X, 0x%02X", x, kk); return;
+        case 0x8000u: {
+            static const char* const names[16] = {
+                    "LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+                    nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "SHL", nullptr
+            };
+            if (names[n] != nullptr) {
+                snprintf(out, size, "%-4s V%X, V%X", names[n], x, y);
+                return;
+            }
+            break;
+        }
+        case 0x9000u: snprintf(out, size, "SNE  V%X, V%X", x, y); return;
+        case 0xA000u: snprintf(out, size, "LD   I, 0x%03X", nnn); return;
+        case 0xB000u: snprintf(out, size, "JP   V0, 0x%03X", nnn); return;
+        case 0xC000u: snprintf(out, size, "RND  V%X, 0x%02X", x, kk); return;
+        case 0xD000u: snprintf(out, size, "DRW  V%X, V%X, %u", x, y, n); return;
+        case 0xE000u:
+            if (kk == 0x9Eu) { snprintf(out, size, "SKP  V%X", x); return; }
+            if (kk == 0xA1u) { snprintf(out, size, "SKNP V%X", x); return; }
+            break;
+        case 0xF000u:
+            switch (kk) {
+                case 0x07u: snprintf(out, size, "LD   V%X, DT", x); return;
+                case 0x0Au: snprintf(out, size, "LD   V%X, K", x); return;
+                case 0x15u: snprintf(out, size, "LD   DT, V%X", x); return;
+                case 0x18u: snprintf(out, size, "LD   ST, V%X", x); return;
+                case 0x1Eu: snprintf(out, size, "ADD  I, V%X", x); return;
+                case 0x29u: snprintf(out, size, "LD   F, V%X", x); return;
+                case 0x33u: snprintf(out, size, "LD   B, V%X", x); return;
+                case 0x55u: snprintf(out, size, "LD   [I], V%X", x); return;
+                case 0x65u: snprintf(out, size, "LD   V%X, [I]", x); return;
+            }
+            break;
+    }
+    snprintf(out, size, "???");
+}
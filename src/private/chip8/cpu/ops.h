@@ -0,0 +1,330 @@
+#pragma once
+
+#include "chip8/constants.h"
+#include "chip8/cpu/cpu.h"
+#include "chip8/cpu/flight_recorder.h"
+#include "chip8/cpu/profiler.h"
+
+// Opcode semantics over pre-decoded operands, used by the interpreters that
+// run from the decode cache. They must behave exactly like CPU::Exec.
+struct CPU::Ops {
+    static void Nop(CPU&, const DecodedOpcode&) { }
+
+    // [00E0] CLS: Clear the display
+    static void Cls(CPU& cpu, const DecodedOpcode&) {
+        CHIP8_PROFILE_SCOPE(cpu, Clear);
+        cpu._screen->Clear();
+    }
+
+    // [00EE] Ret: Return from subroutine
+    static void Ret(CPU& cpu, const DecodedOpcode&) {
+        if (cpu._stack->SP == 0u) {
+            cpu.Fault(TraceReason::StackUnderflow, cpu.PC - 2u);
+        }
+        cpu.PC = cpu._stack->Pop();
+    }
+
+    // [1nnn] JP addr - Jump to location nnn
+    static void Jp(CPU& cpu, const DecodedOpcode& op) {
+        cpu.PC = op.NNN;
+    }
+
+    // [2nnn] CALL addr - Call subroutine at location nnn
+    static void Call(CPU& cpu, const DecodedOpcode& op) {
+        if (cpu._stack->SP >= CHIP8_MEMORY_STACK_SIZE) {
+            cpu.Fault(TraceReason::StackOverflow, cpu.PC - 2u);
+        }
+        cpu._stack->Push(cpu.PC);
+        cpu.PC = op.NNN;
+    }
+
+    // [3xkk] SE Vx, byte - Skip next instruction if Vx == kk
+    static void SeByte(CPU& cpu, const DecodedOpcode& op) {
+        if (cpu.V[op.X] == op.KK) {
+            cpu.PC += 2;
+        }
+    }
+
+    // [4xkk] SNE Vx, byte - Skip next instruction if Vx != kk
+    static void SneByte(CPU& cpu, const DecodedOpcode& op) {
+        if (cpu.V[op.X] != op.KK) {
+            cpu.PC += 2;
+        }
+    }
+
+    // [5xy0] SE Vx, Vy - Skip next instruction if Vx == Vy
+    static void SeReg(CPU& cpu, const DecodedOpcode& op) {
+        if (cpu.V[op.X] == cpu.V[op.Y]) {
+            cpu.PC += 2;
+        }
+    }
+
+    // [6xkk] LD Vx, byte - Set Vx = kk
+    static void LdByte(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[op.X] = op.KK;
+    }
+
+    // [7xkk] ADD Vx, byte - Set Vx = Vx + kk
+    static void AddByte(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[op.X] += op.KK;
+    }
+
+    // [8xy0] LD Vx, Vy - Set Vx = Vy
+    static void LdReg(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[op.X] = cpu.V[op.Y];
+    }
+
+    // [8xy4] ADD Vx, Vy - Set Vx = Vx + Vy, set VF = carry
+    static void AddReg(CPU& cpu, const DecodedOpcode& op) {
+        const uint16_t tmp16 = cpu.V[op.X] + cpu.V[op.Y];
+        cpu.V[REGISTER_CARRY_FLAG_INDEX] = tmp16 > 0xFF;
+        cpu.V[op.X] = tmp16;
+    }
+
+    // [8xy5] SUB Vx, Vy - Set Vx = Vx - Vy, set VF = NOT borrow
+    static void Sub(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[REGISTER_CARRY_FLAG_INDEX] = cpu.V[op.X] > cpu.V[op.Y];
+        cpu.V[op.X] -= cpu.V[op.Y];
+    }
+
+    // [8xy7] SUBN Vx, Vy
+    static void Subn(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[REGISTER_CARRY_FLAG_INDEX] = cpu.V[op.Y] > cpu.V[op.X];
+        cpu.V[op.X] = cpu.V[op.Y] - cpu.V[op.X];
+    }
+
+    // [9xy0] SNE Vx, Vy - Skip next instruction if Vx != Vy
+    static void SneReg(CPU& cpu, const DecodedOpcode& op) {
+        if (cpu.V[op.X] != cpu.V[op.Y]) {
+            cpu.PC += 2;
+        }
+    }
+
+    // [Annn] LD I, addr - Set I = nnn
+    static void LdI(CPU& cpu, const DecodedOpcode& op) {
+        cpu.I = op.NNN;
+    }
+
+    // [Cxkk] RND Vx, byte - Set Vx = random byte AND kk
+    static void Rnd(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[op.X] = cpu.Rng.Next() % 255 & op.KK;
+    }
+
+    // [Ex9E] SKP Vx - Skip the next instruction if key Vx is pressed
+    static void Skp(CPU& cpu, const DecodedOpcode& op) {
+        if (cpu._keyboard->IsKeyDown(cpu.V[op.X])) {
+            cpu.PC += 2;
+        }
+    }
+
+    // [ExA1] SKNP Vx - Skip the next instruction if key Vx is not pressed
+    static void Sknp(CPU& cpu, const DecodedOpcode& op) {
+        if (!cpu._keyboard->IsKeyDown(cpu.V[op.X])) {
+            cpu.PC += 2;
+        }
+    }
+
+    // [Fx07] LD Vx, DT - Set Vx = delay timer value
+    static void LdVxDt(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[op.X] = cpu.Delay;
+    }
+
+    // [Fx0A] LD Vx, K - Wait for a key press, store the value of the key in Vx
+    static void LdVxK(CPU& cpu, const DecodedOpcode& op) {
+        cpu.Halted = true;
+        cpu.KeyWaitRegister = op.X;
+        cpu._keyboard->ClearLatch();
+    }
+
+    // [Fx15] LD DT, Vx - Set delay timer = Vx
+    static void LdDtVx(CPU& cpu, const DecodedOpcode& op) {
+        cpu.Delay = cpu.V[op.X];
+    }
+
+    // [Fx18] LD ST, Vx - Set sound timer = Vx
+    static void LdStVx(CPU& cpu, const DecodedOpcode& op) {
+        cpu.Sound = cpu.V[op.X];
+    }
+
+    // [Fx1E] ADD I, Vx - Set I = I + Vx
+    static void AddIVx(CPU& cpu, const DecodedOpcode& op) {
+        cpu.I += cpu.V[op.X];
+    }
+
+    // [Fx29] LD F, Vx - Set I = location of sprite for digit Vx
+    static void LdFVx(CPU& cpu, const DecodedOpcode& op) {
+        cpu.I = cpu.V[op.X] * CHIP8_DEFAULT_SPRITE_HEIGHT;
+    }
+
+    // [Fx33] LD B, Vx - Store BCD representation of Vx in Memory locations I, I+1, and I+2
+    static void LdBVx(CPU& cpu, const DecodedOpcode& op) {
+        const uint8_t value = cpu.V[op.X];
+
+        cpu._memory->Write(cpu.I, value / 100);
+        cpu._memory->Write(cpu.I + 1, value / 10 % 10);
+        cpu._memory->Write(cpu.I + 2, value % 10);
+    }
+};
+
+// The opcodes that depend on the quirks, specialized for a QuirkPolicy;
+// everything else comes from Ops. Decode hands out the handlers of the
+// instance for CPU::GetQuirks(), so none of these checks a flag at runtime.
+template <typename Policy>
+struct CPU::QuirkOps : CPU::Ops {
+    // [8xy1] OR Vx, Vy - Set Vx = Vx OR Vy
+    static void Or(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[op.X] |= cpu.V[op.Y];
+        if (Policy::LogicResetsVF) cpu.V[REGISTER_CARRY_FLAG_INDEX] = 0u;
+    }
+
+    // [8xy2] AND Vx, Vy - Set Vx = Vx AND Vy
+    static void And(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[op.X] &= cpu.V[op.Y];
+        if (Policy::LogicResetsVF) cpu.V[REGISTER_CARRY_FLAG_INDEX] = 0u;
+    }
+
+    // [8xy3] XOR Vx, Vy - Set Vx = Vx XOR Vy
+    static void Xor(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[op.X] ^= cpu.V[op.Y];
+        if (Policy::LogicResetsVF) cpu.V[REGISTER_CARRY_FLAG_INDEX] = 0u;
+    }
+
+    // [8xy6] SHR Vx {, Vy}
+    static void Shr(CPU& cpu, const DecodedOpcode& op) {
+        const uint8_t Vy = cpu.V[op.Y];
+        cpu.V[REGISTER_CARRY_FLAG_INDEX] = (Policy::ShiftUsesVy ? Vy : cpu.V[op.X]) & 0x01;
+        cpu.V[op.X] = (Policy::ShiftUsesVy ? Vy : cpu.V[op.X]) / 2;
+    }
+
+    // [8xyE] SHL Vx {, Vy}
+    static void Shl(CPU& cpu, const DecodedOpcode& op) {
+        const uint8_t Vy = cpu.V[op.Y];
+        cpu.V[REGISTER_CARRY_FLAG_INDEX] = ((Policy::ShiftUsesVy ? Vy : cpu.V[op.X]) & 0b1000'0000) >> 7;
+        cpu.V[op.X] = (Policy::ShiftUsesVy ? Vy : cpu.V[op.X]) * 2;
+    }
+
+    // [Bnnn] JP V0, addr - Jump to location nnn + V0 ([Bxnn]: xnn + Vx)
+    static void JpV0(CPU& cpu, const DecodedOpcode& op) {
+        cpu.PC = op.NNN + cpu.V[Policy::JumpUsesVx ? op.X : 0u];
+    }
+
+    // [Dxyn] DRW Vx, Vy, nibble
+    static void Drw(CPU& cpu, const DecodedOpcode& op) {
+        const uint8_t Vx = cpu.V[op.X];
+        const uint8_t Vy = cpu.V[op.Y];
+        uint8_t rows[16];
+        const uint8_t* spritePtr = cpu._memory->GetRange(cpu.I, op.N, rows);
+
+        CHIP8_PROFILE_SCOPE(cpu, DrawSprite);
+        const bool pixelCollision = cpu._screen->DrawSprite<Policy::ClipSprites>(Vx, Vy, spritePtr, op.N);
+        cpu.V[REGISTER_CARRY_FLAG_INDEX] = pixelCollision;
+    }
+
+    // [Fx55] LD [I], Vx - Store Registers V0 through Vx in Memory starting at location I
+    static void LdIVx(CPU& cpu, const DecodedOpcode& op) {
+        const uint8_t x = op.X;
+        for (uint8_t i = 0u; i <= x; i++) {
+            cpu._memory->Write(cpu.I + i, cpu.V[i]);
+        }
+        if (Policy::LoadStoreIncrementsI) cpu.I += x + 1u;
+    }
+
+    // [Fx65] LD Vx, [I] - Read Registers V0 through Vx from Memory starting at location I
+    static void LdVxI(CPU& cpu, const DecodedOpcode& op) {
+        const uint8_t x = op.X;
+        for (uint8_t i = 0u; i <= x; i++) {
+            cpu.V[i] = cpu._memory->Read(cpu.I + i);
+        }
+        if (Policy::LoadStoreIncrementsI) cpu.I += x + 1u;
+    }
+
+    // Superinstructions (see CPU::Fuse). Each one starts with PC past its
+    // first opcode, like the handlers above, and returns the number of
+    // opcodes it ran.
+
+    // [6xkk][6ykk] with y and its byte in Y and N
+    static uint32_t LdByteLdByte(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[op.X] = op.KK;
+        cpu.PC += 2u;
+        cpu.V[op.Y] = op.N;
+        return 2u;
+    }
+
+    // [Annn][Dxyn] with the operands of Dxyn in X, Y and N
+    static uint32_t LdIDrw(CPU& cpu, const DecodedOpcode& op) {
+        cpu.I = op.NNN;
+        cpu.PC += 2u;
+        Drw(cpu, op);
+        return 2u;
+    }
+
+    // [Fx07][3x00][1nnn], polling the delay timer, with nnn in NNN
+    static uint32_t LdVxDtSeByteJp(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[op.X] = cpu.Delay;
+        if (cpu.V[op.X] == 0u) {
+            cpu.PC += 4u;
+            return 2u;
+        }
+        cpu.PC = op.NNN;
+        return 3u;
+    }
+
+    // [Fx33][Fy65] with y in Y
+    static uint32_t LdBVxLdVxI(CPU& cpu, const DecodedOpcode& op) {
+        LdBVx(cpu, op);
+
+        // the digits may have overwritten Fy65; run whatever is there now
+        if (!cpu._decodeCache.IsDecoded(cpu.PC - 2u)) {
+            cpu.Exec(cpu.ReadNextOpcode());
+            return 2u;
+        }
+
+        cpu.PC += 2u;
+        const uint8_t y = op.Y;
+        for (uint8_t i = 0u; i <= y; i++) {
+            cpu.V[i] = cpu._memory->Read(cpu.I + i);
+        }
+        if (Policy::LoadStoreIncrementsI) cpu.I += y + 1u;
+        return 2u;
+    }
+
+    // [7xkk][3xkk][1nnn], a counted loop, with the second byte in N and nnn in NNN
+    static uint32_t AddByteSeByteJp(CPU& cpu, const DecodedOpcode& op) {
+        cpu.V[op.X] += op.KK;
+        if (cpu.V[op.X] == op.N) {
+            cpu.PC += 4u;
+            return 2u;
+        }
+        cpu.PC = op.NNN;
+        return 3u;
+    }
+
+    static uint32_t Fused(CPU& cpu, const DecodedOpcode& op) {
+        switch (op.Op) {
+            case OpId::LdByte: return LdByteLdByte(cpu, op);
+            case OpId::LdI: return LdIDrw(cpu, op);
+            case OpId::LdVxDt: return LdVxDtSeByteJp(cpu, op);
+            case OpId::LdBVx: return LdBVxLdVxI(cpu, op);
+            case OpId::AddByte: return AddByteSeByteJp(cpu, op);
+            default:
+                op.Handler(cpu, op);
+                return 1u;
+        }
+    }
+};
+
+inline bool CPU::CanRunFused(const DecodedOpcode& opcode, const uint32_t left) const {
+#if CHIP8_PROFILE
+    // the profile counts every opcode on its own
+    if (Profile != nullptr) return false;
+#endif
+    return opcode.FusedLength != 0u && opcode.FusedLength <= left;
+}
+
+inline const DecodedOpcode& CPU::FetchDecoded(const uint16_t address) {
+    DecodedOpcode& entry = _decodeCache.Get(address);
+    if (entry.Handler == nullptr) {
+        DecodeAt(address, entry);
+    }
+    return entry;
+}
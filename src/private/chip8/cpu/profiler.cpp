@@ -0,0 +1,104 @@
+#include "chip8/cpu/profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    const char* const OpNames[] = {
+#define CHIP8_OPCODE_NAME(name) #name,
+        CHIP8_OPCODE_LIST(CHIP8_OPCODE_NAME)
+#undef CHIP8_OPCODE_NAME
+    };
+    static_assert(sizeof(OpNames) / sizeof(OpNames[0]) == static_cast<size_t>(OpId::Count),
+                  "Every OpId needs a name");
+
+    double Percent(const uint64_t part, const uint64_t total) {
+        return (total > 0u) ? (100.0 * static_cast<double>(part) / static_cast<double>(total)) : 0.0;
+    }
+
+    void WriteTiming(std::ostream& out, const char* name, const CpuProfile::Timing& timing) {
+        char line[128];
+        const double average = (timing.Calls > 0u) ? static_cast<double>(timing.Nanoseconds) / static_cast<double>(timing.Calls) : 0.0;
+        snprintf(line, sizeof(line), "  %-12s %12llu calls %12.3f ms %10.1f ns/call", name,
+                 static_cast<unsigned long long>(timing.Calls), static_cast<double>(timing.Nanoseconds) / 1e6, average);
+        out << line << std::endl;
+    }
+}
+
+void CpuProfile::Reset() {
+    *this = CpuProfile {};
+}
+
+uint64_t CpuProfile::GetInstructionCount() const {
+    uint64_t total = 0u;
+    for (const uint64_t count : OpCounts) {
+        total += count;
+    }
+    return total;
+}
+
+const char* CpuProfile::GetOpName(const OpId op) {
+    const size_t index = static_cast<size_t>(op);
+    return (index < static_cast<size_t>(OpId::Count)) ? OpNames[index] : "?";
+}
+
+void CpuProfile::WriteReport(std::ostream& out, const size_t hotPcs) const {
+    const uint64_t total = GetInstructionCount();
+    char line[128];
+
+    std::vector<size_t> ops;
+    for (size_t op = 0u; op < static_cast<size_t>(OpId::Count); op++) {
+        if (OpCounts[op] > 0u) {
+            ops.push_back(op);
+        }
+    }
+    std::stable_sort(ops.begin(), ops.end(), [this](size_t a, size_t b) { return OpCounts[a] > OpCounts[b]; });
+
+    out << "opcodes (" << total << " executed):" << std::endl;
+    for (const size_t op : ops) {
+        snprintf(line, sizeof(line), "  %-12s %14llu %7.2f%%", OpNames[op],
+                 static_cast<unsigned long long>(OpCounts[op]), Percent(OpCounts[op], total));
+        out << line << std::endl;
+    }
+
+    std::vector<uint16_t> pcs;
+    for (uint16_t pc = 0u; pc < CHIP8_MEMORY_SIZE; pc++) {
+        if (PcCounts[pc] > 0u) {
+            pcs.push_back(pc);
+        }
+    }
+    const size_t shown = std::min(hotPcs, pcs.size());
+    std::partial_sort(pcs.begin(), pcs.begin() + shown, pcs.end(), [this](uint16_t a, uint16_t b) {
+        return PcCounts[a] > PcCounts[b] || (PcCounts[a] == PcCounts[b] && a < b);
+    });
+
+    out << "hot addresses (" << shown << " of " << pcs.size() << "):" << std::endl;
+    for (size_t i = 0u; i < shown; i++) {
+        snprintf(line, sizeof(line), "  0x%03X %14llu %7.2f%%", pcs[i],
+                 static_cast<unsigned long long>(PcCounts[pcs[i]]), Percent(PcCounts[pcs[i]], total));
+        out << line << std::endl;
+    }
+
+    out << "screen:" << std::endl;
+    WriteTiming(out, "DrawSprite", DrawSprite);
+    WriteTiming(out, "Clear", Clear);
+}
+
+void CpuProfile::WriteCsv(std::ostream& out) const {
+    out << "kind,name,count,nanoseconds" << std::endl;
+    for (size_t op = 0u; op < static_cast<size_t>(OpId::Count); op++) {
+        out << "op," << OpNames[op] << "," << OpCounts[op] << "," << std::endl;
+    }
+
+    char address[8];
+    for (uint16_t pc = 0u; pc < CHIP8_MEMORY_SIZE; pc++) {
+        if (PcCounts[pc] == 0u) continue;
+
+        snprintf(address, sizeof(address), "0x%03X", pc);
+        out << "pc," << address << "," << PcCounts[pc] << "," << std::endl;
+    }
+
+    out << "time,DrawSprite," << DrawSprite.Calls << "," << DrawSprite.Nanoseconds << std::endl;
+    out << "time,Clear," << Clear.Calls << "," << Clear.Nanoseconds << std::endl;
+}
@@ -0,0 +1,73 @@
+#include "chip8/cpu/quirks.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+    const struct {
+        const char* name;
+        uint8_t quirks;
+    } Names[] = {
+            {"shift-vy", Quirk::ShiftUsesVy},
+            {"load-store-i", Quirk::LoadStoreIncrementsI},
+            {"jump-vx", Quirk::JumpUsesVx},
+            {"clip", Quirk::ClipSprites},
+            {"logic-vf", Quirk::LogicResetsVF},
+    };
+
+    const struct {
+        const char* name;
+        uint8_t quirks;
+    } Presets[] = {
+            {"none", Quirk::None},
+            {"vip", Quirk::CosmacVip},
+            {"schip", Quirk::SuperChip},
+    };
+}
+
+bool Quirk::Parse(const char* text, uint8_t& outQuirks) {
+    uint8_t quirks = None;
+    while (*text != '\0') {
+        const char* end = strchr(text, ',');
+        const size_t length = (end != nullptr) ? static_cast<size_t>(end - text) : strlen(text);
+
+        bool known = false;
+        for (const auto& entry : Names) {
+            if (strlen(entry.name) == length && strncmp(entry.name, text, length) == 0) {
+                quirks |= entry.quirks;
+                known = true;
+            }
+        }
+        for (const auto& entry : Presets) {
+            if (strlen(entry.name) == length && strncmp(entry.name, text, length) == 0) {
+                quirks |= entry.quirks;
+                known = true;
+            }
+        }
+        if (!known) return false;
+
+        text += length;
+        if (*text == ',') text += 1;
+    }
+
+    outQuirks = quirks;
+    return true;
+}
+
+void Quirk::Format(const uint8_t quirks, char* out, const size_t size) {
+    if (size == 0u) return;
+
+    out[0] = '\0';
+    if ((quirks & All) == None) {
+        snprintf(out, size, "none");
+        return;
+    }
+
+    size_t used = 0u;
+    for (const auto& entry : Names) {
+        if ((quirks & entry.quirks) == 0u || used >= size) continue;
+
+        const int written = snprintf(out + used, size - used, "%s%s", (used > 0u) ? "," : "", entry.name);
+        if (written > 0) used += static_cast<size_t>(written);
+    }
+}
@@ -1,18 +1,63 @@
 #include "chip8/memory/memory.h"
 
-void Memory::WriteBuffer(const uint16_t address, const uint8_t* source, const size_t size) {
+void Memory::SetObserver(MemoryObserver* observer) {
+    _observer = observer;
+}
+
+uint16_t Memory::CheckAddress(const uint16_t address) const {
+    if (address < CHIP8_MEMORY_SIZE) return address;
+
+    if (_observer != nullptr) {
+        _observer->OnMemoryFault(address);
+    }
+    return address & (CHIP8_MEMORY_SIZE - 1u);
+}
+
+void Memory::WriteBuffer(const uint16_t address, const uint8_t* source, size_t size) {
+    if (address + size > CHIP8_MEMORY_SIZE) {
+        if (_observer != nullptr) {
+            _observer->OnMemoryFault(static_cast<uint16_t>(address + size - 1u));
+        }
+        if (address >= CHIP8_MEMORY_SIZE) return;
+        size = CHIP8_MEMORY_SIZE - address;
+    }
+
     memcpy(&memory[address], source, size);
+
+    if (_observer != nullptr) {
+        _observer->OnMemoryWrite(address, size);
+    }
 }
 
-void Memory::Write(const uint16_t address, const uint8_t value) {
+void Memory::Write(uint16_t address, const uint8_t value) {
+    address = CheckAddress(address);
     memory[address] = value;
+
+    if (_observer != nullptr) {
+        _observer->OnMemoryWrite(address, 1u);
+    }
 }
 
 uint8_t Memory::Read(const uint16_t address) {
-    const uint8_t value = memory[address];
+    const uint8_t value = memory[CheckAddress(address)];
     return value;
 }
 
 uint8_t* Memory::GetPtr(const uint16_t address) {
-    return &memory[address];
+    return &memory[CheckAddress(address)];
+}
+
+const uint8_t* Memory::GetPtr(const uint16_t address) const {
+    return &memory[CheckAddress(address)];
+}
+
+const uint8_t* Memory::GetRange(const uint16_t address, const size_t size, uint8_t* scratch) {
+    if (address + size <= CHIP8_MEMORY_SIZE) return &memory[address];
+
+    // reports the first address past the end
+    CheckAddress((address < CHIP8_MEMORY_SIZE) ? static_cast<uint16_t>(CHIP8_MEMORY_SIZE) : address);
+    for (size_t i = 0u; i < size; i++) {
+        scratch[i] = memory[(address + i) & (CHIP8_MEMORY_SIZE - 1u)];
+    }
+    return scratch;
 }
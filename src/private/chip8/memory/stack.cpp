@@ -9,16 +9,23 @@ static void AssertStackInBounds(const uint8_t SP)
     assert(SP < CHIP8_MEMORY_STACK_SIZE);
 }
 
+// Without asserts a full stack drops the value and an empty one returns 0,
+// rather than writing or reading out of bounds
+
 void Stack::Push(uint16_t value)
 {
     AssertStackInBounds(SP);
+    if (SP >= CHIP8_MEMORY_STACK_SIZE) return;
+
     stack[SP] = value;
     SP += 1u;
 }
 
 uint16_t Stack::Pop()
 {
+    AssertStackInBounds(SP - 1u);
+    if (SP == 0u) return 0u;
+
     SP -= 1u;
-    AssertStackInBounds(SP);
     return stack[SP];
 }
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Little-endian helpers for the save state and movie blobs
+
+struct ByteWriter {
+    std::vector<uint8_t>& blob;
+
+    void Bytes(const void* data, const size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        blob.insert(blob.end(), bytes, bytes + size);
+    }
+    void U8(const uint8_t value) { blob.push_back(value); }
+    void U16(const uint16_t value) {
+        U8(static_cast<uint8_t>(value));
+        U8(static_cast<uint8_t>(value >> 8));
+    }
+    void U32(const uint32_t value) {
+        U16(static_cast<uint16_t>(value));
+        U16(static_cast<uint16_t>(value >> 16));
+    }
+    void U64(const uint64_t value) {
+        U32(static_cast<uint32_t>(value));
+        U32(static_cast<uint32_t>(value >> 32));
+    }
+};
+
+// Callers check the size up front, so reads never run past the end
+struct ByteReader {
+    const uint8_t* data;
+
+    void Bytes(void* out, const size_t size) {
+        memcpy(out, data, size);
+        data += size;
+    }
+    uint8_t U8() { return *data++; }
+    uint16_t U16() {
+        const uint16_t low = U8();
+        return static_cast<uint16_t>(low | (U8() << 8));
+    }
+    uint32_t U32() {
+        const uint32_t low = U16();
+        return low | (static_cast<uint32_t>(U16()) << 16);
+    }
+    uint64_t U64() {
+        const uint64_t low = U32();
+        return low | (static_cast<uint64_t>(U32()) << 32);
+    }
+};
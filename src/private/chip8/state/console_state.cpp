@@ -0,0 +1,100 @@
+#include "chip8/state/console_state.h"
+
+#include <cstring>
+
+#include "chip8/cpu/quirks.h"
+#include "chip8/state/byte_stream.h"
+
+namespace {
+    // "C8ST", version, payload size, payload
+    const uint8_t Magic[4] = {'C', '8', 'S', 'T'};
+    constexpr size_t HeaderSize = sizeof(Magic) + 2u + 4u;
+
+    constexpr size_t PayloadSize = 8u                               // InstructionCount
+            + 8u * CHIP8_SCREEN_HEIGHT                              // ScreenRows
+            + 4u                                                    // RandomState
+            + 2u + 2u + 2u * CHIP8_MEMORY_STACK_SIZE                // I, PC, Stack
+            + CHIP8_DATA_REGISTERS_SIZE                             // V
+            + 9u                                                    // timers, SP, key wait, flags, quirks
+            + CHIP8_KEYS_SIZE                                       // Keys
+            + CHIP8_MEMORY_SIZE;                                    // Memory
+}
+
+void ConsoleState::Serialize(std::vector<uint8_t>& outBlob) const {
+    outBlob.reserve(outBlob.size() + HeaderSize + PayloadSize);
+
+    ByteWriter w {outBlob};
+    w.Bytes(Magic, sizeof(Magic));
+    w.U16(Version);
+    w.U32(static_cast<uint32_t>(PayloadSize));
+
+    w.U64(InstructionCount);
+    for (const uint64_t row : ScreenRows) {
+        w.U64(row);
+    }
+    w.U32(RandomState);
+    w.U16(I);
+    w.U16(PC);
+    for (const uint16_t entry : Stack) {
+        w.U16(entry);
+    }
+    w.Bytes(V, sizeof(V));
+    w.U8(Delay);
+    w.U8(Sound);
+    w.U8(SP);
+    w.U8(KeyWaitRegister);
+    w.U8(static_cast<uint8_t>(LatchedKey));
+    w.U8(Halted ? 1u : 0u);
+    w.U8(DrawFlag ? 1u : 0u);
+    w.U8(SoundFlag ? 1u : 0u);
+    w.U8(Quirks);
+    for (const bool key : Keys) {
+        w.U8(key ? 1u : 0u);
+    }
+    w.Bytes(Memory, sizeof(Memory));
+}
+
+bool ConsoleState::Deserialize(const uint8_t* blob, const size_t size) {
+    if (blob == nullptr || size != HeaderSize + PayloadSize) return false;
+    if (memcmp(blob, Magic, sizeof(Magic)) != 0) return false;
+
+    ByteReader r {blob + sizeof(Magic)};
+    if (r.U16() != Version) return false;
+    if (r.U32() != PayloadSize) return false;
+
+    ConsoleState state;
+    state.InstructionCount = r.U64();
+    for (uint64_t& row : state.ScreenRows) {
+        row = r.U64();
+    }
+    state.RandomState = r.U32();
+    state.I = r.U16();
+    state.PC = r.U16();
+    for (uint16_t& entry : state.Stack) {
+        entry = r.U16();
+    }
+    r.Bytes(state.V, sizeof(state.V));
+    state.Delay = r.U8();
+    state.Sound = r.U8();
+    state.SP = r.U8();
+    state.KeyWaitRegister = r.U8();
+    state.LatchedKey = static_cast<int8_t>(r.U8());
+    state.Halted = r.U8() != 0u;
+    state.DrawFlag = r.U8() != 0u;
+    state.SoundFlag = r.U8() != 0u;
+    state.Quirks = r.U8();
+    for (bool& key : state.Keys) {
+        key = r.U8() != 0u;
+    }
+    r.Bytes(state.Memory, sizeof(state.Memory));
+
+    // reject states the CPU could not continue from
+    if (state.SP > CHIP8_MEMORY_STACK_SIZE) return false;
+    if (state.KeyWaitRegister >= CHIP8_DATA_REGISTERS_SIZE) return false;
+    if (state.LatchedKey < -1 || state.LatchedKey >= CHIP8_KEYS_SIZE) return false;
+    if (state.RandomState == 0u) return false;
+    if ((state.Quirks & ~Quirk::All) != 0u) return false;
+
+    *this = state;
+    return true;
+}
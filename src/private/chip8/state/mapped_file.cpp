@@ -0,0 +1,71 @@
+#include "chip8/state/mapped_file.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const char* path) {
+    Close();
+
+#if defined(_WIN32)
+    const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // the view keeps the file open once both handles are closed
+    const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) return false;
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == nullptr) return false;
+
+    _data = static_cast<const uint8_t*>(data);
+    _size = static_cast<size_t>(size.QuadPart);
+#else
+    const int file = open(path, O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size <= 0) {
+        close(file);
+        return false;
+    }
+
+    // the mapping keeps the file open once the descriptor is closed
+    void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (data == MAP_FAILED) return false;
+
+    _data = static_cast<const uint8_t*>(data);
+    _size = static_cast<size_t>(status.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::Close() {
+    if (_data == nullptr) return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(_data);
+#else
+    munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+    _data = nullptr;
+    _size = 0u;
+}
@@ -0,0 +1,87 @@
+#include "chip8/state/movie.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "chip8/state/byte_stream.h"
+
+namespace {
+    // "C8MV", version, seed, cycles per frame, start state blob, frames
+    const uint8_t Magic[4] = {'C', '8', 'M', 'V'};
+    constexpr size_t HeaderSize = sizeof(Magic) + 2u + 4u + 4u;
+}
+
+void Movie::Serialize(std::vector<uint8_t>& outBlob) const {
+    ByteWriter w {outBlob};
+    w.Bytes(Magic, sizeof(Magic));
+    w.U16(Version);
+    w.U32(Seed);
+    w.U32(CyclesPerFrame);
+
+    // the state blob carries its own version and size
+    const size_t sizeOffset = outBlob.size();
+    w.U32(0u);
+    Start.Serialize(outBlob);
+    const uint32_t stateSize = static_cast<uint32_t>(outBlob.size() - sizeOffset - 4u);
+    for (uint32_t i = 0u; i < 4u; i++) {
+        outBlob[sizeOffset + i] = static_cast<uint8_t>(stateSize >> (8u * i));
+    }
+
+    w.U32(static_cast<uint32_t>(Frames.size()));
+    for (const uint16_t keys : Frames) {
+        w.U16(keys);
+    }
+}
+
+bool Movie::Deserialize(const uint8_t* blob, const size_t size) {
+    if (blob == nullptr || size < HeaderSize + 4u) return false;
+    if (memcmp(blob, Magic, sizeof(Magic)) != 0) return false;
+
+    ByteReader r {blob + sizeof(Magic)};
+    if (r.U16() != Version) return false;
+
+    Movie movie;
+    movie.Seed = r.U32();
+    movie.CyclesPerFrame = r.U32();
+
+    const size_t stateSize = r.U32();
+    if (stateSize > size - HeaderSize - 4u) return false;
+    if (!movie.Start.Deserialize(r.data, stateSize)) return false;
+    r.data += stateSize;
+
+    const size_t remaining = static_cast<size_t>(blob + size - r.data);
+    if (remaining < 4u) return false;
+    const size_t frameCount = r.U32();
+    if (frameCount * 2u != remaining - 4u) return false;
+
+    movie.Frames.resize(frameCount);
+    for (uint16_t& keys : movie.Frames) {
+        keys = r.U16();
+    }
+
+    *this = std::move(movie);
+    return true;
+}
+
+bool Movie::SaveToFile(const char* path) const {
+    std::vector<uint8_t> blob;
+    Serialize(blob);
+
+    std::ofstream stream(path, std::ios_base::binary);
+    if (!stream.good()) {
+        return false;
+    }
+    stream.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+    return stream.good();
+}
+
+bool Movie::LoadFromFile(const char* path) {
+    std::ifstream stream(path, std::ios_base::binary);
+    if (!stream.good()) {
+        return false;
+    }
+
+    const std::vector<uint8_t> blob((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    return Deserialize(blob.data(), blob.size());
+}
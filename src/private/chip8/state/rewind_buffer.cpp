@@ -0,0 +1,195 @@
+#include "chip8/state/rewind_buffer.h"
+
+#include <cassert>
+#include <cstring>
+
+// An entry is a list of runs over the bytes of (state XOR base):
+//   varint  number of unchanged bytes to skip
+//   varint  number of changed bytes that follow
+//   bytes   the XOR values
+// Unchanged bytes at the end are implicit. Keyframes use an all-zero base.
+
+namespace {
+    constexpr size_t StateSize = sizeof(ConsoleState);
+    // a changed run absorbs gaps shorter than this, a new run costs two varints
+    constexpr size_t MinGap = 4u;
+
+    const uint8_t ZeroState[StateSize] = {};
+
+    void WriteVarint(std::vector<uint8_t>& out, size_t value) {
+        while (value >= 0x80u) {
+            out.push_back(static_cast<uint8_t>(value | 0x80u));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    size_t ReadVarint(const uint8_t*& p) {
+        size_t value = 0u;
+        uint32_t shift = 0u;
+        while (*p & 0x80u) {
+            value |= static_cast<size_t>(*p++ & 0x7Fu) << shift;
+            shift += 7u;
+        }
+        value |= static_cast<size_t>(*p++) << shift;
+        return value;
+    }
+
+    uint64_t LoadWord(const uint8_t* p) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        return word;
+    }
+}
+
+RewindBuffer::RewindBuffer(const size_t capacityBytes, const uint32_t keyframeInterval)
+        : _data(capacityBytes), _keyframeInterval(keyframeInterval) {
+    // room for a couple of uncompressible keyframes
+    assert(capacityBytes >= 4u * StateSize);
+    assert(keyframeInterval > 0u);
+
+    _scratch.reserve(2u * StateSize);
+}
+
+void RewindBuffer::Push(const ConsoleState& state) {
+    const bool keyframe = _entries.empty() || _sinceKeyframe >= _keyframeInterval;
+    Encode(state, keyframe ? nullptr : &_keyframe);
+    Store(keyframe);
+
+    if (keyframe) {
+        _keyframe = state;
+        _sinceKeyframe = 0u;
+    } else {
+        _sinceKeyframe += 1u;
+    }
+}
+
+bool RewindBuffer::Pop(ConsoleState& outState) {
+    if (_entries.empty()) return false;
+
+    const Entry newest = _entries.back();
+    if (newest.keyframe) {
+        outState = _keyframe;
+    } else {
+        Decode(newest, &_keyframe, outState);
+    }
+
+    _entries.pop_back();
+    _usedBytes -= newest.size;
+    _writeOffset = newest.offset;
+
+    if (!newest.keyframe) {
+        _sinceKeyframe -= 1u;
+        return true;
+    }
+
+    // the older frames are deltas against the previous keyframe
+    for (size_t index = _entries.size(); index > 0u; index--) {
+        const Entry& entry = _entries[index - 1u];
+        if (entry.keyframe) {
+            Decode(entry, nullptr, _keyframe);
+            _sinceKeyframe = static_cast<uint32_t>(_entries.size() - index);
+            return true;
+        }
+    }
+
+    // only deltas whose keyframe was already dropped are left
+    Clear();
+    return true;
+}
+
+void RewindBuffer::Clear() {
+    _entries.clear();
+    _writeOffset = 0u;
+    _usedBytes = 0u;
+    _sinceKeyframe = 0u;
+}
+
+void RewindBuffer::Encode(const ConsoleState& state, const ConsoleState* base) {
+    const uint8_t* a = reinterpret_cast<const uint8_t*>(&state);
+    const uint8_t* b = (base != nullptr) ? reinterpret_cast<const uint8_t*>(base) : ZeroState;
+
+    _scratch.clear();
+
+    size_t position = 0u;
+    while (position < StateSize) {
+        const size_t skipStart = position;
+        while (position + 8u <= StateSize && LoadWord(a + position) == LoadWord(b + position)) {
+            position += 8u;
+        }
+        while (position < StateSize && a[position] == b[position]) {
+            position += 1u;
+        }
+        if (position == StateSize) break;
+
+        size_t lastChanged = position;
+        for (size_t scan = position + 1u; scan < StateSize && scan - lastChanged < MinGap; scan++) {
+            if (a[scan] != b[scan]) {
+                lastChanged = scan;
+            }
+        }
+
+        WriteVarint(_scratch, position - skipStart);
+        WriteVarint(_scratch, lastChanged + 1u - position);
+        for (; position <= lastChanged; position++) {
+            _scratch.push_back(a[position] ^ b[position]);
+        }
+    }
+}
+
+void RewindBuffer::Decode(const Entry& entry, const ConsoleState* base, ConsoleState& outState) const {
+    uint8_t* out = reinterpret_cast<uint8_t*>(&outState);
+    memcpy(out, (base != nullptr) ? static_cast<const void*>(base) : ZeroState, StateSize);
+
+    const uint8_t* p = &_data[entry.offset];
+    const uint8_t* end = p + entry.size;
+    size_t position = 0u;
+    while (p < end) {
+        position += ReadVarint(p);
+        const size_t count = ReadVarint(p);
+        assert(position + count <= StateSize);
+        for (size_t i = 0u; i < count; i++) {
+            out[position + i] ^= p[i];
+        }
+        p += count;
+        position += count;
+    }
+}
+
+void RewindBuffer::Store(const bool keyframe) {
+    const size_t size = _scratch.size();
+    assert(size <= _data.size());
+
+    if (_writeOffset + size > _data.size()) {
+        // the entries between here and the end of the ring are the oldest
+        while (!_entries.empty() && _entries.front().offset >= _writeOffset) {
+            DropOldest();
+        }
+        _writeOffset = 0u;
+    }
+
+    while (!_entries.empty()) {
+        const Entry& oldest = _entries.front();
+        const bool overlaps = oldest.offset < _writeOffset + size && oldest.offset + oldest.size > _writeOffset;
+        if (!overlaps) break;
+        DropOldest();
+    }
+
+    if (size > 0u) {
+        memcpy(&_data[_writeOffset], _scratch.data(), size);
+    }
+    _entries.push_back({_writeOffset, static_cast<uint32_t>(size), keyframe});
+    _writeOffset += size;
+    _usedBytes += size;
+}
+
+void RewindBuffer::DropOldest() {
+    _usedBytes -= _entries.front().size;
+    _entries.pop_front();
+
+    // deltas cannot be decoded without their keyframe
+    while (!_entries.empty() && !_entries.front().keyframe) {
+        _usedBytes -= _entries.front().size;
+        _entries.pop_front();
+    }
+}
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <cstdint>
-#include <functional>
 
 #include "chip8/constants.h"
 
@@ -11,8 +10,19 @@ struct Keyboard
     void SetKeyUp(int vKey);
     bool IsKeyDown(int vKey) const;
 
-    std::function<const void(uint8_t)> OnKeyDownEvent = nullptr;
+    // All keys as a bit mask, bit k set while key k is down
+    uint16_t GetKeyMask() const;
+    // Presses and releases whatever differs from `mask`
+    void SetKeyMask(uint16_t mask);
+
+    // First key pressed since the last ClearLatch(), -1 if none; this is how
+    // a CPU waiting on Fx0A learns about the key press
+    int GetLatchedKey() const;
+    void ClearLatch();
 
 private:
+    friend struct Console;
+
     bool _keyboard[CHIP8_KEYS_SIZE] {};
+    int8_t _latchedKey = -1;
 };
@@ -4,13 +4,46 @@
 
 #include "chip8/constants.h"
 
+// Region of the screen, in pixels
+struct DamageRect
+{
+    uint32_t X = 0u;
+    uint32_t Y = 0u;
+    uint32_t Width = 0u;
+    uint32_t Height = 0u;
+};
+
 struct Screen
 {
-    bool Pixels[CHIP8_SCREEN_HEIGHT][CHIP8_SCREEN_WIDTH] {};
-    bool Dirty = false;
+    // One word per row; the leftmost pixel (x = 0) is the most significant bit
+    uint64_t Rows[CHIP8_SCREEN_HEIGHT] {};
+
+    // Changes since the last ClearDirty(): bit y of DirtyRows is set when row
+    // y changed, and DirtyPixels[y] holds the pixels that flipped in it
+    // (same layout as Rows). Consumers clear it once they have caught up.
+    uint32_t DirtyRows = 0u;
+    uint64_t DirtyPixels[CHIP8_SCREEN_HEIGHT] {};
 
     void Clear();
     void Set(uint32_t x, uint32_t y);
     bool IsSet(uint32_t x, uint32_t y) const;
+    // XORs the sprite in and returns true if it turned off any pixel. The
+    // position wraps around the screen; with Clip the pixels going past the
+    // right or bottom edge are dropped, otherwise they wrap around as well.
+    // Instantiated for both in screen.cpp.
+    template <bool Clip = false>
     bool DrawSprite(uint32_t x, uint32_t y, const uint8_t* sprite, int numBytes);
+
+    bool IsDirty() const { return DirtyRows != 0u; }
+    void ClearDirty();
+    // Everything has to be redrawn, e.g. after a state was loaded
+    void MarkAllDirty();
+
+    // Bounding boxes of the dirty pixels, one per run of consecutive dirty
+    // rows. If there are more runs than maxRects, the last rectangle covers
+    // the remaining ones. Returns the number of rectangles written.
+    uint32_t GetDamage(DamageRect* outRects, uint32_t maxRects) const;
+
+    // FNV-1a over the rows, for comparing frames across runs
+    uint64_t Hash() const;
 };
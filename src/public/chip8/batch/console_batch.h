@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "chip8/constants.h"
+#include "chip8/cartridge/cartridge.h"
+#include "chip8/cpu/idle_loop.h"
+#include "chip8/cpu/random.h"
+#include "chip8/IO/screen.h"
+
+// Runs many consoles side by side, with their state kept in
+// structure-of-arrays form: register Vx of every instance lives in one
+// contiguous array, and so do the PCs, timers and stack levels.
+//
+// Every cycle the instances are grouped by the opcode they are about to
+// execute. Large enough groups of ALU opcodes (6xkk, 7xkk, 8xy*), skips
+// (3xkk, 4xkk, 5xy0, 9xy0, Ex9E, ExA1), jumps and I/timer loads run as
+// masked SIMD kernels over all instances at once; everything else runs
+// through a scalar interpreter, one instance at a time. The result is identical to running each
+// instance in its own Console with the switch interpreter and no quirks (see
+// Quirk); ROM profiles are not applied.
+class ConsoleBatch {
+public:
+    // Instance n seeds its RND generator with seed + n
+    explicit ConsoleBatch(uint32_t size, uint32_t seed = 0u);
+
+    // Loads the same cartridge into every instance, resetting their memory.
+    // Instances then share one copy of the code until they write to it.
+    void InsertCartridge(const Cartridge& cartridge);
+    void InsertCartridge(uint32_t index, const Cartridge& cartridge);
+
+    // Runs Settings.CyclesPerFrame instructions on every running instance,
+    // then ticks their timers. Mirrors Console::Cycle.
+    void Cycle();
+
+    void SetKeyDown(uint32_t index, int vKey);
+    void SetKeyUp(uint32_t index, int vKey);
+
+    uint32_t GetSize() const { return _size; }
+
+    uint8_t GetV(uint32_t index, uint8_t x) const;
+    uint16_t GetI(uint32_t index) const;
+    uint16_t GetPC(uint32_t index) const;
+    uint8_t GetDelay(uint32_t index) const;
+    uint8_t GetSound(uint32_t index) const;
+    bool IsHalted(uint32_t index) const;
+    bool IsSoundOn(uint32_t index) const;
+    const Screen& GetScreen(uint32_t index) const;
+
+    CpuSettings Settings {};
+
+    // Totals over every instance since construction
+    uint64_t InstructionCount = 0u;
+    // Part of InstructionCount that ran in the SIMD kernels
+    uint64_t VectorInstructionCount = 0u;
+    // Part of InstructionCount skipped over in idle loops
+    uint64_t IdleInstructionCount = 0u;
+
+private:
+    uint32_t Fetch(uint32_t cycle);
+    void RunGroups();
+    void ExecScalar(uint32_t index, uint16_t code);
+    // Console::Cycle's idle loop check, for one instance at the start of a
+    // frame. Returns the instructions done, see CPU::SkipIdleLoop.
+    uint32_t SkipIdleLoop(uint32_t index);
+    void RunVectorGroup(uint16_t code);
+
+    uint8_t* V(uint8_t x) { return &_v[x * _stride]; }
+    uint8_t* Key(uint8_t key) { return &_keys[key * _stride]; }
+    uint8_t* InstanceMemory(uint32_t index) { return &_memory[static_cast<size_t>(index) * MemoryStride]; }
+
+    // Memories are padded by a cache line each: with a 4 KiB stride the same
+    // address in every instance would map to the same cache set
+    static constexpr uint32_t MemoryStride = CHIP8_MEMORY_SIZE + 64u;
+
+    uint32_t _size = 0u;
+    // _size rounded up to the widest SIMD kernel, padding lanes never run
+    uint32_t _stride = 0u;
+
+    std::vector<uint8_t> _v;        // [16][_stride]
+    std::vector<uint16_t> _i;
+    std::vector<uint16_t> _pc;
+    std::vector<uint8_t> _delay;
+    std::vector<uint8_t> _sound;
+    std::vector<uint8_t> _sp;
+    std::vector<uint16_t> _stack;   // [CHIP8_MEMORY_STACK_SIZE][_stride]
+    std::vector<uint8_t> _keys;     // [CHIP8_KEYS_SIZE][_stride], 0xFF while down
+    std::vector<Random> _random;
+    std::vector<uint8_t> _halted;
+    std::vector<uint8_t> _keyWaitRegister;
+    std::vector<uint8_t> _soundOn;
+    std::vector<uint8_t> _memory;   // [_size][MemoryStride]
+    std::vector<Screen> _screens;
+
+    // Opcodes are fetched from one shared, pre-assembled copy of memory
+    // while an instance has not written to the 256-byte page they live in,
+    // which keeps the fetch loop in cache. The bitmask holds the pages an
+    // instance owns.
+    uint8_t _image[CHIP8_MEMORY_SIZE] {};
+    uint16_t _imageOpcodes[CHIP8_MEMORY_SIZE] {};
+    std::vector<uint16_t> _privatePages;
+
+    // Per-cycle scratch: the opcode each instance is about to run, 0xFF for
+    // the instances still running in the current frame, and 0xFF for the
+    // ones whose opcode has not been executed yet in the current cycle
+    std::vector<uint16_t> _opcode;
+    std::vector<uint8_t> _running;
+    std::vector<uint8_t> _pending;
+
+    // Per-frame: how many cycles each instance still runs in lockstep, fewer
+    // than Settings.CyclesPerFrame once the idle loop check stepped some
+    std::vector<uint32_t> _frameCycles;
+    std::vector<IdleLoop::Backoff> _idleBackoff;
+
+    // Instances per opcode value in the current cycle
+    std::vector<uint32_t> _groupCount;
+    std::vector<uint16_t> _groups;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 struct Cartridge {
@@ -9,5 +10,9 @@ struct Cartridge {
 
     ~Cartridge();
 
+    bool loadFromFile(char* path);
     void clear();
+
+    // FNV-1a over the contents, identifies the ROM whatever its file name
+    uint64_t hash() const;
 };
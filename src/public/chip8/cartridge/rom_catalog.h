@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "chip8/constants.h"
+#include "chip8/cpu/cpu.h"
+#include "chip8/cpu/quirks.h"
+
+// Everything learned about one ROM: the settings it plays best with and what
+// earlier runs found out about its code
+struct RomEntry {
+    uint64_t Hash = 0u; // Cartridge::hash()
+    size_t Size = 0u;   // checked along with the hash, so a collision needs the same length too
+    std::string Name;
+
+    uint32_t CyclesPerFrame = 0u; // 0 keeps the console setting
+    uint8_t Quirks = Quirk::None;
+    // Pad key i presses CHIP-8 key KeyMap[i]
+    uint8_t KeyMap[CHIP8_KEYS_SIZE] = {0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0x8, 0x9, 0xA, 0xB, 0xC, 0xD, 0xE, 0xF};
+
+    // Addresses of the opcodes decoded or translated, and of the spin loops skipped
+    AddressSet Code {};
+    AddressSet IdleLoops {};
+};
+
+// Small on-disk database of RomEntry, keyed by the hash of the ROM contents.
+// It is a text file, one "[rom <hash>]" section per ROM:
+//
+//   version = 1
+//
+//   [rom 25e96e1086ce43cb]
+//   name = maze
+//   size = 34
+//   cycles-per-frame = 10
+//   quirks = none
+//   keys = 0123456789abcdef
+//   idle-loops = 21a-21e
+//   code = 200-222
+//
+// Address lists are ranges of opcodes "first-last", both included and two
+// bytes apart. Unknown keys are skipped, so older builds can read newer files.
+class RomCatalog {
+public:
+    // Bumped whenever the meaning of a key changes
+    static constexpr uint32_t Version = 1u;
+
+    // The entry of this ROM, or nullptr if it has none
+    const RomEntry* Find(uint64_t hash, size_t size) const;
+    // The entry of this ROM, added with default settings if it has none
+    RomEntry& Get(uint64_t hash, size_t size);
+
+    const std::map<uint64_t, RomEntry>& GetEntries() const { return _entries; }
+
+    bool SaveToFile(const char* path) const;
+    // A missing file loads as an empty catalog; a malformed one fails
+    bool LoadFromFile(const char* path);
+
+private:
+    std::map<uint64_t, RomEntry> _entries;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+#include "chip8/cpu/quirks.h"
+
+// What a known ROM expects from the interpreter, looked up by the hash of its
+// contents when the cartridge is inserted
+struct RomProfile {
+    uint64_t Hash = 0u; // Cartridge::hash()
+    const char* Name = nullptr;
+    uint8_t Quirks = Quirk::None;
+
+    // The profile of the ROM with this hash, or nullptr for an unknown ROM
+    static const RomProfile* Find(uint64_t hash);
+};
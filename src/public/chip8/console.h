@@ -9,18 +9,45 @@
 #include "chip8/memory/stack.h"
 #include "chip8/IO/keyboard.h"
 #include "chip8/IO/screen.h"
+#include "chip8/state/console_state.h"
+
+struct RomEntry;
 
 struct Console
 {
     Console();
 
     void LoadDefaultCharacterSet();
+    // Also sets the CPU quirks from the RomProfile of the cartridge (none for
+    // an unknown ROM); call Cpu.SetQuirks() afterwards to override them
     void InsertCartridge(const Cartridge& outCartridge);
     void Cycle();
 
+    // Takes the settings of a RomCatalog entry, after InsertCartridge: the
+    // cycles per frame, the quirks, the code to decode ahead of time and the
+    // known idle loops. The key map is left to the client.
+    void Apply(const RomEntry& entry);
+    // Adds the code run and the idle loops found so far to the entry
+    void Analyze(RomEntry& outEntry) const;
+
+    // Snapshot / restore through a flat ConsoleState. Loading only rewrites
+    // (and invalidates the decoded code of) the memory chunks that differ,
+    // and switches the CPU to the quirks of the state.
+    void SaveState(ConsoleState& outState) const;
+    void LoadState(const ConsoleState& state);
+
+    // Same, through the versioned blob of ConsoleState::Serialize
+    void SaveState(std::vector<uint8_t>& outBlob) const;
+    bool LoadState(const uint8_t* blob, size_t size);
+
+    // Sprites for the hex digits 0-F, loaded at CHIP8_MEMORY_ADDRESS_CHARACTER_SET
+    static const uint8_t DefaultCharacterSet[16 * CHIP8_DEFAULT_SPRITE_HEIGHT];
+
     Memory Memory {};
     Stack Stack {};
     Keyboard Keyboard {};
     Screen Screen {};
     CPU Cpu {};
+
+    CpuSettings Settings {};
 };
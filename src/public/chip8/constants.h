@@ -27,9 +27,20 @@ namespace Config {
     namespace Cpu {
         extern uint32_t CyclesPerFrame;
         extern double FrameTime;
+        extern bool SkipIdleLoops;
     }
     namespace Screen {
         extern uint32_t SizeMultiplier;
         extern uint32_t Padding;
     }
 }
+
+// Per-console copy of the Config::Cpu settings, taken when the console is
+// created, so consoles running at different speeds can share a process
+struct CpuSettings {
+    uint32_t CyclesPerFrame = Config::Cpu::CyclesPerFrame;
+    double FrameTime = Config::Cpu::FrameTime;
+    // Count frames spent in spin loops instead of running them (see
+    // CPU::SkipIdleLoop); the results are the same either way
+    bool SkipIdleLoops = Config::Cpu::SkipIdleLoops;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct CPU;
+
+// The decoded opcodes and the Jit blocks of one ROM, kept in a file so the
+// next process running the ROM installs them instead of decoding and
+// translating it again. The file is keyed by the ROM hash, the quirks and
+// EngineVersion; a stale one is ignored. Everything is checked against the
+// memory it came from before it is installed, so code the ROM rewrote at
+// runtime is left to be translated again. The file holds no native code: the
+// Jit blocks are kept as the addresses and memory they cover and translated
+// again at install.
+struct CodeCache {
+    // Bumped whenever the layout of the file changes
+    static constexpr uint16_t Version = 2u;
+    // Bumped whenever the decoder or the code the Jit emits changes
+    static constexpr uint16_t EngineVersion = 1u;
+
+    // What the last Install put in place
+    uint32_t Opcodes = 0u;
+    uint32_t Blocks = 0u;
+
+    static void Serialize(const CPU& cpu, uint64_t romHash, std::vector<uint8_t>& outBlob);
+    // Installs a blob into the decode cache and, with the Jit engine, the Jit
+    // of `cpu`; call after the cartridge is inserted and the quirks are set.
+    // Returns false for a blob of another ROM, quirk set or engine version.
+    bool Install(CPU& cpu, uint64_t romHash, const uint8_t* blob, size_t size);
+
+    // Written to a temporary file first, so readers never see half of one
+    static bool SaveToFile(const CPU& cpu, uint64_t romHash, const char* path);
+    static bool SaveToFile(const std::vector<uint8_t>& blob, const char* path);
+    // Maps the file for as long as it takes to install it
+    bool LoadFromFile(CPU& cpu, uint64_t romHash, const char* path);
+};
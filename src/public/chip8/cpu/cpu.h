@@ -1,13 +1,39 @@
 #pragma once
 
+#include <bitset>
+#include <memory>
+
 #include "opcode.h"
+#include "decode_cache.h"
+#include "idle_loop.h"
+#include "quirks.h"
+#include "random.h"
 #include "chip8/constants.h"
 #include "chip8/IO/keyboard.h"
 #include "chip8/IO/screen.h"
 #include "chip8/memory/memory.h"
 #include "chip8/memory/stack.h"
 
-struct CPU {
+// Interchangeable interpreters; all of them must produce the same results
+enum class CpuEngine : uint8_t {
+    Switch,   // reads every opcode from memory and runs it through CPU::Exec
+    Cached,   // runs pre-decoded opcodes from the decode cache
+    Threaded, // decode cache with computed-goto dispatch (falls back to Cached)
+    Jit,      // basic blocks recompiled to x86-64 (falls back to Threaded)
+};
+
+// One bit per memory address
+using AddressSet = std::bitset<CHIP8_MEMORY_SIZE>;
+
+class Jit;
+class FlightRecorder;
+struct CpuProfile;
+enum class TraceReason : uint8_t;
+
+struct CPU : MemoryObserver {
+    CPU();
+    ~CPU();
+
     void Init(Memory* memory, Stack* stack, Screen* Screen, Keyboard* keyboard);
     uint16_t ReadNextOpcode();
     void ExecNextOpcode();
@@ -15,7 +41,57 @@ struct CPU {
     void UpdateTimers();
     void SkipNextBytes(uint16_t num);
 
+    // Executes up to `count` opcodes with the selected engine, stopping early
+    // if the CPU halts. Returns the number of opcodes executed.
+    uint32_t Run(uint32_t count);
+
+    // Ends a Fx0A wait if a key has been pressed since it started. Returns
+    // false while the CPU is still halted.
+    bool ResumeFromKeyWait();
+
+    // Called at the start of a frame of `count` instructions: if PC is in a
+    // spin loop that can't end before the next timer tick or key change (see
+    // IdleLoop), the rest of the frame is counted without being run. Returns
+    // the number of instructions done, which is less than `count` when the
+    // loop is not idle; the caller runs the rest as usual.
+    uint32_t SkipIdleLoop(uint32_t count);
+
+    // Addresses of the opcodes of every spin loop skipped so far. A frame
+    // starting on one of them looks for the loop right away instead of
+    // waiting out the backoff; the loop is still checked before skipping.
+    AddressSet IdleLoopAddresses {};
+
+    // Adds the address of every opcode decoded or translated so far
+    void CollectCode(AddressSet& outCode) const;
+    // Decodes the opcodes at these addresses ahead of time
+    void Predecode(const AddressSet& code);
+
+    // Switches the interpreters to the ones built for `quirks` (see Quirk).
+    // Drops every decoded and translated opcode, as they have them built in.
+    void SetQuirks(uint8_t quirks);
+    uint8_t GetQuirks() const { return _quirks; }
+
+    void OnMemoryWrite(uint16_t address, size_t size) override;
+    void OnMemoryFault(uint16_t address) override;
+
+    CpuEngine Engine = CpuEngine::Cached;
+
+    // With the Jit engine, re-runs every translated block through CPU::Exec
+    // and reports any difference in V, I, PC, SP or the screen
+    bool JitLockstep = false;
+    uint64_t LockstepMismatches = 0u;
+
+    // Records every instruction while set; every engine then runs as Cached
+    // with a recording step. Faults are reported to it. Not owned.
+    FlightRecorder* Recorder = nullptr;
+
+    // Filled while set, in builds with CHIP8_PROFILE (the Jit engine then
+    // runs the Threaded one, translated blocks can't be counted); not owned
+    CpuProfile* Profile = nullptr;
+
+    // Set by Fx0A until a key is pressed; the key goes to V[KeyWaitRegister]
     bool Halted = false;
+    uint8_t KeyWaitRegister = 0u;
 
     struct {
         bool Draw = false;
@@ -31,14 +107,72 @@ struct CPU {
     uint16_t I = 0u;
     uint16_t PC = 0u;
 
+    // Number of instructions executed since power-on
+    uint64_t InstructionCount = 0u;
+    // Part of InstructionCount skipped over in idle loops
+    uint64_t IdleInstructionCount = 0u;
+    // Bumped on every memory write, so code built from memory outside the
+    // CPU (see chip8_aot) knows when to check it against memory again
+    uint64_t MemoryWriteCount = 0u;
+
+    // Source of RND (Cxkk)
+    Random Rng {};
+
 private:
-    void ExecExtended(const Opcode& opcode);
-    void ExecExtended_8(const Opcode& opcode);
-    void ExecExtended_F(const Opcode& opcode);
+    struct Ops;
+    template <typename Policy> struct QuirkOps;
+    friend class Jit;
+    friend class FlightRecorder;
+    friend struct CodeCache;
+
+    // Exec, RunSwitch and RunThreaded pick the instance for _quirks once per
+    // call; the opcodes in between run without looking at it again
+    template <typename Policy> void ExecWith(uint16_t code);
+    template <typename Policy> void ExecExtended(const Opcode& opcode);
+    template <typename Policy> void ExecExtended_8(const Opcode& opcode);
+    template <typename Policy> void ExecExtended_F(const Opcode& opcode);
+
+    uint32_t RunSwitch(uint32_t count);
+    template <typename Policy> uint32_t RunSwitchWith(uint32_t count);
+    uint32_t RunCached(uint32_t count);
+    uint32_t RunThreaded(uint32_t count);
+    template <typename Policy> uint32_t RunThreadedWith(uint32_t count);
+    uint32_t RunJit(uint32_t count);
+    uint32_t RunRecorded(uint32_t count);
+
+    // Hands a detected fault to the Recorder, if there is one
+    void Fault(TraceReason reason, uint16_t address);
+
+    static OpId DecodeOp(uint16_t code);
+    // The handler is the one of QuirkOps for `quirks`
+    static DecodedOpcode Decode(uint16_t code, uint8_t quirks);
+    // Same, for an opcode DecodeOp already identified as `op`
+    static DecodedOpcode Decode(uint16_t code, OpId op, uint8_t quirks);
+    const DecodedOpcode& FetchDecoded(uint16_t address);
+    // The miss path of FetchDecoded, kept out of line so the interpreter
+    // loops of every QuirkPolicy can afford to inline the hit path
+    void DecodeAt(uint16_t address, DecodedOpcode& outEntry);
+    // Marks a decoded entry as the start of a superinstruction if the
+    // opcodes after it in memory complete one: [6xkk][6ykk], [Annn][Dxyn],
+    // [Fx07][3x00][1nnn], [Fx33][Fy65] and [7xkk][3xkk][1nnn]. Entries in the
+    // middle of a sequence stay single opcodes, so jumping there is safe.
+    void Fuse(uint16_t address, DecodedOpcode& entry) const;
+    // Whether the interpreters may run the sequence `opcode` starts as a
+    // whole with `left` instructions to go
+    bool CanRunFused(const DecodedOpcode& opcode, uint32_t left) const;
+    // Runs the sequence (PC past its first opcode) and returns its length
+    uint32_t RunFused(const DecodedOpcode& opcode);
 
     // Hardware components
     Keyboard* _keyboard = nullptr;
     Screen* _screen = nullptr;
     Memory* _memory = nullptr;
     Stack* _stack = nullptr;
+
+    DecodeCache _decodeCache {};
+    std::unique_ptr<Jit> _jit;
+
+    IdleLoop::Backoff _idleBackoff {};
+
+    uint8_t _quirks = Quirk::None;
 };
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "chip8/constants.h"
+
+struct CPU;
+struct DecodedOpcode;
+
+using OpcodeHandler = void (*)(CPU& cpu, const DecodedOpcode& opcode);
+
+// Every opcode the decoder can produce, in handler table order
+#define CHIP8_OPCODE_LIST(OP) \
+    OP(Nop)     \
+    OP(Cls)     \
+    OP(Ret)     \
+    OP(Jp)      \
+    OP(Call)    \
+    OP(SeByte)  \
+    OP(SneByte) \
+    OP(SeReg)   \
+    OP(LdByte)  \
+    OP(AddByte) \
+    OP(LdReg)   \
+    OP(Or)      \
+    OP(And)     \
+    OP(Xor)     \
+    OP(AddReg)  \
+    OP(Sub)     \
+    OP(Shr)     \
+    OP(Subn)    \
+    OP(Shl)     \
+    OP(SneReg)  \
+    OP(LdI)     \
+    OP(JpV0)    \
+    OP(Rnd)     \
+    OP(Drw)     \
+    OP(Skp)     \
+    OP(Sknp)    \
+    OP(LdVxDt)  \
+    OP(LdVxK)   \
+    OP(LdDtVx)  \
+    OP(LdStVx)  \
+    OP(AddIVx)  \
+    OP(LdFVx)   \
+    OP(LdBVx)   \
+    OP(LdIVx)   \
+    OP(LdVxI)
+
+enum class OpId : uint8_t {
+#define CHIP8_OPCODE_ENUM(name) name,
+    CHIP8_OPCODE_LIST(CHIP8_OPCODE_ENUM)
+#undef CHIP8_OPCODE_ENUM
+    Count
+};
+
+// An opcode with its handler resolved and its operands already extracted.
+//
+// When the opcode starts one of the sequences the decoder fuses into a
+// superinstruction (see CPU::Fuse), FusedLength is the number of opcodes in
+// it and the operands of the ones after the first are packed into the fields
+// the first one doesn't read. Op and Handler still run the first opcode
+// alone, for whoever can't run the whole sequence at once.
+struct DecodedOpcode {
+    OpcodeHandler Handler = nullptr; // nullptr while the slot hasn't been decoded
+    uint16_t NNN = 0u;
+    uint8_t X = 0u;
+    uint8_t Y = 0u;
+    uint8_t N = 0u;
+    uint8_t KK = 0u;
+    OpId Op = OpId::Nop;
+    uint8_t FusedLength = 0u;
+};
+
+// One slot per memory address, filled lazily the first time an address is
+// executed and dropped again when the memory backing it is overwritten.
+class DecodeCache {
+    DecodedOpcode _entries[CHIP8_MEMORY_SIZE] {};
+
+public:
+    // The longest sequence fused into one entry, in opcodes
+    static constexpr size_t MaxFusedLength = 3u;
+
+    DecodedOpcode& Get(uint16_t address) { return _entries[address & (CHIP8_MEMORY_SIZE - 1u)]; }
+    const DecodedOpcode& Get(uint16_t address) const { return _entries[address & (CHIP8_MEMORY_SIZE - 1u)]; }
+    bool IsDecoded(uint16_t address) const { return _entries[address & (CHIP8_MEMORY_SIZE - 1u)].Handler != nullptr; }
+
+    void Invalidate(uint16_t address, size_t size);
+    void Clear();
+};
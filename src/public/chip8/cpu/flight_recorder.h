@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "cpu.h"
+#include "chip8/constants.h"
+
+// Why a trace was dumped
+enum class TraceReason : uint8_t {
+    OnDemand,
+    StackOverflow,    // CALL with a full stack
+    StackUnderflow,   // RET with an empty stack
+    MemoryOutOfRange, // read or write past the end of memory
+    KeyWait,          // Fx0A halted with no input left to end it
+    Count
+};
+
+// One executed instruction, recorded before it ran
+struct TraceEntry {
+    uint16_t PC;
+    uint16_t Opcode;
+    uint16_t I;
+    uint8_t SP;
+    uint8_t Delay;
+    // Hash of V0-VF, enough to tell where the registers first diverge
+    uint32_t Digest;
+};
+static_assert(sizeof(TraceEntry) == 12, "TraceEntry is written to disk as is");
+
+// A trace as written to disk: the last instructions, oldest first, and the
+// registers and stack at the moment of the dump
+struct TraceDump {
+    // Bumped whenever the blob layout written by Serialize changes
+    static constexpr uint16_t Version = 1u;
+
+    TraceReason Reason = TraceReason::OnDemand;
+    // address of the faulting access, or the PC of the faulting opcode
+    uint16_t FaultAddress = 0u;
+    // instructions recorded in all; Entries are the last of them
+    uint64_t RecordedCount = 0u;
+
+    uint16_t PC = 0u;
+    uint16_t I = 0u;
+    uint8_t SP = 0u;
+    uint8_t Delay = 0u;
+    uint8_t Sound = 0u;
+    uint8_t V[CHIP8_DATA_REGISTERS_SIZE] {};
+    uint16_t Stack[CHIP8_MEMORY_STACK_SIZE] {};
+
+    std::vector<TraceEntry> Entries;
+
+    void Serialize(std::vector<uint8_t>& outBlob) const;
+    bool Deserialize(const uint8_t* blob, size_t size);
+
+    bool SaveToFile(const char* path) const;
+    bool LoadFromFile(const char* path);
+
+    static const char* GetReasonName(TraceReason reason);
+};
+
+// Fixed-size history of the last executed instructions. While a CPU points
+// CPU::Recorder at it every instruction is recorded (a few ns each, nothing is
+// allocated after construction). Faults the CPU detects are dumped to
+// AutoDumpPath; Capture dumps on demand.
+class FlightRecorder {
+public:
+    // `capacity` is rounded up to a power of two
+    explicit FlightRecorder(size_t capacity = 4096u);
+
+    void Record(const CPU& cpu, const uint16_t code) {
+        TraceEntry& entry = _entries[static_cast<size_t>(_recorded) & _mask];
+        entry.PC = cpu.PC;
+        entry.Opcode = code;
+        entry.I = cpu.I;
+        entry.SP = cpu._stack->SP;
+        entry.Delay = cpu.Delay;
+        entry.Digest = Digest(cpu.V);
+        _recorded += 1u;
+    }
+
+    // Copies the history and the current registers of `cpu`
+    void Capture(const CPU& cpu, TraceReason reason, uint16_t faultAddress, TraceDump& outDump) const;
+
+    // Called by the CPU. The first fault is captured into LastFault and
+    // written to AutoDumpPath (if set); later ones are only counted.
+    void OnFault(const CPU& cpu, TraceReason reason, uint16_t faultAddress);
+
+    void Clear();
+
+    size_t GetCapacity() const { return _entries.size(); }
+    uint64_t GetRecordedCount() const { return _recorded; }
+
+    static uint32_t Digest(const uint8_t (&v)[CHIP8_DATA_REGISTERS_SIZE]) {
+        uint64_t low;
+        uint64_t high;
+        memcpy(&low, &v[0], sizeof(low));
+        memcpy(&high, &v[8], sizeof(high));
+        const uint64_t mixed = (low ^ ((high << 29) | (high >> 35))) * 0x9E3779B97F4A7C15ull;
+        return static_cast<uint32_t>(mixed >> 32);
+    }
+
+    // Where the first fault is written; nullptr keeps it in LastFault only
+    const char* AutoDumpPath = nullptr;
+
+    uint64_t FaultCount = 0u;
+    TraceDump LastFault {};
+
+private:
+    std::vector<TraceEntry> _entries;
+    size_t _mask = 0u;
+    uint64_t _recorded = 0u;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "chip8/constants.h"
+
+// Spin loops: a backward 1nnn closing a few opcodes that only read
+// registers, memory, the delay timer and the keys, e.g. Fx07/3xkk/1nnn
+// polling the delay timer or a 1nnn jumping to itself. Within a frame
+// neither the timers nor the keys change, so once a lap of such a loop ends
+// with the registers it started with, every later lap does the same until
+// the frame ends.
+struct IdleLoop {
+    // Longest loop looked for, in opcodes
+    static constexpr uint32_t MaxLength = 8u;
+
+    uint16_t Top = 0u; // target of the backward jump
+    uint16_t End = 0u; // address of the backward jump
+
+    // Frames to wait before looking for a loop again. Every frame that does
+    // not end up skipped doubles the wait, up to MaxWait, so code that never
+    // spins hardly pays for the lookup; a skipped frame resets it.
+    struct Backoff {
+        static constexpr uint8_t MaxWait = 16u;
+
+        uint8_t Wait = 0u;
+        uint8_t Length = 0u;
+
+        bool ShouldCheck() {
+            if (Wait == 0u) return true;
+            Wait -= 1u;
+            return false;
+        }
+        void Miss() {
+            Length = (Length == 0u) ? 1u : ((Length < MaxWait / 2u) ? Length * 2u : MaxWait);
+            Wait = Length;
+        }
+        void Hit() {
+            Length = 0u;
+        }
+    };
+
+    // What a lap may change; PC is back at Top after every lap
+    struct State {
+        uint8_t V[CHIP8_DATA_REGISTERS_SIZE];
+        uint16_t I;
+
+        bool operator==(const State& other) const {
+            return I == other.I && memcmp(V, other.V, sizeof(V)) == 0;
+        }
+    };
+
+    // Finds a loop through `pc` made of side-effect-free opcodes only
+    static bool Find(const uint8_t* memory, uint16_t pc, IdleLoop& outLoop);
+
+    // Opcodes that write nothing but V and I, and read nothing that can
+    // change during a frame (1nnn is only allowed as the closing jump)
+    static bool IsSideEffectFree(uint16_t code);
+
+    // Runs the loop at the start of a frame of `count` instructions. `step`
+    // executes the next instruction and returns the new PC, `capture` copies
+    // the registers. Two laps are stepped; if the second one ends where the
+    // first did, the remaining whole laps are only counted (outSkipped) and
+    // the last partial lap is stepped, leaving the CPU exactly where running
+    // them would have. Returns the number of instructions stepped, less than
+    // count - outSkipped when the loop was left or is not idle.
+    template <typename Step, typename Capture>
+    uint32_t Run(uint16_t pc, uint32_t count, Step step, Capture capture, uint32_t& outSkipped) const {
+        outSkipped = 0u;
+
+        State first {};
+        State second {};
+        uint32_t executed = 0u;
+        uint32_t lap = 0u;
+        uint32_t laps = 0u;
+        while (laps < 2u) {
+            if (executed == count) return executed;
+
+            const uint16_t from = pc;
+            pc = step();
+            executed += 1u;
+            lap += 1u;
+
+            if (pc < Top || pc > End) return executed;
+            if (from != End) continue;
+
+            // back at the top
+            laps += 1u;
+            if (laps == 1u) {
+                capture(first);
+                lap = 0u;
+            } else {
+                capture(second);
+            }
+        }
+
+        if (!(first == second)) return executed;
+
+        const uint32_t remaining = count - executed;
+        outSkipped = remaining - remaining % lap;
+        for (uint32_t i = 0u; i < remaining % lap; i++) {
+            step();
+            executed += 1u;
+        }
+        return executed;
+    }
+};
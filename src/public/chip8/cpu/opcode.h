@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 struct Opcode {
@@ -12,4 +13,7 @@ struct Opcode {
     uint8_t N() const;
     uint8_t KK() const;
     uint16_t NNN() const;
+
+    // Mnemonic and operands, e.g. "LD   V3, 0x1F"; "???" for an unknown opcode
+    static void Disassemble(uint16_t code, char* out, size_t size);
 };
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "decode_cache.h"
+#include "chip8/constants.h"
+
+// Instrumentation is compiled in only with CHIP8_PROFILE=1 (the CMake option
+// of the same name). Without it the hooks below expand to nothing and
+// CPU::Profile is never read.
+#ifndef CHIP8_PROFILE
+#define CHIP8_PROFILE 0
+#endif
+
+// Where guest time goes: executions per opcode class and per address, and the
+// host time spent drawing. Filled by whichever CPU points CPU::Profile at it.
+struct CpuProfile {
+    struct Timing {
+        uint64_t Calls = 0u;
+        uint64_t Nanoseconds = 0u;
+    };
+
+    uint64_t OpCounts[static_cast<size_t>(OpId::Count)] {};
+    uint64_t PcCounts[CHIP8_MEMORY_SIZE] {};
+
+    Timing DrawSprite {};
+    Timing Clear {};
+
+    void Count(OpId op, uint16_t pc) {
+        OpCounts[static_cast<size_t>(op)] += 1u;
+        PcCounts[pc & (CHIP8_MEMORY_SIZE - 1u)] += 1u;
+    }
+
+    void Reset();
+    uint64_t GetInstructionCount() const;
+
+    // Opcode classes by count, then the `hotPcs` most executed addresses
+    void WriteReport(std::ostream& out, size_t hotPcs = 16u) const;
+    // One `kind,name,count,nanoseconds` row per opcode class, address and timing
+    void WriteCsv(std::ostream& out) const;
+
+    static const char* GetOpName(OpId op);
+};
+
+// Adds the time until the end of the scope to a Timing, if there is one
+class ProfileTimer {
+public:
+    explicit ProfileTimer(CpuProfile::Timing* timing)
+            : _timing(timing) {
+        if (_timing != nullptr) {
+            _start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ProfileTimer() {
+        if (_timing == nullptr) return;
+
+        const auto elapsed = std::chrono::steady_clock::now() - _start;
+        _timing->Calls += 1u;
+        _timing->Nanoseconds += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    ProfileTimer(const ProfileTimer&) = delete;
+    ProfileTimer& operator=(const ProfileTimer&) = delete;
+
+private:
+    CpuProfile::Timing* _timing;
+    std::chrono::steady_clock::time_point _start {};
+};
+
+#if CHIP8_PROFILE
+#define CHIP8_PROFILE_OP(cpu, op, pc)                                    \
+    do {                                                                 \
+        if ((cpu).Profile != nullptr) (cpu).Profile->Count((op), (pc));  \
+    } while (0)
+#define CHIP8_PROFILE_SCOPE(cpu, timing) \
+    const ProfileTimer profileTimer((cpu).Profile != nullptr ? &(cpu).Profile->timing : nullptr)
+#else
+#define CHIP8_PROFILE_OP(cpu, op, pc) do { } while (0)
+#define CHIP8_PROFILE_SCOPE(cpu, timing) do { } while (0)
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Behaviors that differ between CHIP-8 interpreters. ROMs are written against
+// one of them; a set of these flags describes what a ROM expects. With no flag
+// set the CPU behaves as it always has.
+struct Quirk {
+    // [8xy6]/[8xyE] shift Vy into Vx (COSMAC VIP), instead of shifting Vx in place
+    static constexpr uint8_t ShiftUsesVy = 1u << 0;
+    // [Fx55]/[Fx65] leave I pointing past the last register they touched (COSMAC VIP)
+    static constexpr uint8_t LoadStoreIncrementsI = 1u << 1;
+    // [Bxnn] jumps to xnn + Vx instead of nnn + V0 (CHIP-48, SUPER-CHIP)
+    static constexpr uint8_t JumpUsesVx = 1u << 2;
+    // Sprites are cut off at the screen edges instead of wrapping around; the
+    // position they start at still wraps
+    static constexpr uint8_t ClipSprites = 1u << 3;
+    // [8xy1]/[8xy2]/[8xy3] reset VF (COSMAC VIP)
+    static constexpr uint8_t LogicResetsVF = 1u << 4;
+
+    static constexpr uint8_t None = 0u;
+    static constexpr uint8_t All = (1u << 5) - 1u;
+    // Every set gets its own instance of the interpreters
+    static constexpr size_t Combinations = All + 1u;
+
+    static constexpr uint8_t CosmacVip = ShiftUsesVy | LoadStoreIncrementsI | ClipSprites | LogicResetsVF;
+    static constexpr uint8_t SuperChip = JumpUsesVx | ClipSprites;
+
+    // Reads a comma separated list of flag or preset names ("vip", "schip",
+    // "none"). Returns false on an unknown name.
+    static bool Parse(const char* text, uint8_t& outQuirks);
+    // The flag names of `quirks`, comma separated, or "none"
+    static void Format(uint8_t quirks, char* out, size_t size);
+};
+
+// Compile-time view of a set of quirks. The interpreters are instantiated
+// once per policy, so a quirk costs nothing while opcodes run.
+template <uint8_t Flags>
+struct QuirkPolicy {
+    static constexpr uint8_t Value = Flags;
+
+    static constexpr bool ShiftUsesVy = (Flags & Quirk::ShiftUsesVy) != 0u;
+    static constexpr bool LoadStoreIncrementsI = (Flags & Quirk::LoadStoreIncrementsI) != 0u;
+    static constexpr bool JumpUsesVx = (Flags & Quirk::JumpUsesVx) != 0u;
+    static constexpr bool ClipSprites = (Flags & Quirk::ClipSprites) != 0u;
+    static constexpr bool LogicResetsVF = (Flags & Quirk::LogicResetsVF) != 0u;
+};
+
+struct QuirkDispatch {
+    template <typename Policy, typename Fn>
+    static auto Call(Fn& fn) -> decltype(fn(Policy())) {
+        return fn(Policy());
+    }
+
+    template <typename Fn, size_t... Flags>
+    static auto Call(const uint8_t quirks, Fn& fn, std::index_sequence<Flags...>) -> decltype(fn(QuirkPolicy<0u>())) {
+        using Entry = decltype(fn(QuirkPolicy<0u>())) (*)(Fn&);
+        static constexpr Entry entries[] = { &Call<QuirkPolicy<static_cast<uint8_t>(Flags)>, Fn>... };
+        return entries[quirks & Quirk::All](fn);
+    }
+};
+
+// Calls fn(QuirkPolicy<quirks>()) through a table built at compile time: fn
+// is instantiated for every set of quirks, and the one for `quirks` is picked
+// with a single indirect call.
+template <typename Fn>
+auto WithQuirkPolicy(const uint8_t quirks, Fn&& fn) -> decltype(fn(QuirkPolicy<0u>())) {
+    return QuirkDispatch::Call(quirks, fn, std::make_index_sequence<Quirk::Combinations>());
+}
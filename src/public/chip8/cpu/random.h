@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// xorshift32 generator behind RND. Every console owns one, so consoles can
+// run on different threads and a seeded run always replays the same way.
+struct Random {
+    uint32_t State = 1u;
+
+    void Seed(const uint32_t seed) {
+        // splitmix32 finalizer, so nearby seeds start far apart
+        uint32_t value = seed + 0x9E37'79B9u;
+        value = (value ^ (value >> 16)) * 0x85EB'CA6Bu;
+        value = (value ^ (value >> 13)) * 0xC2B2'AE35u;
+        value ^= value >> 16;
+        State = (value != 0u) ? value : 1u;
+    }
+
+    uint32_t Next() {
+        State ^= State << 13;
+        State ^= State >> 17;
+        State ^= State << 5;
+        return State;
+    }
+};
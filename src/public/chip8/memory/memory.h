@@ -5,10 +5,26 @@
 
 #include "chip8/constants.h"
 
+// Notified whenever a memory range is overwritten, so that state derived from
+// the memory contents (e.g. decoded opcodes) can be dropped, and of accesses
+// past the end of memory (which wrap around).
+struct MemoryObserver {
+    virtual void OnMemoryWrite(uint16_t address, size_t size) = 0;
+    virtual void OnMemoryFault(uint16_t address) = 0;
+
+protected:
+    ~MemoryObserver() = default;
+};
+
 class Memory {
     uint8_t memory[CHIP8_MEMORY_SIZE];
+    MemoryObserver* _observer = nullptr;
+
+    uint16_t CheckAddress(uint16_t address) const;
 
 public:
+    void SetObserver(MemoryObserver* observer);
+
     void WriteBuffer(uint16_t address, const uint8_t* source, size_t size);
 
     void Write(uint16_t address, const uint8_t value);
@@ -16,4 +32,10 @@ public:
     uint8_t Read(uint16_t address);
 
     uint8_t* GetPtr(uint16_t address);
+    const uint8_t* GetPtr(uint16_t address) const;
+
+    // Points at `size` bytes from `address`. A range running past the end of
+    // memory is reported like Read does and copied, wrapped around, into
+    // `scratch`, which must hold `size` bytes.
+    const uint8_t* GetRange(uint16_t address, size_t size, uint8_t* scratch);
 };
@@ -12,5 +12,8 @@ struct Stack
     uint8_t SP = 0u;
 
 private:
+    friend struct Console;
+    friend class FlightRecorder;
+
     uint16_t stack[CHIP8_MEMORY_STACK_SIZE] {};
 };
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "chip8/constants.h"
+
+// Everything that makes up a running Console, flattened into plain data.
+// Copying a ConsoleState is a single memcpy, so a console can be forked by
+// saving it once and loading the copy into as many consoles as needed.
+//
+// Host-side choices (CPU engine, CpuSettings, lockstep checking) and the
+// screen's dirty tracking are not part of the state. The CPU quirks are: a
+// state only continues as it ran under the quirks it was saved with.
+struct ConsoleState {
+    // Bumped whenever the blob layout written by Serialize changes
+    static constexpr uint16_t Version = 3u;
+
+    uint64_t InstructionCount = 0u;
+    uint64_t ScreenRows[CHIP8_SCREEN_HEIGHT] {};
+
+    uint32_t RandomState = 1u;
+
+    uint16_t I = 0u;
+    uint16_t PC = 0u;
+    uint16_t Stack[CHIP8_MEMORY_STACK_SIZE] {};
+
+    uint8_t V[CHIP8_DATA_REGISTERS_SIZE] {};
+    uint8_t Delay = 0u;
+    uint8_t Sound = 0u;
+    uint8_t SP = 0u;
+    uint8_t KeyWaitRegister = 0u;
+    int8_t LatchedKey = -1;
+    bool Halted = false;
+    bool DrawFlag = false;
+    bool SoundFlag = false;
+    uint8_t Quirks = 0u; // see Quirk
+    bool Keys[CHIP8_KEYS_SIZE] {};
+
+    uint8_t Memory[CHIP8_MEMORY_SIZE] {};
+
+    // Appends the state as a versioned, little-endian blob
+    void Serialize(std::vector<uint8_t>& outBlob) const;
+    // Returns false (and leaves the state untouched) if the blob is not a
+    // state of this version
+    bool Deserialize(const uint8_t* blob, size_t size);
+};
+
+static_assert(std::is_trivially_copyable<ConsoleState>::value, "ConsoleState must stay a flat block");
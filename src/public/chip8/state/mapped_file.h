@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// A file mapped read-only into memory, so processes reading the same file
+// share its pages instead of each keeping a copy
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // false if the file is missing, empty or can't be mapped
+    bool Open(const char* path);
+    void Close();
+
+    const uint8_t* GetData() const { return _data; }
+    size_t GetSize() const { return _size; }
+
+private:
+    const uint8_t* _data = nullptr;
+    size_t _size = 0u;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "console_state.h"
+
+// Input recording: the console state a run started from and the keys held
+// during each frame after it. Applying Frames[n] with Keyboard::SetKeyMask
+// before the n-th Console::Cycle replays the run exactly, as long as the
+// console runs at the recorded CyclesPerFrame.
+struct Movie {
+    // Bumped whenever the blob layout written by Serialize changes
+    static constexpr uint16_t Version = 1u;
+
+    // RND seed the recording was started with; Start already holds the
+    // generator state, this is kept to name the run
+    uint32_t Seed = 0u;
+    uint32_t CyclesPerFrame = 0u;
+    ConsoleState Start {};
+
+    // Key mask per frame, bit k set while key k is down
+    std::vector<uint16_t> Frames;
+
+    void Serialize(std::vector<uint8_t>& outBlob) const;
+    bool Deserialize(const uint8_t* blob, size_t size);
+
+    bool SaveToFile(const char* path) const;
+    bool LoadFromFile(const char* path);
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "console_state.h"
+
+// History of console states in a fixed-size byte ring. Every
+// `keyframeInterval` frames a full state is stored; the frames in between
+// are stored as the XOR of the state against that keyframe, run-length
+// encoded. A frame usually touches a few registers and screen rows, so most
+// entries take a few hundred bytes. When the ring is full the oldest frames
+// are dropped, a whole keyframe interval at a time.
+class RewindBuffer {
+public:
+    explicit RewindBuffer(size_t capacityBytes = 4u << 20, uint32_t keyframeInterval = 60u);
+
+    // Records the state of the next frame
+    void Push(const ConsoleState& state);
+
+    // Removes the newest frame and writes it to outState; false when empty
+    bool Pop(ConsoleState& outState);
+
+    void Clear();
+
+    size_t GetFrameCount() const { return _entries.size(); }
+    size_t GetUsedBytes() const { return _usedBytes; }
+    size_t GetCapacityBytes() const { return _data.size(); }
+
+private:
+    struct Entry {
+        size_t offset;
+        uint32_t size;
+        bool keyframe;
+    };
+
+    void Encode(const ConsoleState& state, const ConsoleState* base);
+    void Decode(const Entry& entry, const ConsoleState* base, ConsoleState& outState) const;
+    void Store(bool keyframe);
+    void DropOldest();
+
+    std::vector<uint8_t> _data;
+    std::deque<Entry> _entries;
+    size_t _writeOffset = 0u;
+    size_t _usedBytes = 0u;
+
+    uint32_t _keyframeInterval;
+    // entries pushed after the newest keyframe
+    uint32_t _sinceKeyframe = 0u;
+    // decoded copy of the newest keyframe, the base of every newer delta
+    ConsoleState _keyframe {};
+
+    std::vector<uint8_t> _scratch;
+};